@@ -0,0 +1,366 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libmml-internal.h"
+
+#define MML_CACHE_MAGIC                         0x434c4d4d
+#define MML_CACHE_VERSION                       3
+
+/*!
+** A probed file, chained in its hash bucket and in the LRU list, the most 
+** recently used first.
+*/
+typedef struct mml_cache_entry_s
+{
+  char*                             path;
+  mml_cache_key_t                   key;
+  mml_media_info_t                  info;
+  struct mml_cache_entry_s*         hash_next;
+  struct mml_cache_entry_s*         lru_prev;
+  struct mml_cache_entry_s*         lru_next;
+} mml_cache_entry_t;
+
+typedef struct mml_cache_s
+{
+  mml_cache_entry_t**               buckets;
+  int                               nb_buckets;
+  int                               capacity;
+  int                               count;
+  mml_cache_entry_t*                lru_head;
+  mml_cache_entry_t*                lru_tail;
+  char*                             file_path;
+  pthread_mutex_t                   mutex;
+} mml_cache_t;
+
+static mml_cache_t cache = { NULL, 0, 0, 0, NULL, NULL, NULL, PTHREAD_MUTEX_INITIALIZER };
+
+static unsigned int
+mml_cache_hash(const char* path, int fast)
+{
+  unsigned int hash = 2166136261u;
+  for (; *path; path++)
+    hash = (hash ^ (unsigned char)*path) * 16777619u;
+  return (hash ^ (unsigned int)fast) * 16777619u;
+}
+
+/*!
+** Gets the key of the current version of a file. The modification time is 
+** taken to the nanosecond, so a file rewritten within the same second with 
+** the same size is still probed again.
+*/
+static int
+mml_cache_stat(const char* path, int fast, mml_cache_key_t* key)
+{
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return MML_ERROR_FILE_NOT_EXIST;
+  key->fast = fast ? 1 : 0;
+  key->dev = (int64_t)st.st_dev;
+  key->ino = (int64_t)st.st_ino;
+  key->size = (int64_t)st.st_size;
+  key->mtime = (int64_t)st.st_mtim.tv_sec;
+  key->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+  return MML_SUCCESS;
+}
+
+static mml_cache_entry_t*
+mml_cache_find(const char* path, int fast, mml_cache_entry_t*** link)
+{
+  *link = &cache.buckets[mml_cache_hash(path, fast) % cache.nb_buckets];
+  for (; **link != NULL; *link = &(**link)->hash_next)
+  {
+    if ((**link)->key.fast == fast && strcmp((**link)->path, path) == 0)
+      return **link;
+  }
+  return NULL;
+}
+
+static void
+mml_cache_unlink(mml_cache_entry_t* entry)
+{
+  if (entry->lru_prev != NULL)
+    entry->lru_prev->lru_next = entry->lru_next;
+  else
+    cache.lru_head = entry->lru_next;
+  if (entry->lru_next != NULL)
+    entry->lru_next->lru_prev = entry->lru_prev;
+  else
+    cache.lru_tail = entry->lru_prev;
+  entry->lru_prev = NULL;
+  entry->lru_next = NULL;
+}
+
+static void
+mml_cache_link(mml_cache_entry_t* entry)
+{
+  entry->lru_next = cache.lru_head;
+  if (cache.lru_head != NULL)
+    cache.lru_head->lru_prev = entry;
+  cache.lru_head = entry;
+  if (cache.lru_tail == NULL)
+    cache.lru_tail = entry;
+}
+
+static void
+mml_cache_remove(mml_cache_entry_t* entry)
+{
+  mml_cache_entry_t** link;
+  mml_cache_find(entry->path, (int)entry->key.fast, &link);
+  *link = entry->hash_next;
+  mml_cache_unlink(entry);
+  free(entry->path);
+  free(entry);
+  cache.count--;
+}
+
+/*!
+** Adds or replaces an entry as the most recently used one, evicting the least 
+** recently used one when the cache is full. Called with the mutex held.
+*/
+static void
+mml_cache_insert(const char* path, 
+                 const mml_cache_key_t* key, 
+                 const mml_media_info_t* info)
+{
+  mml_cache_entry_t** link;
+  mml_cache_entry_t* entry = mml_cache_find(path, (int)key->fast, &link);
+  
+  if (entry == NULL)
+  {
+    entry = (mml_cache_entry_t*)calloc(1, sizeof(mml_cache_entry_t));
+    if (entry == NULL)
+      return;
+    entry->path = strdup(path);
+    if (entry->path == NULL)
+    {
+      free(entry);
+      return;
+    }
+    *link = entry;
+    cache.count++;
+  }
+  else
+  {
+    mml_cache_unlink(entry);
+  }
+  memcpy(&entry->key, key, sizeof(mml_cache_key_t));
+  memcpy(&entry->info, info, sizeof(mml_media_info_t));
+  mml_cache_link(entry);
+  
+  while (cache.count > cache.capacity)
+    mml_cache_remove(cache.lru_tail);
+}
+
+/*!
+** Loads the entries saved by mml_cache_save, the oldest first, skipping the 
+** whole file if it was written by another layout. Called with the mutex held.
+*/
+static void
+mml_cache_load(const char* file_path)
+{
+  FILE*     file = fopen(file_path, "rb");
+  uint32_t  header[4];
+  
+  if (file == NULL)
+    return;
+  if (fread(header, sizeof(uint32_t), 4, file) != 4 ||
+      header[0] != MML_CACHE_MAGIC || 
+      header[1] != MML_CACHE_VERSION ||
+      header[2] != sizeof(mml_media_info_t))
+  {
+    fclose(file);
+    return;
+  }
+  
+  for (uint32_t i = 0; i < header[3]; i++)
+  {
+    uint32_t          path_len;
+    mml_cache_key_t   key;
+    mml_media_info_t  info;
+    char              path[4096];
+    
+    if (fread(&path_len, sizeof(path_len), 1, file) != 1 || path_len >= sizeof(path))
+      break;
+    if (fread(path, 1, path_len, file) != path_len ||
+        fread(&key, sizeof(key), 1, file) != 1 ||
+        fread(&info, sizeof(info), 1, file) != 1)
+      break;
+    path[path_len] = '\0';
+    mml_cache_insert(path, &key, &info);
+  }
+  fclose(file);
+}
+
+static void
+mml_cache_clear(void)
+{
+  while (cache.lru_head != NULL)
+    mml_cache_remove(cache.lru_head);
+  free(cache.buckets);
+  free(cache.file_path);
+  cache.buckets = NULL;
+  cache.file_path = NULL;
+  cache.nb_buckets = 0;
+  cache.capacity = 0;
+}
+
+static int
+mml_cache_write(void)
+{
+  char*     tmp_path;
+  FILE*     file;
+  uint32_t  header[4] = { MML_CACHE_MAGIC, MML_CACHE_VERSION, sizeof(mml_media_info_t), cache.count };
+  int       ret = MML_SUCCESS;
+  
+  if (cache.file_path == NULL)
+    return MML_SUCCESS;
+  
+  /*!
+  ** 先写临时文件再改名，避免进程中断时留下不完整的缓存文件。
+  */
+  tmp_path = (char*)malloc(strlen(cache.file_path) + 5);
+  if (tmp_path == NULL)
+    return MML_ERROR_FILE_NOT_CREATED;
+  sprintf(tmp_path, "%s.tmp", cache.file_path);
+  file = fopen(tmp_path, "wb");
+  if (file == NULL)
+  {
+    free(tmp_path);
+    return MML_ERROR_FILE_NOT_CREATED;
+  }
+  
+  if (fwrite(header, sizeof(uint32_t), 4, file) != 4)
+    ret = MML_ERROR_FILE_NOT_WRITTEN;
+  for (mml_cache_entry_t* entry = cache.lru_tail; 
+       ret == MML_SUCCESS && entry != NULL; 
+       entry = entry->lru_prev)
+  {
+    uint32_t path_len = (uint32_t)strlen(entry->path);
+    if (fwrite(&path_len, sizeof(path_len), 1, file) != 1 ||
+        fwrite(entry->path, 1, path_len, file) != path_len ||
+        fwrite(&entry->key, sizeof(mml_cache_key_t), 1, file) != 1 ||
+        fwrite(&entry->info, sizeof(mml_media_info_t), 1, file) != 1)
+      ret = MML_ERROR_FILE_NOT_WRITTEN;
+  }
+  
+  if (fclose(file) != 0)
+    ret = MML_ERROR_FILE_NOT_WRITTEN;
+  if (ret == MML_SUCCESS && rename(tmp_path, cache.file_path) != 0)
+    ret = MML_ERROR_FILE_NOT_WRITTEN;
+  if (ret != MML_SUCCESS)
+    remove(tmp_path);
+  free(tmp_path);
+  return ret;
+}
+
+int
+mml_cache_open(int capacity, const char* file_path)
+{
+  int ret = MML_SUCCESS;
+  
+  pthread_mutex_lock(&cache.mutex);
+  mml_cache_clear();
+  if (capacity <= 0)
+    goto RELEASE;
+  
+  cache.nb_buckets = capacity < 8 ? 16 : capacity * 2;
+  cache.buckets = (mml_cache_entry_t**)calloc(cache.nb_buckets, sizeof(mml_cache_entry_t*));
+  if (cache.buckets == NULL)
+  {
+    cache.nb_buckets = 0;
+    ret = MML_ERROR_CACHE_NOT_CREATED;
+    goto RELEASE;
+  }
+  cache.capacity = capacity;
+  if (file_path != NULL)
+  {
+    cache.file_path = strdup(file_path);
+    mml_cache_load(file_path);
+  }
+  
+RELEASE:
+  
+  pthread_mutex_unlock(&cache.mutex);
+  return ret;
+}
+
+int
+mml_cache_save(void)
+{
+  int ret;
+  pthread_mutex_lock(&cache.mutex);
+  ret = mml_cache_write();
+  pthread_mutex_unlock(&cache.mutex);
+  return ret;
+}
+
+int
+mml_cache_close(void)
+{
+  int ret;
+  pthread_mutex_lock(&cache.mutex);
+  ret = mml_cache_write();
+  mml_cache_clear();
+  pthread_mutex_unlock(&cache.mutex);
+  return ret;
+}
+
+int
+mml_cache_get(const char* path, int fast, mml_media_info_t* info, mml_cache_key_t* key)
+{
+  mml_cache_entry_t**   link;
+  mml_cache_entry_t*    entry;
+  int                   ret = MML_ERROR_NOT_FOUND;
+  
+  /*!
+  ** stat 放在锁外面，容量在锁里读。文件不在时键标为无效，不会被存入。
+  */
+  if (mml_cache_stat(path, fast, key) != MML_SUCCESS)
+  {
+    key->fast = -1;
+    return MML_ERROR_NOT_FOUND;
+  }
+  
+  pthread_mutex_lock(&cache.mutex);
+  if (cache.capacity > 0 && (entry = mml_cache_find(path, (int)key->fast, &link)) != NULL)
+  {
+    /*!
+    ** 文件被替换或修改过，缓存失效。
+    */
+    if (memcmp(&entry->key, key, sizeof(mml_cache_key_t)) != 0)
+    {
+      mml_cache_remove(entry);
+    }
+    else
+    {
+      memcpy(info, &entry->info, sizeof(mml_media_info_t));
+      mml_cache_unlink(entry);
+      mml_cache_link(entry);
+      ret = MML_SUCCESS;
+    }
+  }
+  pthread_mutex_unlock(&cache.mutex);
+  return ret;
+}
+
+void
+mml_cache_put(const char* path, const mml_cache_key_t* key, const mml_media_info_t* info)
+{
+  if (key->fast < 0)
+    return;
+  
+  pthread_mutex_lock(&cache.mutex);
+  if (cache.capacity > 0)
+    mml_cache_insert(path, key, info);
+  pthread_mutex_unlock(&cache.mutex);
+}
@@ -0,0 +1,470 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmml-internal.h"
+
+/*!
+** The start routine of a thread and the context it runs in, a copy of the 
+** context of the thread creating it with an error buffer of its own. It is 
+** returned by the thread and freed when the thread is joined.
+*/
+typedef struct mml_thread_start_s
+{
+  void*                 (*start)(void*);
+  void*                 arg;
+  int                   failed_first;
+  mml_context_t         worker;
+} mml_thread_start_t;
+
+/*!
+** the context of the operation running on this thread, NULL outside of a 
+** context variant.
+*/
+static __thread mml_context_p current = NULL;
+
+/*!
+** the default context of each thread, used by the functions without context.
+*/
+static pthread_key_t thread_key;
+static pthread_once_t thread_once = PTHREAD_ONCE_INIT;
+
+/*!
+** the default context of a thread whose default context could not be 
+** allocated.
+*/
+static __thread mml_context_t fallback;
+
+/*!
+** guards the worker counts of the contexts.
+*/
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+mml_context_key_init(void)
+{
+  pthread_key_create(&thread_key, free);
+}
+
+mml_context_p
+mml_context_current(void)
+{
+  mml_context_p ctx;
+  
+  if (current != NULL)
+    return current;
+  pthread_once(&thread_once, mml_context_key_init);
+  if ((ctx = (mml_context_p)pthread_getspecific(thread_key)) != NULL)
+    return ctx;
+  /*!
+  ** 首次使用时分配本线程的默认上下文，线程退出时释放。
+  */
+  if ((ctx = (mml_context_p)calloc(1, sizeof(mml_context_t))) == NULL)
+    return &fallback;
+  if (pthread_setspecific(thread_key, ctx) != 0)
+  {
+    free(ctx);
+    return &fallback;
+  }
+  return ctx;
+}
+
+mml_context_p
+mml_context_enter(mml_context_p ctx)
+{
+  mml_context_p prev = current;
+  current = ctx;
+  return prev;
+}
+
+void
+mml_context_leave(mml_context_p prev)
+{
+  current = prev;
+}
+
+static void*
+mml_thread_start(void* arg)
+{
+  mml_thread_start_t* start   = (mml_thread_start_t*)arg;
+  mml_context_p       parent  = start->worker.parent;
+  
+  current = &start->worker;
+  start->start(start->arg);
+  current = NULL;
+  
+  /*!
+  ** 只记下最先出错的工作线程，错误信息在 join 时由启动它的线程复制。
+  */
+  pthread_mutex_lock(&worker_mutex);
+  if (start->worker.error[0] != '\0' && !parent->worker_failed)
+  {
+    parent->worker_failed = 1;
+    start->failed_first = 1;
+  }
+  pthread_mutex_unlock(&worker_mutex);
+  return start;
+}
+
+int
+mml_thread_create(pthread_t* thread, void* (*start)(void*), void* arg)
+{
+  mml_thread_start_t* thread_start;
+  mml_context_p       parent      = mml_context_current();
+  int                 ret;
+  
+  if ((thread_start = (mml_thread_start_t*)calloc(1, sizeof(mml_thread_start_t))) == NULL)
+    return -1;
+  thread_start->start = start;
+  thread_start->arg = arg;
+  thread_start->worker.options = parent->options;
+  thread_start->worker.map_inputs = parent->map_inputs;
+  thread_start->worker.parent = parent;
+  
+  /*!
+  ** 没有工作线程在运行时开始新的一批，重新记录最先出错的线程。
+  */
+  pthread_mutex_lock(&worker_mutex);
+  if (parent->workers++ == 0)
+    parent->worker_failed = 0;
+  pthread_mutex_unlock(&worker_mutex);
+  
+  if ((ret = pthread_create(thread, NULL, mml_thread_start, thread_start)) != 0)
+  {
+    pthread_mutex_lock(&worker_mutex);
+    parent->workers--;
+    pthread_mutex_unlock(&worker_mutex);
+    free(thread_start);
+  }
+  return ret;
+}
+
+int
+mml_thread_join(pthread_t thread)
+{
+  mml_thread_start_t* start = NULL;
+  mml_context_p       parent;
+  int                 ret;
+  
+  if ((ret = pthread_join(thread, (void**)&start)) != 0 || start == NULL)
+    return ret;
+  parent = start->worker.parent;
+  if (start->failed_first)
+    memcpy(parent->error, start->worker.error, sizeof(parent->error));
+  pthread_mutex_lock(&worker_mutex);
+  parent->workers--;
+  pthread_mutex_unlock(&worker_mutex);
+  free(start);
+  return 0;
+}
+
+/*
+********************************************************************************
+**
+** mml_context_new
+**
+********************************************************************************
+*/
+int
+mml_context_new(mml_context_p* ctx, const mml_options_t* options)
+{
+  if ((*ctx = (mml_context_p)calloc(1, sizeof(mml_context_t))) == NULL)
+    return MML_ERROR_CONTEXT_NOT_CREATED;
+  /*!
+  ** 全零即默认选项。
+  */
+  if (options != NULL)
+    (*ctx)->options = *options;
+  return MML_SUCCESS;
+}
+
+void
+mml_context_free(mml_context_p ctx)
+{
+  free(ctx);
+}
+
+void
+mml_context_options(mml_context_p ctx, const mml_options_t* options)
+{
+  if (options != NULL)
+    ctx->options = *options;
+  else
+    memset(&ctx->options, 0, sizeof(mml_options_t));
+}
+
+void
+mml_context_map_inputs(mml_context_p ctx, int enable)
+{
+  ctx->map_inputs = enable;
+}
+
+const char*
+mml_context_error(mml_context_p ctx)
+{
+  return ctx->error;
+}
+
+int64_t
+mml_context_bytes_read(mml_context_p ctx)
+{
+  return ctx->bytes_read;
+}
+
+int64_t
+mml_context_buffers_allocated(mml_context_p ctx)
+{
+  return __atomic_load_n(&ctx->buffers_allocated, __ATOMIC_RELAXED);
+}
+
+/*
+********************************************************************************
+** OPERATIONS IN A CONTEXT
+********************************************************************************
+*/
+
+int
+mml_media_info_ctx(mml_context_p ctx, 
+                   const char* original_path, 
+                   int fast, 
+                   mml_media_info_t* info)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_media_info(original_path, fast, info);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_media_info_batch_ctx(mml_context_p ctx, 
+                         mml_media_probe_t* probes, 
+                         int nb_probes, 
+                         int fast, 
+                         int threads)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_media_info_batch(probes, nb_probes, fast, threads);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_audio_remove_ctx(mml_context_p ctx, 
+                     const char* original_video_path, 
+                     const char* output_video_path)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_audio_remove(original_video_path, output_video_path);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_audio_exist_ctx(mml_context_p ctx, 
+                    const char* original_video_path)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_audio_exist(original_video_path);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_audio_extract_ctx(mml_context_p ctx, 
+                      const char* original_video_path, 
+                      const char* output_audio_path)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_audio_extract(original_video_path, output_audio_path);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_audio_pcm_ctx(mml_context_p ctx, 
+                  const char* original_path, 
+                  const mml_pcm_format_t* format, 
+                  mml_pcm_callback_t callback, 
+                  void* opaque)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_audio_pcm(original_path, format, callback, opaque);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_resolution_ctx(mml_context_p ctx, 
+                         const char* original_video_path, 
+                         int* width, 
+                         int* height)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_resolution(original_video_path, width, height);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_resize_ctx(mml_context_p ctx, 
+                     const char* original_path, 
+                     const char* output_path, 
+                     int width, 
+                     int height)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_resize_ex(original_path, output_path, width, height, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_pad_ctx(mml_context_p ctx, 
+                  const char* original_path, 
+                  const char* output_path, 
+                  int width, 
+                  int height)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_pad_ex(original_path, output_path, width, height, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_ladder_ctx(mml_context_p ctx, 
+                     const char* original_path, 
+                     const mml_rendition_t* renditions, 
+                     int nb_renditions)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_ladder_ex(original_path, renditions, nb_renditions, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_concat_ctx(mml_context_p ctx, 
+                     const char* original_path1, 
+                     const char* original_path2, 
+                     const char* output_path)
+{
+  const char* original_paths[2] = { original_path1, original_path2 };
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_concat_files_ex(original_paths, 2, output_path, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_concat_files_ctx(mml_context_p ctx, 
+                           const char** original_paths, 
+                           int nb_paths, 
+                           const char* output_path)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_concat_files_ex(original_paths, nb_paths, output_path, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_concat_adaptive_ctx(mml_context_p ctx, 
+                              const char** original_paths, 
+                              int nb_paths, 
+                              const char* output_path)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_concat_adaptive_ex(original_paths, nb_paths, output_path, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_cut_ctx(mml_context_p ctx, 
+                  const char* original_path, 
+                  double start_time,
+                  double end_time,
+                  const char* output_path)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_cut_ex(original_path, start_time, end_time, output_path, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_cut_ranges_ctx(mml_context_p ctx, 
+                         const char* original_path, 
+                         const mml_cut_range_t* ranges,
+                         int nb_ranges)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_cut_ranges_ex(original_path, ranges, nb_ranges, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_cut_exact_ctx(mml_context_p ctx, 
+                        const char* original_path, 
+                        double start_time,
+                        double end_time,
+                        const char* output_path)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_cut_exact_ex(original_path, start_time, end_time, output_path, &ctx->options);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_save_images_ctx(mml_context_p ctx, 
+                          const char* original_path, 
+                          double start_time, 
+                          double end_time, 
+                          const char* output_path, 
+                          int image_index)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_save_images(original_path, start_time, end_time, output_path, image_index);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_save_images_parallel_ctx(mml_context_p ctx, 
+                                   const char* original_path, 
+                                   double start_time, 
+                                   double end_time, 
+                                   const char* output_path, 
+                                   int image_index,
+                                   int threads)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_save_images_parallel(original_path, start_time, end_time, output_path, image_index, threads);
+  mml_context_leave(prev);
+  return ret;
+}
+
+int
+mml_video_save_keyframes_ctx(mml_context_p ctx, 
+                             const char* original_path, 
+                             double start_time, 
+                             double end_time, 
+                             const char* output_path, 
+                             int image_index,
+                             int threads)
+{
+  mml_context_p prev = mml_context_enter(ctx);
+  int ret = mml_video_save_keyframes(original_path, start_time, end_time, output_path, image_index, threads);
+  mml_context_leave(prev);
+  return ret;
+}
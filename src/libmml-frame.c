@@ -13,21 +13,42 @@
 #include <libavutil/imgutils.h>
 #include <libavutil/avutil.h>
 #include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/samplefmt.h>
 
 #include "libmml-internal.h"
 
 /*!
-** Saves a frame as an image under the given output path.
+** Opens the image encoder, the scaler and the RGB frame buffer.
 */
 int
-mml_frame_save_image(const mml_encoder_p    encoder, 
-                     const AVFrame*         orig_frame,
-                     AVFrame*               rgb_frame,
-                     const char*            output_path)
+mml_frame_image_open(const mml_encoder_p    encoder, 
+                     const AVFrame*         orig_frame)
 {
-  const AVCodec* codec = encoder->enc;
   AVCodecContext* c = encoder->ctx;
-  AVPacket* pkt = encoder->pkt;
+  
+  if (avcodec_is_open(c))
+  {
+    if (c->width == orig_frame->width && 
+        c->height == orig_frame->height && 
+        encoder->sws != NULL)
+    {
+      encoder->sws = sws_getCachedContext(encoder->sws,
+        orig_frame->width, orig_frame->height, orig_frame->format,
+        c->width, c->height, AV_PIX_FMT_RGB24,
+        SWS_BILINEAR, NULL, NULL, NULL
+      );
+      return encoder->sws != NULL ? MML_SUCCESS : MML_ERROR_CODEC_NOT_CREATED;
+    }
+    /*!
+    ** 分辨率变化，重新打开编码器。
+    */
+    avcodec_free_context(&encoder->ctx);
+    encoder->ctx = avcodec_alloc_context3(encoder->enc);
+    if (!encoder->ctx)
+      return MML_ERROR_CODEC_NOT_CREATED;
+    c = encoder->ctx;
+  }
   
   c->bit_rate = 400000;
   c->width = orig_frame->width;
@@ -35,34 +56,90 @@ mml_frame_save_image(const mml_encoder_p    encoder,
   c->pix_fmt = AV_PIX_FMT_RGB24;
   c->time_base = (AVRational){1, 25};
 
-  if (avcodec_open2(c, codec, NULL) < 0)
+  if (avcodec_open2(c, encoder->enc, NULL) < 0)
     return MML_ERROR_CODEC_OPEN_FAILED;
   
-  rgb_frame->format = AV_PIX_FMT_RGB24;
-  rgb_frame->width = c->width;
-  rgb_frame->height = c->height;
-  av_frame_get_buffer(rgb_frame, 0);
+  if (encoder->frame == NULL)
+    encoder->frame = av_frame_alloc();
+  if (encoder->frame == NULL)
+    return MML_ERROR_FRAME_NOT_CREATED;
+  av_frame_unref(encoder->frame);
+  
+  encoder->frame->format = AV_PIX_FMT_RGB24;
+  encoder->frame->width = c->width;
+  encoder->frame->height = c->height;
+  if (av_frame_get_buffer(encoder->frame, 0) < 0)
+    return MML_ERROR_FRAME_NOT_CREATED;
   
-  struct SwsContext* sws = sws_getContext(
+  encoder->sws = sws_getCachedContext(encoder->sws,
     orig_frame->width, orig_frame->height, orig_frame->format,
     c->width, c->height, AV_PIX_FMT_RGB24,
     SWS_BILINEAR, NULL, NULL, NULL
   );
-  sws_scale(sws,
+  if (encoder->sws == NULL)
+    return MML_ERROR_CODEC_NOT_CREATED;
+  
+  return MML_SUCCESS;
+}
+
+/*!
+** Converts and compresses a frame into an image packet.
+*/
+int
+mml_frame_encode_image(const mml_encoder_p    encoder, 
+                       const AVFrame*         orig_frame,
+                       AVPacket*              pkt)
+{
+  int ret = mml_frame_image_open(encoder, orig_frame);
+  if (ret != MML_SUCCESS)
+    return ret;
+  
+  AVCodecContext* c = encoder->ctx;
+  AVFrame* rgb_frame = encoder->frame;
+  
+  /*!
+  ** 编码器可能仍持有上一帧的引用。
+  */
+  if (av_frame_make_writable(rgb_frame) < 0)
+    return MML_ERROR_FRAME_NOT_CREATED;
+  
+  sws_scale(encoder->sws,
     (const uint8_t * const *)orig_frame->data, orig_frame->linesize,
     0, orig_frame->height,
     rgb_frame->data, rgb_frame->linesize);
-  sws_freeContext(sws);
   
   // Send frame to encoder
-  if (avcodec_send_frame(c, rgb_frame) < 0) return -1;
-  if (avcodec_receive_packet(c, pkt) < 0) return -1;
+  if (avcodec_send_frame(c, rgb_frame) < 0) 
+    return MML_ERROR_FRAME_NOT_SENT;
+  if (avcodec_receive_packet(c, pkt) < 0) 
+    return MML_ERROR_FRAME_NOT_WRITTEN;
+  
+  return MML_SUCCESS;
+}
+
+/*!
+** Saves a frame as an image under the given output path.
+*/
+int
+mml_frame_save_image(const mml_encoder_p    encoder, 
+                     const AVFrame*         orig_frame,
+                     const char*            output_path)
+{
+  AVPacket* pkt = encoder->pkt;
+  
+  int ret = mml_frame_encode_image(encoder, orig_frame, pkt);
+  if (ret != MML_SUCCESS)
+    return ret;
   
   FILE* f = fopen(output_path, "wb");
   if (!f) 
+  {
+    av_packet_unref(pkt);
     return MML_ERROR_FILE_OPEN_FAILED;
+  }
   fwrite(pkt->data, 1, pkt->size, f);
   fclose(f);
+  av_packet_unref(pkt);
   
   return MML_SUCCESS;
 }
@@ -96,4 +173,507 @@ mml_frame_encode(const mml_encoder_p encoder,
       return -1;
   }
   return MML_SUCCESS;
-}
\ No newline at end of file
+}
+
+#define MML_CEIL_RSHIFT(a, b)               (((a) + (1 << (b)) - 1) >> (b))
+
+/*!
+** the frames, packets and pooled buffers allocated so far
+*/
+static int64_t buffers_allocated = 0;
+
+/*!
+** Counts an allocation, for the process and for the context of the calling 
+** thread.
+*/
+static void
+mml_buffers_count(void)
+{
+  mml_context_p ctx = mml_context_current();
+  
+  /*!
+  ** 工作线程的缓冲区记在最外层启动它的上下文里。
+  */
+  while (ctx->parent != NULL)
+    ctx = ctx->parent;
+  __atomic_add_fetch(&buffers_allocated, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&ctx->buffers_allocated, 1, __ATOMIC_RELAXED);
+}
+
+/*!
+** Converts a 0xRRGGBB color into limited range BT.601 YUV.
+*/
+void
+mml_frame_color_yuv(uint32_t rgb, uint8_t yuv[3])
+{
+  int r = (rgb >> 16) & 0xff;
+  int g = (rgb >> 8) & 0xff;
+  int b = rgb & 0xff;
+  yuv[0] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+  yuv[1] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+  yuv[2] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+/*!
+** Rounds an offset down to the chroma subsampling of a format.
+*/
+void
+mml_frame_align_offset(int format, int* x, int* y)
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+  
+  if (desc == NULL)
+    return;
+  *x = *x >> desc->log2_chroma_w << desc->log2_chroma_w;
+  *y = *y >> desc->log2_chroma_h << desc->log2_chroma_h;
+}
+
+/*!
+** Tells the subsampling of a plane, only the planes holding chroma are 
+** subsampled.
+*/
+static void
+mml_frame_plane_shift(const AVPixFmtDescriptor* desc, int plane, int* shift_w, int* shift_h)
+{
+  *shift_w = 0;
+  *shift_h = 0;
+  for (int c = 1; c < 3 && c < desc->nb_components; c++)
+  {
+    if (desc->comp[c].plane == plane)
+    {
+      *shift_w = desc->log2_chroma_w;
+      *shift_h = desc->log2_chroma_h;
+    }
+  }
+}
+
+/*!
+** Builds the fill pattern of a plane, the bytes of one pixel of the plane 
+** repeated over 64 bytes.
+**
+** @return the bytes per pixel of the plane, or 0 if the plane cannot be filled
+*/
+static int
+mml_frame_fill_pattern(const AVPixFmtDescriptor* desc, 
+                       int plane, 
+                       const uint8_t color[3], 
+                       uint8_t pattern[64])
+{
+  uint8_t   pixel[8]  = {0};
+  int       step      = 0;
+  
+  for (int c = 0; c < desc->nb_components; c++)
+  {
+    const AVComponentDescriptor* comp = &desc->comp[c];
+    if (comp->plane != plane)
+      continue;
+    if (comp->step > 8 || 64 % comp->step != 0)
+      return 0;
+    step = comp->step;
+    
+    /*!
+    ** 8位的颜色按位深放大，alpha填满。
+    */
+    uint32_t value = c < 3 ? color[c] : 0xff;
+    value = comp->depth > 8 ? value << (comp->depth - 8) : value >> (8 - comp->depth);
+    if (c == 3)
+      value = (1u << comp->depth) - 1;
+    value <<= comp->shift;
+    
+    if (comp->depth + comp->shift > 8)
+    {
+      if (comp->offset + 2 > step)
+        return 0;
+      if (desc->flags & AV_PIX_FMT_FLAG_BE)
+      {
+        pixel[comp->offset] = (uint8_t)(value >> 8);
+        pixel[comp->offset + 1] = (uint8_t)value;
+      }
+      else
+      {
+        pixel[comp->offset] = (uint8_t)value;
+        pixel[comp->offset + 1] = (uint8_t)(value >> 8);
+      }
+    }
+    else
+    {
+      pixel[comp->offset] = (uint8_t)value;
+    }
+  }
+  
+  for (int i = 0; step > 0 && i < 64; i++)
+    pattern[i] = pixel[i % step];
+  return step;
+}
+
+/*!
+** Fills a run of bytes of a row with a pattern, in blocks the compiler turns 
+** into vector stores.
+*/
+static void
+mml_frame_fill_row(uint8_t* dst, int nb_bytes, const uint8_t pattern[64], int step)
+{
+  if (nb_bytes <= 0)
+    return;
+  if (step == 1)
+  {
+    memset(dst, pattern[0], nb_bytes);
+    return;
+  }
+  for (; nb_bytes >= 64; dst += 64, nb_bytes -= 64)
+    memcpy(dst, pattern, 64);
+  memcpy(dst, pattern, nb_bytes);
+}
+
+/*!
+** Fills the border around a rectangle in the planes of an image.
+*/
+static int
+mml_frame_fill_planes(int              format, 
+                      int              frame_width, 
+                      int              frame_height, 
+                      uint8_t* const   data[4], 
+                      const int        linesize[4], 
+                      int              x, 
+                      int              y, 
+                      int              width, 
+                      int              height, 
+                      const uint8_t    color[3])
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+  
+  if (desc == NULL || 
+      (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM | 
+                      AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_RGB)))
+    return MML_ERROR_NOT_FOUND;
+  
+  for (int p = 0; p < av_pix_fmt_count_planes(format); p++)
+  {
+    uint8_t   pattern[64];
+    int       shift_w, shift_h;
+    int       step = mml_frame_fill_pattern(desc, p, color, pattern);
+    if (step == 0)
+      return MML_ERROR_NOT_FOUND;
+    
+    mml_frame_plane_shift(desc, p, &shift_w, &shift_h);
+    int plane_w = MML_CEIL_RSHIFT(frame_width, shift_w);
+    int plane_h = MML_CEIL_RSHIFT(frame_height, shift_h);
+    /*!
+    ** 奇数偏移时与内容共用的色度采样点算作内容，不被覆盖。
+    */
+    int x0 = FFMIN(FFMAX(x >> shift_w, 0), plane_w);
+    int x1 = FFMIN(MML_CEIL_RSHIFT(x + width, shift_w), plane_w);
+    int y0 = FFMIN(FFMAX(y >> shift_h, 0), plane_h);
+    int y1 = FFMIN(MML_CEIL_RSHIFT(y + height, shift_h), plane_h);
+    
+    for (int row = 0; row < plane_h; row++)
+    {
+      uint8_t* dst = data[p] + (ptrdiff_t)row * linesize[p];
+      if (row < y0 || row >= y1 || x1 <= x0)
+      {
+        mml_frame_fill_row(dst, plane_w * step, pattern, step);
+      }
+      else
+      {
+        mml_frame_fill_row(dst, x0 * step, pattern, step);
+        mml_frame_fill_row(dst + x1 * step, (plane_w - x1) * step, pattern, step);
+      }
+    }
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Fills the border of a frame around a rectangle.
+*/
+int
+mml_frame_fill_border(AVFrame*         frame, 
+                      int              x, 
+                      int              y, 
+                      int              width, 
+                      int              height, 
+                      const uint8_t    color[3])
+{
+  return mml_frame_fill_planes(frame->format, 
+                               frame->width, 
+                               frame->height, 
+                               frame->data, 
+                               frame->linesize, 
+                               x, y, width, height, color);
+}
+
+/*!
+** Copies a frame into a rectangle of a larger frame of the same format.
+*/
+int
+mml_frame_copy_rect(AVFrame*         dst, 
+                    const AVFrame*   src, 
+                    int              x, 
+                    int              y)
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(dst->format);
+  
+  if (desc == NULL || src->format != dst->format ||
+      x < 0 || y < 0 || x + src->width > dst->width || y + src->height > dst->height)
+    return MML_ERROR_NOT_FOUND;
+  
+  for (int p = 0; p < av_pix_fmt_count_planes(dst->format); p++)
+  {
+    int shift_w, shift_h;
+    int step = 0;
+    for (int c = 0; c < desc->nb_components; c++)
+    {
+      if (desc->comp[c].plane == p)
+        step = desc->comp[c].step;
+    }
+    mml_frame_plane_shift(desc, p, &shift_w, &shift_h);
+    av_image_copy_plane(dst->data[p] + (ptrdiff_t)(y >> shift_h) * dst->linesize[p] + (x >> shift_w) * step, 
+                        dst->linesize[p],
+                        src->data[p], 
+                        src->linesize[p],
+                        MML_CEIL_RSHIFT(src->width, shift_w) * step,
+                        MML_CEIL_RSHIFT(src->height, shift_h));
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Points at the top left corner of a rectangle in each plane of a frame.
+*/
+int
+mml_frame_rect_planes(const AVFrame*   frame, 
+                      int              x, 
+                      int              y, 
+                      uint8_t*         data[4])
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(frame->format);
+  
+  if (desc == NULL || x < 0 || y < 0 || x >= frame->width || y >= frame->height)
+    return MML_ERROR_NOT_FOUND;
+  
+  for (int p = 0; p < 4; p++)
+  {
+    int shift_w, shift_h;
+    int step = 0;
+    data[p] = NULL;
+    if (p >= av_pix_fmt_count_planes(frame->format))
+      continue;
+    for (int c = 0; c < desc->nb_components; c++)
+    {
+      if (desc->comp[c].plane == p)
+        step = desc->comp[c].step;
+    }
+    mml_frame_plane_shift(desc, p, &shift_w, &shift_h);
+    data[p] = frame->data[p] + (ptrdiff_t)(y >> shift_h) * frame->linesize[p] + (x >> shift_w) * step;
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Allocates a pooled buffer, painting the border once so that it survives 
+** every reuse of the buffer.
+*/
+static AVBufferRef*
+mml_frame_pool_alloc(void* opaque, size_t size)
+{
+  mml_frame_pool_p  pool  = (mml_frame_pool_p)opaque;
+  AVBufferRef*      buf   = av_buffer_alloc(size);
+  uint8_t*          data[4];
+  
+  mml_buffers_count();
+  if (buf == NULL || !pool->border)
+    return buf;
+  
+  for (int p = 0; p < 4; p++)
+    data[p] = pool->linesize[p] > 0 ? buf->data + pool->offset[p] : NULL;
+  mml_frame_fill_planes(pool->format, 
+                        pool->width, 
+                        pool->height, 
+                        data, 
+                        pool->linesize, 
+                        pool->x, 
+                        pool->y, 
+                        pool->rect_width, 
+                        pool->rect_height, 
+                        pool->color);
+  return buf;
+}
+
+/*!
+** Initializes a pool of frames of one format and size.
+*/
+int
+mml_frame_pool_init(mml_frame_pool_p pool, int format, int width, int height)
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+  size_t                    size = 0;
+  
+  memset(pool, 0, sizeof(*pool));
+  if (desc == NULL || width <= 0 || height <= 0 ||
+      av_image_fill_linesizes(pool->linesize, format, FFALIGN(width, 32)) < 0)
+    return MML_ERROR_NOT_FOUND;
+  
+  /*!
+  ** 所有平面放在一块缓冲里，每行按64字节对齐。
+  */
+  for (int p = 0; p < av_pix_fmt_count_planes(format); p++)
+  {
+    int shift_w, shift_h;
+    mml_frame_plane_shift(desc, p, &shift_w, &shift_h);
+    pool->linesize[p] = FFALIGN(pool->linesize[p], 64);
+    pool->offset[p] = size;
+    size += (size_t)pool->linesize[p] * MML_CEIL_RSHIFT(height, shift_h);
+  }
+  
+  pool->format = format;
+  pool->width = width;
+  pool->height = height;
+  pool->pool = av_buffer_pool_init2(size + AV_INPUT_BUFFER_PADDING_SIZE, 
+                                    pool, 
+                                    mml_frame_pool_alloc, 
+                                    NULL);
+  return pool->pool != NULL ? MML_SUCCESS : MML_ERROR_FRAME_NOT_CREATED;
+}
+
+/*!
+** Initializes a pool of audio frames of one sample format and size.
+*/
+int
+mml_frame_pool_init_audio(mml_frame_pool_p        pool, 
+                          int                     format, 
+                          const AVChannelLayout*  ch_layout, 
+                          int                     sample_rate, 
+                          int                     nb_samples)
+{
+  int size;
+  
+  memset(pool, 0, sizeof(*pool));
+  pool->planes = av_sample_fmt_is_planar(format) ? ch_layout->nb_channels : 1;
+  size = av_samples_get_buffer_size(&pool->linesize[0], 
+                                    ch_layout->nb_channels, 
+                                    nb_samples, 
+                                    format, 
+                                    0);
+  if (nb_samples <= 0 || size < 0 || 
+      av_channel_layout_copy(&pool->ch_layout, ch_layout) < 0)
+    return MML_ERROR_NOT_FOUND;
+  
+  pool->format = format;
+  pool->nb_samples = nb_samples;
+  pool->sample_rate = sample_rate;
+  /*!
+  ** 平面数超过AVFrame.data时需要单独分配extended_data，不走池。
+  */
+  if (pool->planes > AV_NUM_DATA_POINTERS)
+    return MML_SUCCESS;
+  pool->pool = av_buffer_pool_init2(size, pool, mml_frame_pool_alloc, NULL);
+  return pool->pool != NULL ? MML_SUCCESS : MML_ERROR_FRAME_NOT_CREATED;
+}
+
+/*!
+** Sets the border painted into every buffer of the pool.
+*/
+void
+mml_frame_pool_border(mml_frame_pool_p pool, 
+                      int              x, 
+                      int              y, 
+                      int              width, 
+                      int              height, 
+                      const uint8_t    color[3])
+{
+  pool->border = 1;
+  pool->x = x;
+  pool->y = y;
+  pool->rect_width = width;
+  pool->rect_height = height;
+  memcpy(pool->color, color, 3);
+}
+
+/*!
+** Attaches a pooled buffer to an empty frame.
+*/
+int
+mml_frame_pool_get(mml_frame_pool_p pool, AVFrame* frame)
+{
+  if (pool->pool == NULL && pool->nb_samples > 0)
+  {
+    frame->format = pool->format;
+    frame->nb_samples = pool->nb_samples;
+    frame->sample_rate = pool->sample_rate;
+    mml_buffers_count();
+    if (av_channel_layout_copy(&frame->ch_layout, &pool->ch_layout) < 0 ||
+        av_frame_get_buffer(frame, 0) < 0)
+      return MML_ERROR_FRAME_NOT_CREATED;
+    return MML_SUCCESS;
+  }
+  
+  frame->buf[0] = av_buffer_pool_get(pool->pool);
+  if (frame->buf[0] == NULL)
+    return MML_ERROR_FRAME_NOT_CREATED;
+  
+  frame->format = pool->format;
+  if (pool->nb_samples > 0)
+  {
+    frame->nb_samples = pool->nb_samples;
+    frame->sample_rate = pool->sample_rate;
+    if (av_channel_layout_copy(&frame->ch_layout, &pool->ch_layout) < 0)
+      return MML_ERROR_FRAME_NOT_CREATED;
+    for (int p = 0; p < pool->planes; p++)
+      frame->data[p] = frame->buf[0]->data + (size_t)p * pool->linesize[0];
+    frame->linesize[0] = pool->linesize[0];
+    frame->extended_data = frame->data;
+    return MML_SUCCESS;
+  }
+  
+  frame->width = pool->width;
+  frame->height = pool->height;
+  for (int p = 0; p < 4; p++)
+  {
+    frame->data[p] = pool->linesize[p] > 0 ? frame->buf[0]->data + pool->offset[p] : NULL;
+    frame->linesize[p] = pool->linesize[p];
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Releases the pool, buffers still referenced are freed when unreferenced.
+*/
+void
+mml_frame_pool_free(mml_frame_pool_p pool)
+{
+  av_buffer_pool_uninit(&pool->pool);
+  av_channel_layout_uninit(&pool->ch_layout);
+}
+
+/*!
+** Allocates an empty frame and counts it.
+*/
+AVFrame*
+mml_frame_new(void)
+{
+  mml_buffers_count();
+  return av_frame_alloc();
+}
+
+/*!
+** Allocates an empty packet and counts it.
+*/
+AVPacket*
+mml_packet_new(void)
+{
+  mml_buffers_count();
+  return av_packet_alloc();
+}
+
+/*
+********************************************************************************
+**
+** mml_buffers_allocated
+**
+********************************************************************************
+*/
+int64_t
+mml_buffers_allocated(void)
+{
+  return __atomic_load_n(&buffers_allocated, __ATOMIC_RELAXED);
+}
@@ -14,29 +14,424 @@ extern "C"
 {
 #endif
 
+#include <pthread.h>
 #include <libavutil/frame.h>
 
 #include "libmml.h"
 
+struct SwsContext;
+
 struct mml_encoder_s 
 {
   AVPacket*             pkt;
   AVCodec*              enc;
   AVCodecContext*       ctx;
   AVFormatContext*      fmt;
+  /*!
+  ** image export context, opened by the first frame and kept alive until the 
+  ** encoder is freed.
+  */
+  struct SwsContext*    sws;
+  AVFrame*              frame;
+};
+
+/*!
+** Bounded blocking FIFO connecting the stages of a threaded pipeline.
+*/
+struct mml_queue_s
+{
+  void**                items;
+  int                   capacity;
+  int                   head;
+  int                   count;
+  int                   closed;
+  pthread_mutex_t       mutex;
+  pthread_cond_t        not_empty;
+  pthread_cond_t        not_full;
+};
+
+typedef struct mml_queue_s mml_queue_t;
+typedef mml_queue_t* mml_queue_p;
+
+/*!
+** Lock-free bounded FIFO between exactly one producer thread and one consumer 
+** thread. Neither side ever blocks, a full or empty ring is reported instead.
+*/
+struct mml_ring_s
+{
+  void**                items;
+  int                   capacity;
+  uint64_t              head;
+  uint64_t              tail;
+};
+
+typedef struct mml_ring_s mml_ring_t;
+typedef mml_ring_t* mml_ring_p;
+
+/*!
+** Pool of refcounted frames of one format and size, the resolution of video 
+** frames or the sample count of audio frames. All planes of a frame live in 
+** one pooled buffer, optionally with a border painted once when the buffer is 
+** first allocated.
+*/
+struct mml_frame_pool_s
+{
+  AVBufferPool*         pool;
+  int                   format;
+  int                   width;
+  int                   height;
+  int                   linesize[4];
+  size_t                offset[4];
+  /*!
+  ** audio frames only, each of the planes is linesize[0] bytes.
+  */
+  int                   nb_samples;
+  int                   sample_rate;
+  int                   planes;
+  AVChannelLayout       ch_layout;
+  /*!
+  ** the border around the rectangle (x, y, rect_width, rect_height), painted 
+  ** with color when border is set.
+  */
+  int                   border;
+  int                   x;
+  int                   y;
+  int                   rect_width;
+  int                   rect_height;
+  uint8_t               color[3];
+};
+
+typedef struct mml_frame_pool_s mml_frame_pool_t;
+typedef mml_frame_pool_t* mml_frame_pool_p;
+
+/*!
+** The state of the operations run in a context. The error message and the 
+** statistics of the functions called without context go to the default 
+** context of the calling thread.
+*/
+struct mml_context_s
+{
+  char                  error[4096 * 4];
+  mml_options_t         options;
+  int                   map_inputs;
+  int64_t               bytes_read;
+  int64_t               buffers_allocated;
+  /*!
+  ** the context of the thread that started a worker thread, NULL outside of 
+  ** worker threads.
+  */
+  mml_context_p         parent;
+  /*!
+  ** the workers started and not joined yet, and whether one of them failed 
+  ** first, guarded by the lock of the worker threads.
+  */
+  int                   workers;
+  int                   worker_failed;
 };
 
+/*!
+** What identifies a version of a file, a fast probe and a full probe of the 
+** same file are cached apart.
+*/
+typedef struct mml_cache_key_s
+{
+  int64_t                           fast;
+  int64_t                           dev;
+  int64_t                           ino;
+  int64_t                           size;
+  int64_t                           mtime;
+  int64_t                           mtime_nsec;
+} mml_cache_key_t;
+
+/*
+********************************************************************************
+** INTERNAL CONTEXT FUNCTIONS
+********************************************************************************
+*/
+
+/*!
+** Gets the context of the calling thread, the one of the running context 
+** variant or else the default context of the thread.
+*/
+mml_context_p
+mml_context_current(void);
+
+/*!
+** Makes a context the one of the calling thread.
+**
+** @return the previous context, to be given to mml_context_leave
+*/
+mml_context_p
+mml_context_enter(mml_context_p ctx);
+
+/*!
+** Restores the previous context of the calling thread.
+*/
+void
+mml_context_leave(mml_context_p prev);
+
+/*!
+** Creates a thread running in the context of the calling thread, like 
+** pthread_create with default attributes. The thread writes its error into a 
+** context of its own, so workers never write the same error buffer at once, 
+** and counts its buffers in the outermost context that started it.
+**
+** @return 0 or an error number
+*/
+int
+mml_thread_create(pthread_t* thread, void* (*start)(void*), void* arg);
+
+/*!
+** Waits for a thread created by mml_thread_create, like pthread_join. The 
+** error of the first of the concurrent workers that failed is copied into 
+** the context of the calling thread.
+**
+** @return 0 or an error number
+*/
+int
+mml_thread_join(pthread_t thread);
+
+/*
+********************************************************************************
+** INTERNAL QUEUE FUNCTIONS
+********************************************************************************
+*/
+
+/*!
+** Initializes an empty queue holding at most capacity items.
+**
+** @param queue
+**        the queue
+**
+** @param capacity
+**        the maximum number of queued items
+**
+** @return success or error code
+*/
+int
+mml_queue_init(mml_queue_p queue, int capacity);
+
+/*!
+** Releases the resources of the queue, not the queued items.
+*/
+void
+mml_queue_free(mml_queue_p queue);
+
+/*!
+** Appends an item, blocking while the queue is full.
+**
+** @return success, or MML_ERROR_NO_CONTENT if the queue is closed
+*/
+int
+mml_queue_push(mml_queue_p queue, void* item);
+
+/*!
+** Takes the oldest item, blocking while the queue is empty.
+**
+** @return success, or MML_ERROR_NO_CONTENT if the queue is closed and drained
+*/
+int
+mml_queue_pop(mml_queue_p queue, void** item);
+
+/*!
+** Closes the queue and wakes up all waiting threads. Queued items can still be 
+** popped.
+*/
+void
+mml_queue_close(mml_queue_p queue);
+
+/*!
+** Initializes an empty ring holding at most capacity items.
+**
+** @return success or error code
+*/
+int
+mml_ring_init(mml_ring_p ring, int capacity);
+
+/*!
+** Releases the resources of the ring, not the items in it.
+*/
+void
+mml_ring_free(mml_ring_p ring);
+
+/*!
+** Appends an item, to be called from the producer thread only.
+**
+** @return success, or MML_ERROR_NO_CONTENT if the ring is full
+*/
+int
+mml_ring_push(mml_ring_p ring, void* item);
+
+/*!
+** Takes the oldest item, to be called from the consumer thread only.
+**
+** @return success, or MML_ERROR_NO_CONTENT if the ring is empty
+*/
+int
+mml_ring_pop(mml_ring_p ring, void** item);
+
+/*
+********************************************************************************
+** INTERNAL CACHE FUNCTIONS
+********************************************************************************
+*/
+
+/*!
+** Looks up the probed information of a file, checking that the file has not 
+** changed since.
+**
+** @param path
+**        the file path
+**
+** @param fast
+**        non-zero for the result of a fast probe
+**
+** @param info [out]
+**        the cached media information
+**
+** @param key [out]
+**        the version of the file looked up, to be given to mml_cache_put when 
+**        the file is probed after a miss
+**
+** @return success, or MML_ERROR_NOT_FOUND on a miss or if the cache is disabled
+*/
+int
+mml_cache_get(const char* path, int fast, mml_media_info_t* info, mml_cache_key_t* key);
+
+/*!
+** Stores the probed information of a file under the version taken by 
+** mml_cache_get before the file was opened, so a file changed while it was 
+** probed is not cached as the new version. Nothing is done if the cache is 
+** disabled or the file was not found.
+*/
+void
+mml_cache_put(const char* path, const mml_cache_key_t* key, const mml_media_info_t* info);
+
+/*
+********************************************************************************
+** INTERNAL IO FUNCTIONS
+********************************************************************************
+*/
+
+/*!
+** Whether a path stands for an io rather than a file.
+*/
+int
+mml_io_is_path(const char* path);
+
+/*!
+** Finds the io a path stands for, among the ios given a path and not freed 
+** since.
+**
+** @return the io, or NULL for a file path or a path of no live io
+*/
+mml_io_t*
+mml_io_find(const char* path);
+
+/*!
+** Gets the name guessing the format of an output, the path itself or the name 
+** hint of its io.
+*/
+const char*
+mml_io_name(const char* path);
+
+/*!
+** Opens an input format context on a file path or an io path. Local files 
+** are mapped into memory when mml_io_map_inputs enabled it.
+**
+** @param path
+**        the file path or io path
+**
+** @param fmt_ctx [out]
+**        the input format context
+**
+** @param options [in,out]
+**        the demuxer options, or NULL
+**
+** @param access
+**        MML_IO_NORMAL, MML_IO_SEQUENTIAL or MML_IO_RANDOM, how the input is 
+**        read when it is mapped into memory
+**
+** @return success, or MML_ERROR_FILE_OPEN_FAILED
+*/
+int
+mml_input_open(const char*              path, 
+               AVFormatContext**        fmt_ctx,
+               AVDictionary**           options,
+               int                      access);
+
+/*!
+** Closes an input format context opened by mml_input_open.
+*/
+void
+mml_input_close(AVFormatContext**       fmt_ctx);
+
+/*!
+** Opens the byte stream of an output format context on a file path or an io 
+** path.
+**
+** @return success, or MML_ERROR_FILE_OPEN_FAILED
+*/
+int
+mml_output_open(AVFormatContext*        fmt_ctx, 
+                const char*             path);
+
+/*!
+** Flushes and closes the byte stream opened by mml_output_open.
+*/
+void
+mml_output_close(AVFormatContext*       fmt_ctx);
+
 /*
 ********************************************************************************
 ** INTERNAL FRAME FUNCTIONS
 ********************************************************************************
 */
 
+/*!
+** Opens the image encoder, the scaler and the RGB frame buffer of the encoder 
+** for frames with the same geometry and pixel format as the given frame. 
+** Nothing is done if the encoder is already open for them.
+**
+** @param encoder
+**        the image encoder
+**
+** @param orig_frame
+**        the decoded frame
+**
+** @return success or error code
+*/
+int
+mml_frame_image_open(const mml_encoder_p    encoder, 
+                     const AVFrame*         orig_frame);
+
+/*!
+** Converts and compresses a frame into an image packet.
+**
+** @param encoder
+**        the image encoder, opened on demand by the first frame
+**
+** @param orig_frame
+**        the decoded frame
+**
+** @param pkt [out]
+**        the image data, to be unreferenced by the caller
+**
+** @return success or error code
+*/
+int
+mml_frame_encode_image(const mml_encoder_p    encoder, 
+                       const AVFrame*         orig_frame,
+                       AVPacket*              pkt);
+
 /*!
 ** Saves a frame as an image under the given output path.
 **
-** @param frame
-**        the frame
+** @param encoder
+**        the image encoder, opened on demand by the first frame
+**
+** @param orig_frame
+**        the decoded frame
 **
 ** @param output_path
 **        the output image path
@@ -46,9 +441,207 @@ struct mml_encoder_s
 int
 mml_frame_save_image(const mml_encoder_p    encoder, 
                      const AVFrame*         orig_frame,
-                     AVFrame*               rgb_frame,
                      const char*            output_path);
 
+/*!
+** Converts a color into limited range BT.601 YUV.
+**
+** @param rgb
+**        the color as 0xRRGGBB
+**
+** @param yuv [out]
+**        the Y, U and V values
+*/
+void
+mml_frame_color_yuv(uint32_t rgb, uint8_t yuv[3]);
+
+/*!
+** Rounds an offset in a frame down to the chroma subsampling of its format, 
+** so that the chroma samples at the offset are not shared with the pixels 
+** before it. The offset is left as it is for an unknown format.
+**
+** @param format
+**        the pixel format
+**
+** @param x [in, out]
+**        the horizontal offset
+**
+** @param y [in, out]
+**        the vertical offset
+*/
+void
+mml_frame_align_offset(int format, int* x, int* y);
+
+/*!
+** Fills the border of a frame around a rectangle with a color, leaving the 
+** rectangle untouched. Only the border is written, row by row. Planar and 
+** semi-planar YUV formats of any bit depth are supported.
+**
+** @param frame
+**        the frame
+**
+** @param x
+**        the left of the rectangle
+**
+** @param y
+**        the top of the rectangle
+**
+** @param width
+**        the width of the rectangle
+**
+** @param height
+**        the height of the rectangle
+**
+** @param color
+**        the 8-bit Y, U and V values, scaled to the depth of the format
+**
+** @return success, or MML_ERROR_NOT_FOUND if the format is not supported
+*/
+int
+mml_frame_fill_border(AVFrame*         frame, 
+                      int              x, 
+                      int              y, 
+                      int              width, 
+                      int              height, 
+                      const uint8_t    color[3]);
+
+/*!
+** Copies a frame into a rectangle of a larger frame with the same format.
+**
+** @param dst
+**        the larger frame
+**
+** @param src
+**        the frame to copy
+**
+** @param x
+**        the left of the rectangle
+**
+** @param y
+**        the top of the rectangle
+**
+** @return success, or MML_ERROR_NOT_FOUND if the frame does not fit
+*/
+int
+mml_frame_copy_rect(AVFrame*         dst, 
+                    const AVFrame*   src, 
+                    int              x, 
+                    int              y);
+
+/*!
+** Gets the plane pointers of a rectangle inside a frame, so that a scaler can 
+** write into the rectangle directly. The line sizes are those of the frame.
+**
+** @param frame
+**        the frame
+**
+** @param x
+**        the left of the rectangle
+**
+** @param y
+**        the top of the rectangle
+**
+** @param data [out]
+**        the plane pointers, NULL for unused planes
+**
+** @return success, or MML_ERROR_NOT_FOUND if the rectangle is outside the frame
+*/
+int
+mml_frame_rect_planes(const AVFrame*   frame, 
+                      int              x, 
+                      int              y, 
+                      uint8_t*         data[4]);
+
+/*!
+** Initializes a pool of frames.
+**
+** @param pool
+**        the pool
+**
+** @param format
+**        the pixel format of the frames
+**
+** @param width
+**        the width of the frames
+**
+** @param height
+**        the height of the frames
+**
+** @return success or error code
+*/
+int
+mml_frame_pool_init(mml_frame_pool_p pool, int format, int width, int height);
+
+/*!
+** Initializes a pool of audio frames.
+**
+** @param pool
+**        the pool
+**
+** @param format
+**        the sample format of the frames
+**
+** @param ch_layout
+**        the channel layout of the frames
+**
+** @param sample_rate
+**        the sample rate of the frames
+**
+** @param nb_samples
+**        the number of samples per channel each frame can hold
+**
+** @return success or error code. Frames with more planes than AVFrame.data 
+**         holds are allocated one by one instead of pooled.
+*/
+int
+mml_frame_pool_init_audio(mml_frame_pool_p        pool, 
+                          int                     format, 
+                          const AVChannelLayout*  ch_layout, 
+                          int                     sample_rate, 
+                          int                     nb_samples);
+
+/*!
+** Sets a border painted into every buffer allocated by the pool afterwards. 
+** Buffers are reused as they are, so writers must only touch the rectangle.
+**
+** @param color
+**        the 8-bit Y, U and V values, see mml_frame_fill_border
+*/
+void
+mml_frame_pool_border(mml_frame_pool_p pool, 
+                      int              x, 
+                      int              y, 
+                      int              width, 
+                      int              height, 
+                      const uint8_t    color[3]);
+
+/*!
+** Attaches a pooled buffer to an unreferenced frame. The buffer returns to the 
+** pool when the last reference to it is dropped.
+**
+** @return success or error code
+*/
+int
+mml_frame_pool_get(mml_frame_pool_p pool, AVFrame* frame);
+
+/*!
+** Releases the pool. Buffers still referenced are freed once unreferenced.
+*/
+void
+mml_frame_pool_free(mml_frame_pool_p pool);
+
+/*!
+** Allocates an empty frame, counted by mml_buffers_allocated.
+*/
+AVFrame*
+mml_frame_new(void);
+
+/*!
+** Allocates an empty packet, counted by mml_buffers_allocated.
+*/
+AVPacket*
+mml_packet_new(void);
+
 /*!
 ** Encodes a frame into a packet.
 **
@@ -0,0 +1,755 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libavformat/avformat.h>
+
+#include "libmml-internal.h"
+
+#define MML_IO_PREFIX                           "mmlio://"
+/*!
+** the buffer size of the file protocol of libavformat, so an fd io issues the 
+** same reads.
+*/
+#define MML_IO_BUFFER_SIZE                      32768
+
+/*!
+** non-zero to map local input files into memory.
+*/
+static int map_inputs = 0;
+
+/*!
+** the ios given a path, looked up by the number in the path, so a path never 
+** reaches an io that was freed or initialized again.
+*/
+typedef struct mml_io_entry_s
+{
+  unsigned long long    id;
+  mml_io_t*             io;
+} mml_io_entry_t;
+
+static pthread_mutex_t  registry_mutex      = PTHREAD_MUTEX_INITIALIZER;
+static mml_io_entry_t*  registry            = NULL;
+static int              registry_size       = 0;
+static int              registry_capacity   = 0;
+static unsigned long long registry_next_id  = 0;
+
+/*!
+** One open of an io. Memory ios opened for reading are read from a position 
+** of their own for each open, so the same io can be read by several opens at 
+** once; writing goes through the io and its own position.
+*/
+typedef struct mml_io_cursor_s
+{
+  mml_io_t*             io;
+  int                   shared;
+  size_t                pos;
+} mml_io_cursor_t;
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+#define MML_IO_CONST                            const
+#else
+#define MML_IO_CONST
+#endif
+
+/*
+********************************************************************************
+** MEMORY AND FILE DESCRIPTOR IMPLEMENTATIONS
+********************************************************************************
+*/
+
+static int
+mml_io_memory_read(void* opaque, uint8_t* buf, int size)
+{
+  mml_io_t* io = (mml_io_t*)opaque;
+  
+  if (io->pos >= io->size)
+    return 0;
+  if ((size_t)size > io->size - io->pos)
+    size = (int)(io->size - io->pos);
+  memcpy(buf, io->data + io->pos, size);
+  io->pos += size;
+  return size;
+}
+
+static int
+mml_io_memory_write(void* opaque, const uint8_t* buf, int size)
+{
+  mml_io_t*   io = (mml_io_t*)opaque;
+  uint8_t*    data;
+  size_t      capacity;
+  
+  /*!
+  ** 调用方提供的缓冲区只读。
+  */
+  if (!io->owned)
+    return -1;
+  if (io->pos + size > io->capacity)
+  {
+    capacity = io->capacity > 0 ? io->capacity : MML_IO_BUFFER_SIZE;
+    while (capacity < io->pos + size)
+      capacity *= 2;
+    if ((data = (uint8_t*)realloc(io->data, capacity)) == NULL)
+      return -1;
+    io->data = data;
+    io->capacity = capacity;
+  }
+  memcpy(io->data + io->pos, buf, size);
+  io->pos += size;
+  if (io->pos > io->size)
+    io->size = io->pos;
+  return size;
+}
+
+static int64_t
+mml_io_memory_seek(void* opaque, int64_t offset, int whence)
+{
+  mml_io_t* io = (mml_io_t*)opaque;
+  
+  switch (whence)
+  {
+  case MML_IO_SIZE:
+    return (int64_t)io->size;
+  case SEEK_CUR:
+    offset += (int64_t)io->pos;
+    break;
+  case SEEK_END:
+    offset += (int64_t)io->size;
+    break;
+  case SEEK_SET:
+    break;
+  default:
+    return -1;
+  }
+  /*!
+  ** 写入时可以越过末尾，空洞在下次写入时补上。
+  */
+  if (offset < 0 || (!io->owned && offset > (int64_t)io->size))
+    return -1;
+  if (io->owned && (size_t)offset > io->size)
+  {
+    if ((size_t)offset > io->capacity)
+    {
+      uint8_t* data = (uint8_t*)realloc(io->data, (size_t)offset);
+      if (data == NULL)
+        return -1;
+      io->data = data;
+      io->capacity = (size_t)offset;
+    }
+    memset(io->data + io->size, 0, (size_t)offset - io->size);
+    io->size = (size_t)offset;
+  }
+  io->pos = (size_t)offset;
+  return offset;
+}
+
+static int
+mml_io_fd_read(void* opaque, uint8_t* buf, int size)
+{
+  mml_io_t*   io = (mml_io_t*)opaque;
+  ssize_t     ret;
+  
+  do
+    ret = read(io->fd, buf, size);
+  while (ret < 0 && errno == EINTR);
+  return (int)ret;
+}
+
+static int
+mml_io_fd_write(void* opaque, const uint8_t* buf, int size)
+{
+  mml_io_t*   io = (mml_io_t*)opaque;
+  ssize_t     ret;
+  int         written = 0;
+  
+  while (written < size)
+  {
+    ret = write(io->fd, buf + written, size - written);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return -1;
+    written += (int)ret;
+  }
+  return written;
+}
+
+static int64_t
+mml_io_fd_seek(void* opaque, int64_t offset, int whence)
+{
+  mml_io_t*   io = (mml_io_t*)opaque;
+  struct stat st;
+  
+  if (whence == MML_IO_SIZE)
+  {
+    /*!
+    ** 和 file 协议一样用一次 fstat 取大小，管道等没有大小。
+    */
+    if (fstat(io->fd, &st) != 0 || !S_ISREG(st.st_mode))
+      return -1;
+    return (int64_t)st.st_size;
+  }
+  return (int64_t)lseek(io->fd, (off_t)offset, whence);
+}
+
+/*!
+** Finds the registry entry of an io, called with the registry locked.
+**
+** @return the index of the entry, or -1
+*/
+static int
+mml_io_entry(const mml_io_t* io)
+{
+  for (int i = 0; i < registry_size; i++)
+  {
+    if (registry[i].io == io)
+      return i;
+  }
+  return -1;
+}
+
+const char*
+mml_io_path(mml_io_t* io)
+{
+  int index;
+  
+  pthread_mutex_lock(&registry_mutex);
+  /*!
+  ** 已经登记过的 io 沿用原来的路径，重新初始化过的 io 换一个编号。
+  */
+  index = mml_io_entry(io);
+  if (index >= 0 && io->path[0] != '\0')
+  {
+    pthread_mutex_unlock(&registry_mutex);
+    return io->path;
+  }
+  if (index < 0 && registry_size == registry_capacity)
+  {
+    int capacity = registry_capacity > 0 ? registry_capacity * 2 : 16;
+    mml_io_entry_t* entries = (mml_io_entry_t*)realloc(registry, capacity * sizeof(mml_io_entry_t));
+    if (entries == NULL)
+    {
+      pthread_mutex_unlock(&registry_mutex);
+      /*!
+      ** 编号 0 不会分配给任何 io，打开时报错。
+      */
+      snprintf(io->path, sizeof(io->path), MML_IO_PREFIX "0");
+      return io->path;
+    }
+    registry = entries;
+    registry_capacity = capacity;
+  }
+  if (index < 0)
+    index = registry_size++;
+  registry[index].id = ++registry_next_id;
+  registry[index].io = io;
+  snprintf(io->path, sizeof(io->path), MML_IO_PREFIX "%llu", registry_next_id);
+  pthread_mutex_unlock(&registry_mutex);
+  return io->path;
+}
+
+void
+mml_io_memory(mml_io_t* io, const void* data, size_t size)
+{
+  memset(io, 0, sizeof(mml_io_t));
+  io->read = mml_io_memory_read;
+  io->seek = mml_io_memory_seek;
+  io->opaque = io;
+  io->data = (uint8_t*)data;
+  io->size = size;
+  io->fd = -1;
+}
+
+void
+mml_io_buffer(mml_io_t* io, const char* name)
+{
+  memset(io, 0, sizeof(mml_io_t));
+  io->read = mml_io_memory_read;
+  io->write = mml_io_memory_write;
+  io->seek = mml_io_memory_seek;
+  io->opaque = io;
+  io->name = name;
+  io->fd = -1;
+  io->owned = 1;
+}
+
+void
+mml_io_fd(mml_io_t* io, int fd, const char* name)
+{
+  memset(io, 0, sizeof(mml_io_t));
+  io->read = mml_io_fd_read;
+  io->write = mml_io_fd_write;
+  io->seek = mml_io_fd_seek;
+  io->opaque = io;
+  io->name = name;
+  io->fd = fd;
+  /*!
+  ** 管道和套接字不可定位，按顺序读写处理。
+  */
+  if (lseek(fd, 0, SEEK_CUR) < 0)
+    io->seek = NULL;
+}
+
+int
+mml_io_mmap(mml_io_t* io, const char* path, int access)
+{
+  struct stat   st;
+  void*         data;
+  int           fd;
+  int           advice;
+  
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return MML_ERROR_FILE_NOT_EXIST;
+  /*!
+  ** 空文件无法映射。
+  */
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+  {
+    close(fd);
+    return MML_ERROR_FILE_OPEN_FAILED;
+  }
+  data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return MML_ERROR_FILE_OPEN_FAILED;
+  
+  switch (access)
+  {
+  case MML_IO_SEQUENTIAL:
+    advice = MADV_SEQUENTIAL;
+    break;
+  case MML_IO_RANDOM:
+    advice = MADV_RANDOM;
+    break;
+  default:
+    advice = MADV_NORMAL;
+    break;
+  }
+  madvise(data, (size_t)st.st_size, advice);
+  
+  mml_io_memory(io, data, (size_t)st.st_size);
+  io->mapped = 1;
+  return MML_SUCCESS;
+}
+
+void
+mml_io_map_inputs(int enable)
+{
+  __atomic_store_n(&map_inputs, enable, __ATOMIC_RELAXED);
+}
+
+void
+mml_io_rewind(mml_io_t* io)
+{
+  if (io->seek != NULL)
+    io->seek(io->opaque, 0, SEEK_SET);
+}
+
+void
+mml_io_free(mml_io_t* io)
+{
+  int index;
+  
+  pthread_mutex_lock(&registry_mutex);
+  if ((index = mml_io_entry(io)) >= 0)
+    registry[index] = registry[--registry_size];
+  pthread_mutex_unlock(&registry_mutex);
+  io->path[0] = '\0';
+  
+  if (io->owned)
+    free(io->data);
+  else if (io->mapped)
+    munmap(io->data, io->size);
+  io->data = NULL;
+  io->mapped = 0;
+  io->size = 0;
+  io->capacity = 0;
+  io->pos = 0;
+}
+
+/*
+********************************************************************************
+** AVIOCONTEXT ADAPTER
+********************************************************************************
+*/
+
+/*!
+** Whether an io reads from its memory buffer, which every open can read from 
+** its own position.
+*/
+static int
+mml_io_shared(const mml_io_t* io)
+{
+  return io->read == mml_io_memory_read && io->opaque == io;
+}
+
+/*!
+** Takes an io for one open. Memory ios can be read by several opens at once, 
+** everything else, and writing, needs the io alone.
+**
+** @return zero, or -1 when the io is already open
+*/
+static int
+mml_io_acquire(mml_io_t* io, int write_flag)
+{
+  int opens = __atomic_load_n(&io->opens, __ATOMIC_ACQUIRE);
+  
+  do
+  {
+    if (opens < 0 || (opens > 0 && (write_flag || !mml_io_shared(io))))
+      return -1;
+  }
+  while (!__atomic_compare_exchange_n(&io->opens, 
+                                      &opens, 
+                                      write_flag || !mml_io_shared(io) ? -1 : opens + 1, 
+                                      0, 
+                                      __ATOMIC_ACQ_REL, 
+                                      __ATOMIC_ACQUIRE));
+  return 0;
+}
+
+static void
+mml_io_release(mml_io_t* io)
+{
+  int opens = __atomic_load_n(&io->opens, __ATOMIC_ACQUIRE);
+  
+  while (!__atomic_compare_exchange_n(&io->opens, 
+                                      &opens, 
+                                      opens < 0 ? 0 : opens - 1, 
+                                      0, 
+                                      __ATOMIC_ACQ_REL, 
+                                      __ATOMIC_ACQUIRE))
+    ;
+}
+
+static int
+mml_avio_read(void* opaque, uint8_t* buf, int size)
+{
+  mml_io_cursor_t*  cursor  = (mml_io_cursor_t*)opaque;
+  mml_io_t*         io      = cursor->io;
+  int               ret;
+  
+  if (cursor->shared)
+  {
+    if (cursor->pos >= io->size)
+      return AVERROR_EOF;
+    if ((size_t)size > io->size - cursor->pos)
+      size = (int)(io->size - cursor->pos);
+    memcpy(buf, io->data + cursor->pos, size);
+    cursor->pos += size;
+    return size;
+  }
+  ret = io->read(io->opaque, buf, size);
+  /*!
+  ** FFmpeg 要求以 AVERROR_EOF 而不是 0 表示读完。
+  */
+  if (ret == 0)
+    return AVERROR_EOF;
+  return ret < 0 ? AVERROR(EIO) : ret;
+}
+
+static int
+mml_avio_write(void* opaque, MML_IO_CONST uint8_t* buf, int size)
+{
+  mml_io_t*   io = ((mml_io_cursor_t*)opaque)->io;
+  
+  return io->write(io->opaque, buf, size) == size ? size : AVERROR(EIO);
+}
+
+static int64_t
+mml_avio_seek(void* opaque, int64_t offset, int whence)
+{
+  mml_io_cursor_t*  cursor  = (mml_io_cursor_t*)opaque;
+  mml_io_t*         io      = cursor->io;
+  int64_t           ret;
+  
+  whence &= ~AVSEEK_FORCE;
+  /*!
+  ** 写入时定位必须落到 io 自己的位置上，回填的头部才能写到原处。
+  */
+  if (cursor->shared)
+  {
+    switch (whence)
+    {
+    case AVSEEK_SIZE:
+      return (int64_t)io->size;
+    case SEEK_CUR:
+      offset += (int64_t)cursor->pos;
+      break;
+    case SEEK_END:
+      offset += (int64_t)io->size;
+      break;
+    case SEEK_SET:
+      break;
+    default:
+      return AVERROR(EINVAL);
+    }
+    if (offset < 0 || offset > (int64_t)io->size)
+      return AVERROR(EIO);
+    cursor->pos = (size_t)offset;
+    return offset;
+  }
+  ret = io->seek(io->opaque, offset, whence == AVSEEK_SIZE ? MML_IO_SIZE : whence);
+  return ret < 0 ? AVERROR(EIO) : ret;
+}
+
+/*!
+** Creates the AVIOContext of one open of an io. Memory ios are read from the 
+** start, the others from their current position.
+**
+** @return the context, or NULL when it cannot be allocated or the io is 
+**         already open
+*/
+static AVIOContext*
+mml_avio_alloc(mml_io_t* io, int write_flag)
+{
+  AVIOContext*      pb;
+  unsigned char*    buffer;
+  mml_io_cursor_t*  cursor;
+  
+  if (mml_io_acquire(io, write_flag) != 0)
+    return NULL;
+  buffer = (unsigned char*)av_malloc(MML_IO_BUFFER_SIZE);
+  cursor = (mml_io_cursor_t*)calloc(1, sizeof(mml_io_cursor_t));
+  if (buffer == NULL || cursor == NULL)
+  {
+    av_free(buffer);
+    free(cursor);
+    mml_io_release(io);
+    return NULL;
+  }
+  cursor->io = io;
+  cursor->shared = !write_flag && mml_io_shared(io);
+  pb = avio_alloc_context(buffer, 
+                          MML_IO_BUFFER_SIZE, 
+                          write_flag, 
+                          cursor, 
+                          io->read != NULL ? mml_avio_read : NULL, 
+                          io->write != NULL ? mml_avio_write : NULL, 
+                          io->seek != NULL ? mml_avio_seek : NULL);
+  if (pb == NULL)
+  {
+    av_free(buffer);
+    free(cursor);
+    mml_io_release(io);
+    return NULL;
+  }
+  /*!
+  ** 不可定位时 FFmpeg 只能顺序读写，MP4 等输出的头部无法回填。
+  */
+  pb->seekable = io->seek != NULL ? AVIO_SEEKABLE_NORMAL : 0;
+  return pb;
+}
+
+static void
+mml_avio_free(AVIOContext** pb)
+{
+  mml_io_cursor_t* cursor;
+  
+  if (*pb == NULL)
+    return;
+  cursor = (mml_io_cursor_t*)(*pb)->opaque;
+  mml_io_release(cursor->io);
+  free(cursor);
+  av_freep(&(*pb)->buffer);
+  avio_context_free(pb);
+}
+
+int
+mml_io_is_path(const char* path)
+{
+  return path != NULL && strncmp(path, MML_IO_PREFIX, strlen(MML_IO_PREFIX)) == 0;
+}
+
+mml_io_t*
+mml_io_find(const char* path)
+{
+  mml_io_t*           io    = NULL;
+  unsigned long long  id;
+  char*               end;
+  
+  if (!mml_io_is_path(path))
+    return NULL;
+  errno = 0;
+  id = strtoull(path + strlen(MML_IO_PREFIX), &end, 10);
+  if (errno != 0 || *end != '\0' || id == 0)
+    return NULL;
+  
+  /*!
+  ** 路径里只有编号，io 必须还在登记表里，并且没有被重新初始化。
+  */
+  pthread_mutex_lock(&registry_mutex);
+  for (int i = 0; i < registry_size; i++)
+  {
+    if (registry[i].id == id && strcmp(registry[i].io->path, path) == 0)
+    {
+      io = registry[i].io;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&registry_mutex);
+  return io;
+}
+
+const char*
+mml_io_name(const char* path)
+{
+  mml_io_t* io = mml_io_find(path);
+  
+  if (io == NULL)
+    return path;
+  return io->name;
+}
+
+/*!
+** Maps a local input file into a new io, when inputs are mapped.
+**
+** @return the io, or NULL to open the file through libavformat
+*/
+static mml_io_t*
+mml_io_map_input(const char* path, int access)
+{
+  mml_io_t*   io;
+  
+  if (!__atomic_load_n(&map_inputs, __ATOMIC_RELAXED) && !mml_context_current()->map_inputs)
+    return NULL;
+  /*!
+  ** 只映射本地文件，带协议的地址交给 libavformat。
+  */
+  if (strstr(path, "://") != NULL)
+    return NULL;
+  if ((io = (mml_io_t*)malloc(sizeof(mml_io_t))) == NULL)
+    return NULL;
+  if (mml_io_mmap(io, path, access) != MML_SUCCESS)
+  {
+    free(io);
+    return NULL;
+  }
+  io->name = path;
+  return io;
+}
+
+int
+mml_input_open(const char*              path, 
+               AVFormatContext**        fmt_ctx,
+               AVDictionary**           options,
+               int                      access)
+{
+  mml_io_t*         io        = NULL;
+  mml_io_t*         mapped    = NULL;
+  AVIOContext*      pb;
+  
+  if (mml_io_is_path(path) && (io = mml_io_find(path)) == NULL)
+    return MML_ERROR_FILE_OPEN_FAILED;
+  if (io == NULL && (io = mapped = mml_io_map_input(path, access)) == NULL)
+    return avformat_open_input(fmt_ctx, path, NULL, options) < 0 ? MML_ERROR_FILE_OPEN_FAILED : MML_SUCCESS;
+  
+  if (io->read == NULL)
+    return MML_ERROR_FILE_OPEN_FAILED;
+  /*!
+  ** 同一个 io 可以被多次打开，每次都从头读；内存 io 每次打开有自己的读位置，
+  ** 其它 io 同一时刻只能打开一次。
+  */
+  if ((pb = mml_avio_alloc(io, 0)) == NULL)
+    goto FAILED;
+  if (!mml_io_shared(io))
+    mml_io_rewind(io);
+  if ((*fmt_ctx = avformat_alloc_context()) == NULL)
+  {
+    mml_avio_free(&pb);
+    goto FAILED;
+  }
+  (*fmt_ctx)->pb = pb;
+  (*fmt_ctx)->flags |= AVFMT_FLAG_CUSTOM_IO;
+  /*!
+  ** 映射的 io 随格式上下文一起释放。
+  */
+  (*fmt_ctx)->opaque = mapped;
+  /*!
+  ** 打开失败时 FFmpeg 释放格式上下文，但不释放自定义的 pb。
+  */
+  if (avformat_open_input(fmt_ctx, io->name, NULL, options) < 0)
+  {
+    mml_avio_free(&pb);
+    goto FAILED;
+  }
+  return MML_SUCCESS;
+  
+FAILED:
+  
+  if (mapped != NULL)
+  {
+    mml_io_free(mapped);
+    free(mapped);
+  }
+  return MML_ERROR_FILE_OPEN_FAILED;
+}
+
+void
+mml_input_close(AVFormatContext**       fmt_ctx)
+{
+  AVIOContext*      pb        = NULL;
+  mml_io_t*         mapped    = NULL;
+  
+  if (*fmt_ctx == NULL)
+    return;
+  if ((*fmt_ctx)->flags & AVFMT_FLAG_CUSTOM_IO)
+  {
+    pb = (*fmt_ctx)->pb;
+    mapped = (mml_io_t*)(*fmt_ctx)->opaque;
+  }
+  avformat_close_input(fmt_ctx);
+  mml_avio_free(&pb);
+  if (mapped != NULL)
+  {
+    mml_io_free(mapped);
+    free(mapped);
+  }
+}
+
+int
+mml_output_open(AVFormatContext*        fmt_ctx, 
+                const char*             path)
+{
+  mml_io_t*         io;
+  
+  if ((io = mml_io_find(path)) == NULL)
+  {
+    if (mml_io_is_path(path))
+      return MML_ERROR_FILE_OPEN_FAILED;
+    return avio_open(&fmt_ctx->pb, path, AVIO_FLAG_WRITE) < 0 ? MML_ERROR_FILE_OPEN_FAILED : MML_SUCCESS;
+  }
+  
+  if (io->write == NULL)
+    return MML_ERROR_FILE_OPEN_FAILED;
+  if ((fmt_ctx->pb = mml_avio_alloc(io, 1)) == NULL)
+    return MML_ERROR_FILE_OPEN_FAILED;
+  fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+  return MML_SUCCESS;
+}
+
+void
+mml_output_close(AVFormatContext*       fmt_ctx)
+{
+  if (!(fmt_ctx->flags & AVFMT_FLAG_CUSTOM_IO))
+  {
+    avio_closep(&fmt_ctx->pb);
+    return;
+  }
+  if (fmt_ctx->pb != NULL)
+    avio_flush(fmt_ctx->pb);
+  mml_avio_free(&fmt_ctx->pb);
+}
@@ -0,0 +1,134 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdlib.h>
+#include <libavformat/avformat.h>
+
+#include "libmml-internal.h"
+
+int
+mml_queue_init(mml_queue_p queue, int capacity)
+{
+  queue->items = (void**)malloc(sizeof(void*) * capacity);
+  if (!queue->items)
+    return MML_ERROR_THREAD_NOT_CREATED;
+  queue->capacity = capacity;
+  queue->head = 0;
+  queue->count = 0;
+  queue->closed = 0;
+  pthread_mutex_init(&queue->mutex, NULL);
+  pthread_cond_init(&queue->not_empty, NULL);
+  pthread_cond_init(&queue->not_full, NULL);
+  return MML_SUCCESS;
+}
+
+void
+mml_queue_free(mml_queue_p queue)
+{
+  if (queue->items == NULL)
+    return;
+  pthread_mutex_destroy(&queue->mutex);
+  pthread_cond_destroy(&queue->not_empty);
+  pthread_cond_destroy(&queue->not_full);
+  free(queue->items);
+  queue->items = NULL;
+}
+
+int
+mml_queue_push(mml_queue_p queue, void* item)
+{
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->count == queue->capacity && !queue->closed)
+    pthread_cond_wait(&queue->not_full, &queue->mutex);
+  if (queue->closed)
+  {
+    pthread_mutex_unlock(&queue->mutex);
+    return MML_ERROR_NO_CONTENT;
+  }
+  queue->items[(queue->head + queue->count) % queue->capacity] = item;
+  queue->count++;
+  pthread_cond_signal(&queue->not_empty);
+  pthread_mutex_unlock(&queue->mutex);
+  return MML_SUCCESS;
+}
+
+int
+mml_queue_pop(mml_queue_p queue, void** item)
+{
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->count == 0 && !queue->closed)
+    pthread_cond_wait(&queue->not_empty, &queue->mutex);
+  if (queue->count == 0)
+  {
+    pthread_mutex_unlock(&queue->mutex);
+    return MML_ERROR_NO_CONTENT;
+  }
+  *item = queue->items[queue->head];
+  queue->head = (queue->head + 1) % queue->capacity;
+  queue->count--;
+  pthread_cond_signal(&queue->not_full);
+  pthread_mutex_unlock(&queue->mutex);
+  return MML_SUCCESS;
+}
+
+void
+mml_queue_close(mml_queue_p queue)
+{
+  if (queue->items == NULL)
+    return;
+  pthread_mutex_lock(&queue->mutex);
+  queue->closed = 1;
+  pthread_cond_broadcast(&queue->not_empty);
+  pthread_cond_broadcast(&queue->not_full);
+  pthread_mutex_unlock(&queue->mutex);
+}
+
+int
+mml_ring_init(mml_ring_p ring, int capacity)
+{
+  ring->items = (void**)malloc(sizeof(void*) * capacity);
+  if (!ring->items)
+    return MML_ERROR_THREAD_NOT_CREATED;
+  ring->capacity = capacity;
+  ring->head = 0;
+  ring->tail = 0;
+  return MML_SUCCESS;
+}
+
+void
+mml_ring_free(mml_ring_p ring)
+{
+  if (ring->items == NULL)
+    return;
+  free(ring->items);
+  ring->items = NULL;
+}
+
+int
+mml_ring_push(mml_ring_p ring, void* item)
+{
+  uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  if (tail - head == (uint64_t)ring->capacity)
+    return MML_ERROR_NO_CONTENT;
+  ring->items[tail % ring->capacity] = item;
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return MML_SUCCESS;
+}
+
+int
+mml_ring_pop(mml_ring_p ring, void** item)
+{
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  if (head == tail)
+    return MML_ERROR_NO_CONTENT;
+  *item = ring->items[head % ring->capacity];
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  return MML_SUCCESS;
+}
@@ -9,16 +9,22 @@
 #include <stdio.h>
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
+#include <libavcodec/bsf.h>
 #include <libswresample/swresample.h>
 #include <libswscale/swscale.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/avutil.h>
 #include <libavutil/opt.h>
+#include <libavutil/cpu.h>
+#include <libavutil/audio_fifo.h>
 
 #include "libmml.h"
 #include "libmml-internal.h"
 
-static char err_msg[4096 * 4];
+/*!
+** the error message of the context of the calling thread.
+*/
+#define err_msg                                 (mml_context_current()->error)
 
 int 
 mml_encoder_init(mml_encoder_p* encoder, int encoder_id)
@@ -26,6 +32,11 @@ mml_encoder_init(mml_encoder_p* encoder, int encoder_id)
   *encoder = (mml_encoder_p)malloc(sizeof(mml_encoder_t));
   if (!(*encoder)) 
     return MML_ERROR_CODEC_NOT_CREATED;
+  (*encoder)->ctx = NULL;
+  (*encoder)->pkt = NULL;
+  (*encoder)->fmt = NULL;
+  (*encoder)->sws = NULL;
+  (*encoder)->frame = NULL;
   (*encoder)->enc = (AVCodec*) avcodec_find_encoder(encoder_id);
   if (!(*encoder)->enc)
     return MML_ERROR_CODEC_NOT_FOUND;
@@ -47,6 +58,10 @@ mml_encoder_free(mml_encoder_p encoder)
     avcodec_free_context(&encoder->ctx);
   if (encoder->pkt != NULL)
     av_packet_free(&encoder->pkt);
+  if (encoder->sws != NULL)
+    sws_freeContext(encoder->sws);
+  if (encoder->frame != NULL)
+    av_frame_free(&encoder->frame);
   free(encoder);
   encoder = NULL;
 }
@@ -80,7 +95,7 @@ mml_enc_init(const char* 							filename,
 {
 	int 				ret;
   
-  avformat_alloc_output_context2(fmt_ctx, NULL, NULL, filename);
+  avformat_alloc_output_context2(fmt_ctx, NULL, NULL, mml_io_name(filename));
   if (!(*fmt_ctx))
   {
     ret = MML_ERROR_CODEC_NOT_CREATED;
@@ -108,16 +123,17 @@ mml_enc_init(const char* 							filename,
 }
 
 /*!
-**
+** Opens an input format context, access telling how it will be read when the 
+** file is mapped into memory.
 */
 static int 
 mml_format_open(const char* 							filename, 
-               	AVFormatContext** 				fmt_ctx)
+               	AVFormatContext** 				fmt_ctx,
+               	int                       access)
 {
 	int 				ret;
-  if ((ret = avformat_open_input(fmt_ctx, filename, NULL, NULL)) < 0) 
+  if ((ret = mml_input_open(filename, fmt_ctx, NULL, access)) != MML_SUCCESS) 
   {
-		ret = MML_ERROR_FILE_OPEN_FAILED;
     sprintf(err_msg, "'%s' file not open", filename);
     return ret;
   }
@@ -125,12 +141,177 @@ mml_format_open(const char* 							filename,
   return MML_SUCCESS;
 }
 
+/*!
+** Closes an input format context and records how many bytes were read from it.
+*/
+static void
+mml_format_close(AVFormatContext** 				fmt_ctx)
+{
+  if ((*fmt_ctx)->pb != NULL)
+    mml_context_current()->bytes_read = (*fmt_ctx)->pb->bytes_read;
+  mml_input_close(fmt_ctx);
+}
+
+/*!
+** Writes the header of an output, as fragmented MP4 when the options ask for 
+** it: the moov atom first, empty, and then a moof and mdat pair per video 
+** keyframe, so the output is playable while it is written and the muxer keeps 
+** no sample table for the whole file.
+**
+** @return the result of avformat_write_header
+*/
+static int
+mml_output_write_header(AVFormatContext*        fmt_ctx, 
+                        const mml_options_t*    options)
+{
+  AVDictionary*     dict      = NULL;
+  int               ret;
+  
+  if (options != NULL && options->fragmented)
+    av_dict_set(&dict, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+  ret = avformat_write_header(fmt_ctx, &dict);
+  av_dict_free(&dict);
+  return ret;
+}
+
+/*!
+** Seeks the input to the keyframe at or before the given time of a stream, or 
+** back to the beginning when that fails.
+**
+** @param fmt_ctx
+**				the input format context
+**
+** @param stream_index
+**				the index of the stream the keyframe belongs to
+**
+** @param time
+**				the time in seconds
+*/
+static void
+mml_stream_seek(AVFormatContext* 					fmt_ctx,
+                int												stream_index,
+                double										time)
+{
+  AVStream* stream = fmt_ctx->streams[stream_index];
+  int64_t seek_pts = av_rescale_q((int64_t)(time * AV_TIME_BASE), 
+                                  AV_TIME_BASE_Q, 
+                                  stream->time_base);
+  if (av_seek_frame(fmt_ctx, stream_index, seek_pts, AVSEEK_FLAG_BACKWARD) < 0)
+    av_seek_frame(fmt_ctx, stream_index, 0, AVSEEK_FLAG_BACKWARD);
+}
+
+/*!
+** The options used when NULL is given, every thread count is automatic.
+*/
+static const mml_options_t options_default = { MML_THREADS_AUTO, 0, MML_THREADS_AUTO, 0, 0, NULL, 0x000000, 0 };
+
+/*!
+** Sets the threading of a codec context, to be called before it is opened.
+**
+** @param codec_ctx
+**				the codec context
+**
+** @param threads
+**				the number of threads, MML_THREADS_AUTO for the number of cores
+**
+** @param thread_type
+**				MML_THREAD_FRAME, MML_THREAD_SLICE or both, 0 for both
+*/
+static void
+mml_codec_threads(AVCodecContext* 				codec_ctx,
+                  int 										threads,
+                  int 										thread_type)
+{
+  codec_ctx->thread_count = (threads == MML_THREADS_AUTO) ? av_cpu_count() : threads;
+  codec_ctx->thread_type = 0;
+  if (thread_type == 0 || (thread_type & MML_THREAD_FRAME))
+    codec_ctx->thread_type |= FF_THREAD_FRAME;
+  if (thread_type == 0 || (thread_type & MML_THREAD_SLICE))
+    codec_ctx->thread_type |= FF_THREAD_SLICE;
+}
+
+/*
+********************************************************************************
+**
+** built-in encoding profiles
+**
+********************************************************************************
+*/
+const mml_profile_t mml_profile_proxy = { "ultrafast", NULL, 28, 0, 50, 0, 0, 0 };
+
+const mml_profile_t mml_profile_default = { NULL, NULL, 0, 400000, 0, -1, -1, 0 };
+
+const mml_profile_t mml_profile_archive = { "slow", NULL, 18, 0, 250, 3, 60, 0 };
+
+/*!
+** Applies an encoding profile to an encoder context, to be called before it 
+** is opened. The x264 private options are ignored by other encoders.
+**
+** @param enc_ctx
+**				the encoder context
+**
+** @param profile
+**				the encoding profile
+*/
+static void
+mml_codec_profile(AVCodecContext* 				enc_ctx,
+                  const mml_profile_t* 		profile)
+{
+  if (profile->preset != NULL)
+    av_opt_set(enc_ctx->priv_data, "preset", profile->preset, 0);
+  if (profile->tune != NULL)
+    av_opt_set(enc_ctx->priv_data, "tune", profile->tune, 0);
+  if (profile->crf > 0)
+    av_opt_set_int(enc_ctx->priv_data, "crf", profile->crf, 0);
+  else if (profile->bit_rate > 0)
+    enc_ctx->bit_rate = profile->bit_rate;
+  if (profile->gop_size > 0)
+    enc_ctx->gop_size = profile->gop_size;
+  if (profile->max_b_frames >= 0)
+    enc_ctx->max_b_frames = profile->max_b_frames;
+  if (profile->lookahead >= 0)
+    av_opt_set_int(enc_ctx->priv_data, "rc-lookahead", profile->lookahead, 0);
+}
+
+/*!
+** Applies the threading and the encoding profile of the options to an encoder 
+** context, to be called before it is opened.
+**
+** @param enc_ctx
+**				the encoder context
+**
+** @param options
+**				the transcoding options
+**
+** @param profile
+**				the profile used when the options have none, or NULL to keep the 
+**				rate control set by the caller
+*/
+static void
+mml_codec_options(AVCodecContext* 				enc_ctx,
+                  const mml_options_t* 		options,
+                  const mml_profile_t* 		profile)
+{
+  int threads = options->encoder_threads;
+  
+  if (options->profile != NULL)
+    profile = options->profile;
+  if (profile != NULL)
+  {
+    mml_codec_profile(enc_ctx, profile);
+    if (profile->threads != MML_THREADS_AUTO)
+      threads = profile->threads;
+  }
+  mml_codec_threads(enc_ctx, threads, options->encoder_thread_type);
+}
+
 /*!
 **
 */
 static int 
 mml_stream_open(const char* 							filename, 
                 int												stream_type,
+                const mml_options_t*			options,
                	AVFormatContext** 				fmt_ctx, 
                	AVCodecContext** 					codec_ctx,
                	AVStream**								stream,
@@ -139,7 +320,7 @@ mml_stream_open(const char* 							filename,
   int 				ret;
   AVCodec* 		codec;
 
-  if ((ret = mml_format_open(filename, fmt_ctx)) != MML_SUCCESS) 
+  if ((ret = mml_format_open(filename, fmt_ctx, MML_IO_SEQUENTIAL)) != MML_SUCCESS) 
   	return ret;
 
   if ((ret = avformat_find_stream_info(*fmt_ctx, NULL)) < 0) 
@@ -189,6 +370,10 @@ mml_stream_open(const char* 							filename,
     return ret;
   }
 
+  if (options == NULL)
+    options = &options_default;
+  mml_codec_threads(*codec_ctx, options->decoder_threads, options->decoder_thread_type);
+
   if ((ret = avcodec_open2(*codec_ctx, codec, NULL)) < 0) 
   {
     ret = MML_ERROR_CODEC_OPEN_FAILED;
@@ -255,6 +440,258 @@ mml_stream_new(AVFormatContext* 				fmt_ctx,
 	return MML_SUCCESS;
 }
 
+/*!
+** Encodes a frame, or flushes the encoder with NULL, and writes the packets 
+** to the output stream. The lock, if any, is held while writing only, for an 
+** output muxed by several threads.
+*/
+static int
+mml_stream_encode_locked(AVFormatContext* 				fmt_ctx, 
+                         AVCodecContext* 				enc_ctx,
+                         AVStream*								stream,
+                         AVPacket*								pkt,
+                         AVFrame* 								frame,
+                         pthread_mutex_t*				lock)
+{
+  if (avcodec_send_frame(enc_ctx, frame) < 0) 
+  {
+    sprintf(err_msg, "failed to send frame to encoder");
+    return MML_ERROR_FRAME_NOT_SENT;
+  }
+
+  while (avcodec_receive_packet(enc_ctx, pkt) == 0) 
+  {
+    int rc;
+    av_packet_rescale_ts(pkt, enc_ctx->time_base, stream->time_base);
+    pkt->stream_index = stream->index;
+    if (lock != NULL)
+      pthread_mutex_lock(lock);
+    rc = av_interleaved_write_frame(fmt_ctx, pkt);
+    if (lock != NULL)
+      pthread_mutex_unlock(lock);
+    if (rc < 0) 
+    {
+      av_packet_unref(pkt);
+      sprintf(err_msg, "failed to write output frame");
+      return MML_ERROR_FRAME_NOT_WRITTEN;
+    }
+    av_packet_unref(pkt);
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Encodes a frame, or flushes the encoder with NULL, and writes the packets 
+** to the output stream.
+*/
+static int
+mml_stream_encode(AVFormatContext* 				fmt_ctx, 
+                  AVCodecContext* 				enc_ctx,
+                  AVStream*								stream,
+                  AVPacket*								pkt,
+                  AVFrame* 								frame)
+{
+  return mml_stream_encode_locked(fmt_ctx, enc_ctx, stream, pkt, frame, NULL);
+}
+
+/*!
+** Adds an output stream copying the best audio stream of the input, when the 
+** output format can hold its codec. Has to be called before the header is 
+** written.
+**
+** @param in_stream [out]
+**				the copied input stream, NULL if there is none
+**
+** @param out_stream [out]
+**				the output stream
+**
+** @return success or error code, an input without a suitable audio stream is 
+**				not an error
+*/
+static int
+mml_stream_copy_open(AVFormatContext* 				input_fmt_ctx, 
+                     AVFormatContext* 				output_fmt_ctx,
+                     AVStream**								in_stream,
+                     AVStream**								out_stream)
+{
+  int index = av_find_best_stream(input_fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+  
+  *in_stream = NULL;
+  *out_stream = NULL;
+  if (index < 0)
+    return MML_SUCCESS;
+  
+  /*!
+  ** 输出格式不支持的音频编码不复制，输出里就没有音频。
+  */
+  AVStream* stream = input_fmt_ctx->streams[index];
+  if (avformat_query_codec(output_fmt_ctx->oformat, 
+                           stream->codecpar->codec_id, 
+                           FF_COMPLIANCE_NORMAL) == 0)
+    return MML_SUCCESS;
+  
+  *out_stream = avformat_new_stream(output_fmt_ctx, NULL);
+  if (!(*out_stream)) 
+  {
+    sprintf(err_msg, "failed to create audio stream");
+    return MML_ERROR_STREAM_NOT_CREATED;
+  }
+  if (avcodec_parameters_copy((*out_stream)->codecpar, stream->codecpar) < 0) 
+  {
+    sprintf(err_msg, "audio codec parameters copy failed for stream");
+    return MML_ERROR_CODEC_NOT_COPIED;
+  }
+  (*out_stream)->codecpar->codec_tag = 0;
+  (*out_stream)->time_base = stream->time_base;
+  *in_stream = stream;
+  return MML_SUCCESS;
+}
+
+/*!
+** Writes a packet of a copied stream, with its timestamps rescaled to the 
+** output stream. The muxer interleaves it with the encoded packets.
+*/
+static int
+mml_stream_copy_write(AVFormatContext* 				output_fmt_ctx,
+                      AVStream*								in_stream,
+                      AVStream*								out_stream,
+                      AVPacket*								pkt,
+                      pthread_mutex_t*				lock)
+{
+  int rc;
+  
+  av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base);
+  pkt->stream_index = out_stream->index;
+  pkt->pos = -1;
+  if (lock != NULL)
+    pthread_mutex_lock(lock);
+  rc = av_interleaved_write_frame(output_fmt_ctx, pkt);
+  if (lock != NULL)
+    pthread_mutex_unlock(lock);
+  av_packet_unref(pkt);
+  if (rc < 0)
+  {
+    sprintf(err_msg, "failed to write audio packet");
+    return MML_ERROR_FRAME_NOT_WRITTEN;
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Opens the filter turning the length-prefixed H.264 or HEVC packets of an 
+** input stream into Annex B, with the parameter sets of the stream put in 
+** front of every keyframe. Copied packets then have the same format as 
+** re-encoded ones carrying their own parameter sets, and the MP4 muxer turns 
+** both back into length-prefixed samples. The filter stays NULL when the 
+** stream needs no conversion.
+**
+** @param codecpar
+**        the input codec parameters
+**
+** @param time_base
+**        the input time base
+**
+** @param bsf [out]
+**        the filter, or NULL
+**
+** @return success or error code
+*/
+static int
+mml_stream_annexb_open(const AVCodecParameters* codecpar, 
+                       AVRational               time_base,
+                       AVBSFContext**           bsf)
+{
+  const AVBitStreamFilter*  filter;
+  const char*               name;
+  
+  *bsf = NULL;
+  if (codecpar->codec_id == AV_CODEC_ID_H264)
+    name = "h264_mp4toannexb";
+  else if (codecpar->codec_id == AV_CODEC_ID_HEVC)
+    name = "hevc_mp4toannexb";
+  else
+    return MML_SUCCESS;
+  /*!
+  ** avcC 和 hvcC 的第一个字节是版本号 1，Annex B 以起始码开头。
+  */
+  if (codecpar->extradata_size < 1 || codecpar->extradata[0] != 1)
+    return MML_SUCCESS;
+  
+  if ((filter = av_bsf_get_by_name(name)) == NULL || av_bsf_alloc(filter, bsf) < 0)
+  {
+    sprintf(err_msg, "no bitstream filter '%s'", name);
+    return MML_ERROR_CODEC_NOT_FOUND;
+  }
+  if (avcodec_parameters_copy((*bsf)->par_in, codecpar) < 0)
+  {
+    av_bsf_free(bsf);
+    sprintf(err_msg, "failed to copy codec parameters");
+    return MML_ERROR_CODEC_NOT_COPIED;
+  }
+  (*bsf)->time_base_in = time_base;
+  if (av_bsf_init(*bsf) < 0)
+  {
+    av_bsf_free(bsf);
+    sprintf(err_msg, "failed to open bitstream filter '%s'", name);
+    return MML_ERROR_CODEC_OPEN_FAILED;
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Puts the parameter sets an encoder opened with a global header keeps in its 
+** extradata in front of a keyframe packet, so a re-encoded segment stitched 
+** between copied packets switches the decoder to its own parameter sets. 
+** Nothing is done for other codecs or packets.
+**
+** @return success or error code
+*/
+static int
+mml_packet_parameter_sets(AVPacket*                 pkt, 
+                          const AVCodecContext*     enc_ctx)
+{
+  int size = enc_ctx->extradata_size;
+  int orig = pkt->size;
+  
+  if (!(pkt->flags & AV_PKT_FLAG_KEY) || size <= 0)
+    return MML_SUCCESS;
+  if (enc_ctx->codec_id != AV_CODEC_ID_H264 && 
+      enc_ctx->codec_id != AV_CODEC_ID_HEVC && 
+      enc_ctx->codec_id != AV_CODEC_ID_MPEG4)
+    return MML_SUCCESS;
+  /*!
+  ** 只有 Annex B 的参数集可以直接拼在包前面。
+  */
+  if (enc_ctx->codec_id != AV_CODEC_ID_MPEG4 && enc_ctx->extradata[0] == 1)
+    return MML_SUCCESS;
+  
+  if (av_packet_make_writable(pkt) < 0 || av_grow_packet(pkt, size) < 0)
+  {
+    sprintf(err_msg, "failed to insert parameter sets");
+    return MML_ERROR_PACKET_NOT_CREATED;
+  }
+  memmove(pkt->data + size, pkt->data, orig);
+  memcpy(pkt->data, enc_ctx->extradata, size);
+  return MML_SUCCESS;
+}
+
+/*!
+** Tags an MP4 video stream whose packets carry parameter sets of their own, 
+** as the re-encoded GOPs stitched between copied ones do. The parameter sets 
+** may only change in band under the avc3 and hev1 sample entries, avc1 and 
+** hvc1 players keep using the ones of the sample entry.
+*/
+static void
+mml_stream_inband_tag(AVCodecParameters* codecpar)
+{
+  if (codecpar->codec_id == AV_CODEC_ID_H264)
+    codecpar->codec_tag = MKTAG('a', 'v', 'c', '3');
+  else if (codecpar->codec_id == AV_CODEC_ID_HEVC)
+    codecpar->codec_tag = MKTAG('h', 'e', 'v', '1');
+  else
+    codecpar->codec_tag = 0;
+}
+
 /*!
 ** Remux audio streams.
 */
@@ -323,162 +760,6 @@ WRITE:
   rc = av_interleaved_write_frame(output_fmt_ctx, pkt);
 }
 
-static void
-mml_stream_transcode(AVStream* input_video_stream,
-                     int stream_index,
-  									AVCodecContext* dec_ctx, 
-                     AVPacket* pkt,
-                     AVStream* output_video_stream,
-                     AVFormatContext* output_fmt_ctx,
-                     AVCodecContext* enc_ctx,
-                     int64_t* prev_dts, 
-                     int64_t* prev_pts, 
-                     int64_t* prev_dur, 
-                     int64_t* offset_dts, 
-                     int64_t* offset_pts)
-{
-  AVFrame* frame = av_frame_alloc();
-  frame->pict_type = AV_PICTURE_TYPE_NONE;
-  
-	int rc = avcodec_send_packet(dec_ctx, pkt);
-  while (rc >= 0)
-  {
-    rc = avcodec_receive_frame(dec_ctx, frame);
-
-    if (rc == AVERROR(EAGAIN) || rc == AVERROR_EOF)
-      break;
-    if (rc >= 0)
-    {
-      AVPacket* out_pkt = av_packet_alloc();
-      int rc = avcodec_send_frame(enc_ctx, frame);
-      if (rc < 0) 
-      {
-				char error_buf[128];
-        av_strerror(rc, error_buf, sizeof(error_buf));
-        printf("error: %s\n", error_buf);
-      }
-      while (rc >= 0)
-      {
-        rc = avcodec_receive_packet(enc_ctx, out_pkt);
-        
-        int64_t orig_pts = out_pkt->pts;
-        int64_t orig_dts = out_pkt->dts;
-
-        out_pkt->pts += (*offset_pts);
-        out_pkt->dts += (*offset_dts);
-        
-        if (rc == AVERROR(EAGAIN) || rc == AVERROR_EOF)
-          break;
-        
-        out_pkt->stream_index = stream_index;
-        out_pkt->duration = input_video_stream->time_base.den / input_video_stream->time_base.num;
-
-        av_packet_rescale_ts(out_pkt, input_video_stream->time_base, output_video_stream->time_base);
-        
-        if (out_pkt->dts <= (*prev_dts))
-        {
-          /*!
-          ** Wrapped around...
-          ** Set the DTS to be the previous DTS plus duration of a single packet.
-          ** Note: add the duration of the previous packet instead of adding 
-          ** (*pkt)->duration, because the last audio packet in the file may be 
-          ** shorter than the nominal audio packet duration.
-          */
-          out_pkt->dts = (*prev_dts) + (*prev_dur);
-          *offset_dts = out_pkt->dts - orig_dts;
-        }
-
-        /*!
-        ** Use the same solution for the PTS
-        ** In case of audio, the PTS are monotonously increased.
-        ** In case of video the PTS may not be monotonously increased 
-        ** (due to B-Frames).
-        ** The solution may not work for video packets.
-        */
-        if (out_pkt->pts <= (*prev_pts))
-        {
-          /*!
-          ** Set the PTS to be the previous PTS plus duration 
-          ** of a single packet.
-          */
-          out_pkt->pts = (*prev_pts) + (*prev_dur); 
-          *offset_pts = out_pkt->pts - orig_pts;
-        }
-
-        *prev_dts = out_pkt->dts;
-        *prev_pts = out_pkt->pts;
-        *prev_dur = out_pkt->duration;
-        rc = av_interleaved_write_frame(output_fmt_ctx, out_pkt);
-      }
-      av_packet_unref(out_pkt);
-      av_packet_free(&out_pkt);
-    }
-    av_frame_unref(frame);
-  }
-  av_frame_free(&frame);
-}
-
-/**
- * Add padding to a scaled frame, centering the frame and filling the remaining area with black.
- * 
- * @param padded_data      The data pointers for the padded frame.
- * @param padded_linesize  The linesize for the padded frame.
- * @param scaled_data      The data pointers for the scaled frame.
- * @param scaled_linesize  The linesize for the scaled frame.
- * @param scaled_width     The width of the scaled frame.
- * @param scaled_height    The height of the scaled frame.
- * @param pad_left         The number of pixels to pad on the left.
- * @param pad_right        The number of pixels to pad on the right.
- * @param pad_top          The number of pixels to pad on the top.
- * @param pad_bottom       The number of pixels to pad on the bottom.
- * @param target_width     The width of the target frame.
- * @param target_height    The height of the target frame.
- * @param target_format    The pixel format of the target frame.
- */
-static void 
-mml_frame_pad(uint8_t *padded_data[AV_NUM_DATA_POINTERS], int padded_linesize[AV_NUM_DATA_POINTERS],
-              const uint8_t *scaled_data[AV_NUM_DATA_POINTERS], int scaled_linesize[AV_NUM_DATA_POINTERS],
-              int scaled_width, int scaled_height,
-              int pad_left, int pad_right, int pad_top, int pad_bottom,
-              int target_width, int target_height, enum AVPixelFormat target_format)
-{
-  // Ensure the format is YUV420P
-  if (target_format != AV_PIX_FMT_YUV420P) {
-    fprintf(stderr, "Unsupported pixel format\n");
-    return;
-  }
-
-  // Fill the padded frame with black (Y=0, U=128, V=128 for YUV420P)
-  for (int y = 0; y < target_height; y++) {
-    for (int x = 0; x < target_width; x++) {
-      padded_data[0][y * padded_linesize[0] + x] = 0; // Y plane
-      if (y < target_height / 2 && x < target_width / 2) {
-        padded_data[1][y * padded_linesize[1] + x] = 128; // U plane
-        padded_data[2][y * padded_linesize[2] + x] = 128; // V plane
-      }
-    }
-  }
-
-  // Copy the scaled frame into the padded frame at the centered position
-  int y_offset = pad_top;
-  int x_offset = pad_left;
-
-  for (int y = 0; y < scaled_height; y++) {
-    memcpy(padded_data[0] + (y + y_offset) * padded_linesize[0] + x_offset,
-           scaled_data[0] + y * scaled_linesize[0],
-           scaled_width);
-  }
-
-  for (int y = 0; y < scaled_height / 2; y++) {
-    memcpy(padded_data[1] + (y + y_offset / 2) * padded_linesize[1] + x_offset / 2,
-           scaled_data[1] + y * scaled_linesize[1],
-           scaled_width / 2);
-    memcpy(padded_data[2] + (y + y_offset / 2) * padded_linesize[2] + x_offset / 2,
-           scaled_data[2] + y * scaled_linesize[2],
-           scaled_width / 2);
-  }
-}
-
 /*
 ********************************************************************************
 **
@@ -495,473 +776,1079 @@ mml_error(void)
 /*
 ********************************************************************************
 **
-** mml_audio_remove
+** mml_bytes_read
 **
 ********************************************************************************
 */
-int  
-mml_audio_remove(const char* original_video_path, const char* output_video_path)
+int64_t
+mml_bytes_read(void)
 {
-  int ret = MML_SUCCESS;
-  AVFormatContext* input_format_context = NULL;
-  AVFormatContext* output_format_context = NULL;
-  
-  if (avformat_open_input(&input_format_context, original_video_path, NULL, NULL) < 0) {
-    fprintf(stderr, "Could not open input file.\n");
-    return -1;
-  }
-
-  if (avformat_find_stream_info(input_format_context, NULL) < 0) {
-    fprintf(stderr, "Could not find stream information.\n");
-    return -1;
-  }
+	return mml_context_current()->bytes_read;
+}
 
-  avformat_alloc_output_context2(&output_format_context, NULL, NULL, output_video_path);
-  if (!output_format_context) {
-    fprintf(stderr, "Could not create output context.\n");
-    return -1;
+/*!
+** Tells whether the container header already has the media information of 
+** every stream, so no frame has to be decoded.
+*/
+static int
+mml_media_info_complete(AVFormatContext* fmt_ctx)
+{
+  if (fmt_ctx->duration == AV_NOPTS_VALUE)
+    return 0;
+  for (int i = 0; i < fmt_ctx->nb_streams; i++)
+  {
+    AVStream* stream = fmt_ctx->streams[i];
+    AVCodecParameters* codecpar = stream->codecpar;
+    if (codecpar->codec_id == AV_CODEC_ID_NONE)
+      return 0;
+    if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+        (codecpar->width <= 0 || codecpar->height <= 0 || 
+         (stream->avg_frame_rate.num == 0 && stream->r_frame_rate.num == 0)))
+      return 0;
+    if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+        (codecpar->sample_rate <= 0 || codecpar->ch_layout.nb_channels <= 0))
+      return 0;
   }
+  return 1;
+}
 
-  // 5. 复制视频流到输出上下文
-  int video_stream_index = -1;
-  for (int i = 0; i < input_format_context->nb_streams; i++) 
+/*!
+** Probes a media file like mml_media_info but reports the failure into the 
+** given buffer instead of the last error message, so files can be probed from 
+** several threads at once.
+*/
+static int
+mml_media_probe(const char* original_path, 
+                int fast, 
+                mml_media_info_t* info,
+                char* error,
+                size_t error_size)
+{
+  AVFormatContext* 		fmt_ctx 				= NULL;
+  AVDictionary*				options					= NULL;
+  mml_cache_key_t     cache_key;
+  int ret = MML_SUCCESS;
+  
+  if (mml_cache_get(original_path, fast, info, &cache_key) == MML_SUCCESS)
+    return MML_SUCCESS;
+  memset(info, 0, sizeof(mml_media_info_t));
+  
+  /*!
+  ** 快速模式只探测文件开头的一小部分。
+  */
+  if (fast)
   {
-    if (input_format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) 
-    {
-      video_stream_index = i;
-      AVStream* in_stream = input_format_context->streams[i];
-      const AVCodec* codec = avcodec_find_decoder(in_stream->codecpar->codec_id);
-      AVStream* out_stream = avformat_new_stream(output_format_context, codec);
-      if (!out_stream) 
-      {
-        fprintf(stderr, "Failed to create output video stream.\n");
-        return -1;
-      }
-      output_format_context->streams[output_format_context->nb_streams - 1] = out_stream;
-      if (avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar) < 0) 
-      {
-        ret = MML_ERROR_CODEC_NOT_COPIED;
-        sprintf(err_msg, "failed to copy codec parameters");
-        goto RELEASE;
-      }
-      out_stream->sample_aspect_ratio = in_stream->sample_aspect_ratio;
-      break;
-    }
+    av_dict_set(&options, "probesize", "65536", 0);
+    av_dict_set(&options, "analyzeduration", "100000", 0);
   }
-  if (video_stream_index == -1)
+  if ((ret = mml_input_open(original_path, &fmt_ctx, &options, MML_IO_NORMAL)) != MML_SUCCESS) 
   {
-    fprintf(stderr, "Could not find video stream.\n");
-    return -1;
+    snprintf(error, error_size, "'%s' file not open", original_path);
+    goto RELEASE;
   }
-
-  // 6. 打开输出文件
-  if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) 
+  
+  /*!
+  ** 容器头里已经有全部信息时不再解码。
+  */
+  if (!fast || !mml_media_info_complete(fmt_ctx))
   {
-    if (avio_open(&output_format_context->pb, output_video_path, AVIO_FLAG_WRITE) < 0) 
+    if (avformat_find_stream_info(fmt_ctx, NULL) < 0) 
     {
-      fprintf(stderr, "Could not open output file.\n");
-      return -1;
+      ret = MML_ERROR_STREAM_NOT_FOUND;
+      snprintf(error, error_size, "'%s' stream not found", original_path);
+      goto RELEASE;
     }
   }
-
-  // 7. 写入输出文件的头部信息
-  if (avformat_write_header(output_format_context, NULL) < 0) {
-    fprintf(stderr, "Could not write header.\n");
-    return -1;
-  }
-
-  // 8. 读取输入视频文件的视频帧
-  AVPacket packet;
-  while (av_read_frame(input_format_context, &packet) >= 0) 
+  
+  if (fmt_ctx->duration != AV_NOPTS_VALUE)
+    info->duration = fmt_ctx->duration / (double)AV_TIME_BASE;
+  info->bit_rate = fmt_ctx->bit_rate;
+  info->nb_streams = FFMIN(fmt_ctx->nb_streams, MML_MEDIA_MAX_STREAMS);
+  info->nb_streams_total = fmt_ctx->nb_streams;
+  for (int i = 0; i < info->nb_streams; i++)
   {
-    if (packet.stream_index == video_stream_index) 
+    AVStream* stream = fmt_ctx->streams[i];
+    AVCodecParameters* codecpar = stream->codecpar;
+    mml_stream_info_t* stream_info = &info->streams[i];
+    
+    snprintf(stream_info->codec, sizeof(stream_info->codec), "%s", avcodec_get_name(codecpar->codec_id));
+    stream_info->bit_rate = codecpar->bit_rate;
+    stream_info->nb_frames = stream->nb_frames;
+    switch (codecpar->codec_type)
     {
-      // 9. 将视频帧写入输出文件
-      // 复制元数据
-      av_packet_rescale_ts(&packet, input_format_context->streams[packet.stream_index]->time_base, output_format_context->streams[0]->time_base);
-      if (av_interleaved_write_frame(output_format_context, &packet) < 0) {
-        fprintf(stderr, "Could not write video frame.\n");
-      }
+    case AVMEDIA_TYPE_VIDEO:
+      stream_info->type = MML_MEDIA_TYPE_VIDEO;
+      stream_info->width = codecpar->width;
+      stream_info->height = codecpar->height;
+      if (stream->avg_frame_rate.num != 0 && stream->avg_frame_rate.den != 0)
+        stream_info->frame_rate = av_q2d(stream->avg_frame_rate);
+      else if (stream->r_frame_rate.num != 0 && stream->r_frame_rate.den != 0)
+        stream_info->frame_rate = av_q2d(stream->r_frame_rate);
+      break;
+    case AVMEDIA_TYPE_AUDIO:
+      stream_info->type = MML_MEDIA_TYPE_AUDIO;
+      stream_info->sample_rate = codecpar->sample_rate;
+      stream_info->channels = codecpar->ch_layout.nb_channels;
+      break;
+    case AVMEDIA_TYPE_SUBTITLE:
+      stream_info->type = MML_MEDIA_TYPE_SUBTITLE;
+      break;
+    case AVMEDIA_TYPE_DATA:
+      stream_info->type = MML_MEDIA_TYPE_DATA;
+      break;
+    default:
+      stream_info->type = MML_MEDIA_TYPE_UNKNOWN;
+      break;
     }
-    av_packet_unref(&packet);
   }
-
-  av_write_trailer(output_format_context);
-
+  mml_cache_put(original_path, &cache_key, info);
+  
 RELEASE:
   
-  avformat_free_context(input_format_context);
-  avformat_free_context(output_format_context);
-
-	return 0;
+  if (fmt_ctx != NULL)
+    mml_input_close(&fmt_ctx);
+  if (options != NULL)
+    av_dict_free(&options);
+  
+  return ret;
 }
 
 /*
 ********************************************************************************
 **
-** mml_audio_exist
+** mml_media_info
 **
 ********************************************************************************
 */
 int
-mml_audio_exist(const char* original_video_path)
+mml_media_info(const char* original_path, 
+               int fast, 
+               mml_media_info_t* info)
 {
-  AVFormatContext* format_context = NULL;
-  if (avformat_open_input(&format_context, original_video_path, NULL, NULL) < 0) {
-    fprintf(stderr, "Could not open input file.\n");
-    return -1;
-  }
+  return mml_media_probe(original_path, fast, info, err_msg, sizeof(err_msg));
+}
 
-  if (avformat_find_stream_info(format_context, NULL) < 0) {
-    fprintf(stderr, "Could not find stream information.\n");
-    return -1;
-  }
+/*!
+** The shared state of a batch probe, the workers take the probes to run from 
+** the queue.
+*/
+typedef struct mml_media_batch_s
+{
+  mml_queue_t               probes;
+  int                       fast;
+} mml_media_batch_t;
 
-  int has_audio = 0;
-  for (unsigned i = 0; i < format_context->nb_streams; i++) {
-    if (format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-      has_audio = 1;
-      break;
-    }
+static void*
+mml_media_batch_work(void* arg)
+{
+  mml_media_batch_t* batch = (mml_media_batch_t*)arg;
+  mml_media_probe_t* probe;
+  
+  while (mml_queue_pop(&batch->probes, (void**)&probe) == MML_SUCCESS)
+  {
+    probe->error[0] = '\0';
+    probe->status = mml_media_probe(probe->path, 
+                                    batch->fast, 
+                                    &probe->info, 
+                                    probe->error, 
+                                    sizeof(probe->error));
   }
-
-  avformat_close_input(&format_context);
-  return has_audio;
+  /*!
+  ** 每个文件的错误已记在各自的结果里，不再带回启动批量探测的线程。
+  */
+  err_msg[0] = '\0';
+  return NULL;
 }
 
 /*
 ********************************************************************************
 **
-** mml_audio_extract
+** mml_media_info_batch
 **
 ********************************************************************************
 */
-int 
-mml_audio_extract(const char* original_video_path, 
-                  const char* output_audio_path)
+int
+mml_media_info_batch(mml_media_probe_t* probes, 
+                     int nb_probes, 
+                     int fast, 
+                     int threads)
 {
-  int									 ret 										= MML_SUCCESS;
-  AVFormatContext* 	 		input_format_context	 	= NULL;
-  AVFormatContext*	 		output_format_context 	= NULL;
-  AVCodecContext*		 		input_codec_context 		= NULL;
-  AVCodecContext*		 		output_codec_context 		= NULL;
-  AVCodec*		 			 		input_codec 						= NULL;
-  AVCodec*		 			 	 	output_codec 						= NULL;
-  AVCodecParameters*  	codecpar								=	NULL;
-  SwrContext*						swr_ctx 								= NULL;
-  AVPacket 							packet;
-  AVFrame* 							frame 									= NULL;
-  
-  ret = avformat_open_input(&input_format_context, 
-                            original_video_path, 
-                            NULL, 
-                            NULL);
-  if (ret < 0)
-  {
-    ret = MML_ERROR_FILE_OPEN_FAILED;
-    sprintf(err_msg, "'%s' file not open", original_video_path);
-    goto RELEASE;
-  }
-
-  ret = avformat_find_stream_info(input_format_context, NULL);
-  if (ret < 0) 
-  {
-    ret = MML_ERROR_STREAM_NOT_FOUND;
-   	sprintf(err_msg, "'%s' stream not found", original_video_path);
-    goto RELEASE;
-  }
-	
+  mml_media_batch_t   batch;
+  pthread_t*          workers               = NULL;
+  int                 nb_started            = 0;
+  int                 ret                   = MML_SUCCESS;
+  
   /*!
-  ** 查找音频流索引号
+  ** 探测主要在等待I/O，默认线程数取CPU数的两倍。
   */
-  int audio_stream_index = -1;
-  for (int i = 0; i < input_format_context->nb_streams; i++) 
-  {
-    codecpar = input_format_context->streams[i]->codecpar;
-    if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
-        codecpar->codec_id == AV_CODEC_ID_AAC) 
-    {
-      audio_stream_index = i;
-      break;
-    }
-  }
-
-  if (audio_stream_index == -1) 
-  {
-    ret = MML_ERROR_STREAM_NOT_FOUND;
-    sprintf(err_msg, "no audio stream found for '%s'", original_video_path);
-		goto RELEASE;
-  }
+  if (threads <= 0)
+    threads = av_cpu_count() * 2;
+  if (threads > nb_probes)
+    threads = nb_probes;
+  if (threads <= 0)
+    return MML_SUCCESS;
   
-  /*! 
-  ** 打开AAC解码器（这里我们只提取AAC流，不进行解码）
-  */
-  codecpar = input_format_context->streams[audio_stream_index]->codecpar;
-  input_codec = (AVCodec*) avcodec_find_decoder(codecpar->codec_id);
-  if (!input_codec) 
+  batch.fast = fast;
+  if (mml_queue_init(&batch.probes, threads * 2) != MML_SUCCESS)
   {
-    ret = MML_ERROR_CODEC_NOT_FOUND;
-    sprintf(err_msg, "no codec found for id: %d", codecpar->codec_id);
-    goto RELEASE;
+    sprintf(err_msg, "failed to create probe queue");
+    return MML_ERROR_THREAD_NOT_CREATED;
   }
-  input_codec_context = avcodec_alloc_context3(input_codec);
-  if (!input_codec_context) 
+  workers = (pthread_t*)calloc(threads, sizeof(pthread_t));
+  if (!workers)
   {
-    ret = MML_ERROR_CODEC_NOT_CREATED;
-    sprintf(err_msg, "no codec created for id: %d", codecpar->codec_id);
+    ret = MML_ERROR_THREAD_NOT_CREATED;
+    sprintf(err_msg, "failed to create probe workers");
     goto RELEASE;
   }
-
-  if (avcodec_parameters_to_context(input_codec_context, codecpar) < 0) 
+  for (; nb_started < threads; nb_started++)
   {
-    ret = MML_ERROR_CODEC_NOT_CREATED;
-    sprintf(err_msg, "codec parameters copy failed for input codec context");
-    goto RELEASE;
-  }
-
-  if (avcodec_open2(input_codec_context, input_codec, NULL) < 0) {
-    ret = MML_ERROR_CODEC_OPEN_FAILED;
-    sprintf(err_msg, "failed to open input codec");
-    goto RELEASE;
+    if (mml_thread_create(&workers[nb_started], mml_media_batch_work, &batch) != 0)
+      break;
   }
-  
-  ret = avformat_alloc_output_context2(&output_format_context, NULL, NULL, output_audio_path);
-  if (!output_format_context) 
+  if (nb_started == 0)
   {
-    ret = MML_ERROR_CODEC_NOT_CREATED;
-    sprintf(err_msg, "failed to allocate output format context for '%s'", output_audio_path);
+    ret = MML_ERROR_THREAD_NOT_CREATED;
+    sprintf(err_msg, "failed to create probe workers");
     goto RELEASE;
   }
   
-  // Find output codec
-  output_codec = (AVCodec*)avcodec_find_encoder(AV_CODEC_ID_AAC);
-  if (!output_codec) 
+  for (int i = 0; i < nb_probes; i++)
   {
-    ret = MML_ERROR_CODEC_NOT_FOUND;
-    sprintf(err_msg, "no codec found for id: %d", AV_CODEC_ID_AAC);
-    goto RELEASE;
+    probes[i].status = MML_ERROR_NO_CONTENT;
+    mml_queue_push(&batch.probes, &probes[i]);
   }
+  
+RELEASE:
+  
+  mml_queue_close(&batch.probes);
+  for (int i = 0; i < nb_started; i++)
+    mml_thread_join(workers[i]);
+  if (workers != NULL)
+    free(workers);
+  mml_queue_free(&batch.probes);
+  
+  return ret;
+}
 
-  // Allocate codec context for output stream
-  output_codec_context = avcodec_alloc_context3(output_codec);
-  if (!output_codec_context) 
-  {
-    ret = MML_ERROR_CODEC_NOT_CREATED;
-    sprintf(err_msg, "failed to allocate output codec context");
+/*
+********************************************************************************
+**
+** mml_audio_remove
+**
+********************************************************************************
+*/
+int  
+mml_audio_remove(const char* original_video_path, const char* output_video_path)
+{
+  int ret = MML_SUCCESS;
+  AVFormatContext* input_format_context = NULL;
+  AVFormatContext* output_format_context = NULL;
+  AVPacket* packet = NULL;
+  int video_stream_index = -1;
+  
+  ret = mml_format_open(original_video_path, &input_format_context, MML_IO_SEQUENTIAL);
+  if (ret != MML_SUCCESS)
     goto RELEASE;
-  }
 
-  output_codec_context->ch_layout = input_codec_context->ch_layout;
-  output_codec_context->sample_rate = input_codec_context->sample_rate;
-  // output_codec_context->sample_fmt = output_codec->sample_fmts[0];
-  output_codec_context->bit_rate = output_codec_context->bit_rate;
-
-  if (output_format_context->oformat->flags & AVFMT_GLOBALHEADER) 
+  if (avformat_find_stream_info(input_format_context, NULL) < 0) 
   {
-    output_codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    ret = MML_ERROR_STREAM_NOT_FOUND;
+    sprintf(err_msg, "'%s' stream not found", original_video_path);
+    goto RELEASE;
   }
 
-  if (avcodec_open2(output_codec_context, output_codec, NULL) < 0) 
+  avformat_alloc_output_context2(&output_format_context, NULL, NULL, mml_io_name(output_video_path));
+  if (!output_format_context) 
   {
-    ret = MML_ERROR_CODEC_OPEN_FAILED;
-    sprintf(err_msg, "failed to open output codec");
+    ret = MML_ERROR_FORMAT_NOT_CREATED;
+    sprintf(err_msg, "failed to create output format context for '%s'", output_video_path);
     goto RELEASE;
   }
 
-  AVStream* output_audio_stream = avformat_new_stream(output_format_context, NULL);
-  if (!output_audio_stream) 
+  // 5. 复制视频流到输出上下文
+  for (int i = 0; i < input_format_context->nb_streams; i++) 
   {
-    ret = MML_ERROR_STREAM_NOT_CREATED;
-    sprintf(err_msg, "failed to create output audio stream");
-    goto RELEASE;
+    if (input_format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) 
+    {
+      video_stream_index = i;
+      AVStream* in_stream = input_format_context->streams[i];
+      const AVCodec* codec = avcodec_find_decoder(in_stream->codecpar->codec_id);
+      AVStream* out_stream = avformat_new_stream(output_format_context, codec);
+      if (!out_stream) 
+      {
+        ret = MML_ERROR_STREAM_NOT_CREATED;
+        sprintf(err_msg, "failed to create output video stream");
+        goto RELEASE;
+      }
+      if (avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar) < 0) 
+      {
+        ret = MML_ERROR_CODEC_NOT_COPIED;
+        sprintf(err_msg, "failed to copy codec parameters");
+        goto RELEASE;
+      }
+      out_stream->sample_aspect_ratio = in_stream->sample_aspect_ratio;
+      break;
+    }
   }
-
-  if (avcodec_parameters_from_context(output_audio_stream->codecpar, output_codec_context) < 0) 
+  if (video_stream_index == -1)
   {
-    ret = MML_ERROR_STREAM_NOT_CREATED;
-    sprintf(err_msg, "failed to copy codec parameters for output audio stream");
+    ret = MML_ERROR_STREAM_NOT_FOUND;
+    sprintf(err_msg, "no video stream found for '%s'", original_video_path);
     goto RELEASE;
   }
 
-  output_audio_stream->time_base = (AVRational){1, output_codec_context->sample_rate};
-
-  if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) {
-    if (avio_open(&output_format_context->pb, output_audio_path, AVIO_FLAG_WRITE) < 0) 
+  // 6. 打开输出文件
+  if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) 
+  {
+    if (mml_output_open(output_format_context, output_video_path) != MML_SUCCESS) 
     {
       ret = MML_ERROR_FILE_OPEN_FAILED;
-      sprintf(err_msg, "failed to open file '%s'", output_audio_path);
+      sprintf(err_msg, "failed to open output file '%s'", output_video_path);
       goto RELEASE;
     }
   }
 
+  // 7. 写入输出文件的头部信息
   if (avformat_write_header(output_format_context, NULL) < 0) 
   {
     ret = MML_ERROR_STREAM_WRITE_FAILED;
-    sprintf(err_msg, "failed to write header to '%s'", output_audio_path);
+    sprintf(err_msg, "failed to write header to '%s'", output_video_path);
     goto RELEASE;
   }
 
-  // Initialize the resampler to convert the input audio to the output format
-  swr_ctx = swr_alloc();
-  av_opt_set_int(swr_ctx, "in_sample_rate", input_codec_context->sample_rate, 0);
-  av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt", input_codec_context->sample_fmt, 0);
-  av_opt_set_int(swr_ctx, "out_sample_rate", output_codec_context->sample_rate, 0);
-  av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", output_codec_context->sample_fmt, 0);
-  swr_init(swr_ctx);
-  
-  frame = av_frame_alloc();
-  while (av_read_frame(input_format_context, &packet) >= 0) {
-    if (packet.stream_index == audio_stream_index) {
-      if (avcodec_send_packet(input_codec_context, &packet) == 0) {
-        while (avcodec_receive_frame(input_codec_context, frame) == 0) {
-          AVFrame *resampled_frame = av_frame_alloc();
-          resampled_frame->ch_layout = output_codec_context->ch_layout;
-          resampled_frame->sample_rate = output_codec_context->sample_rate;
-          resampled_frame->format = output_codec_context->sample_fmt;
-          resampled_frame->nb_samples = frame->nb_samples;
-
-          if (av_frame_get_buffer(resampled_frame, 0) < 0) {
-            fprintf(stderr, "Could not allocate output frame samples\n");
-            return -1;
-          }
-
-          if (swr_convert_frame(swr_ctx, resampled_frame, frame) < 0) {
-            fprintf(stderr, "Error while converting\n");
-            return -1;
-          }
-
-          if (avcodec_send_frame(output_codec_context, resampled_frame) < 0) {
-            fprintf(stderr, "Error sending frame to encoder\n");
-            return -1;
-          }
-
-          AVPacket* out_packet = av_packet_alloc();
-
-          while (avcodec_receive_packet(output_codec_context, out_packet) == 0) {
-            av_packet_rescale_ts(out_packet, 
-                                 output_codec_context->time_base, 
-                                 output_audio_stream->time_base);
-            out_packet->stream_index = output_audio_stream->index;
-            if (av_interleaved_write_frame(output_format_context, out_packet) < 0) {
-              fprintf(stderr, "Error writing frame\n");
-              return -1;
-            }
-            av_packet_unref(out_packet);
-          }
-          av_packet_free(&out_packet);
-          av_frame_free(&resampled_frame);
-        }
+  // 8. 读取输入视频文件的视频帧
+  packet = av_packet_alloc();
+  if (!packet) 
+  {
+    ret = MML_ERROR_PACKET_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate packet");
+    goto RELEASE;
+  }
+  while (av_read_frame(input_format_context, packet) >= 0) 
+  {
+    if (packet->stream_index == video_stream_index) 
+    {
+      // 9. 将视频帧写入输出文件
+      // 复制元数据
+      av_packet_rescale_ts(packet, input_format_context->streams[packet->stream_index]->time_base, output_format_context->streams[0]->time_base);
+      packet->stream_index = 0;
+      if (av_interleaved_write_frame(output_format_context, packet) < 0) 
+      {
+        av_packet_unref(packet);
+        ret = MML_ERROR_STREAM_WRITE_FAILED;
+        sprintf(err_msg, "failed to write video packet to '%s'", output_video_path);
+        goto RELEASE;
       }
-      av_packet_unref(&packet);
     }
+    av_packet_unref(packet);
   }
 
-  av_write_trailer(output_format_context);
-
-  if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) 
+  if (av_write_trailer(output_format_context) < 0)
   {
-    avio_closep(&output_format_context->pb);
+    ret = MML_ERROR_STREAM_WRITE_FAILED;
+    sprintf(err_msg, "failed to write trailer to '%s'", output_video_path);
   }
 
 RELEASE:
-	if (input_codec_context != NULL)
-    avcodec_free_context(&input_codec_context);
-  if (output_codec_context != NULL)
-    avcodec_free_context(&output_codec_context);
+  
   if (input_format_context != NULL)
-  	avformat_close_input(&input_format_context);
- 	if (output_format_context != NULL)
-  	avformat_close_input(&output_format_context);
-  if (swr_ctx != NULL)
-    swr_free(&swr_ctx);
-  if (frame != NULL) 
-    av_frame_free(&frame);
+    mml_format_close(&input_format_context);
+  if (output_format_context != NULL)
+  {
+    if (!(output_format_context->oformat->flags & AVFMT_NOFILE))
+      mml_output_close(output_format_context);
+    avformat_free_context(output_format_context);
+  }
+  if (packet != NULL)
+    av_packet_free(&packet);
 
-  return ret;
+	return ret;
 }
 
 /*
 ********************************************************************************
 **
-** mml_video_resolution
+** mml_audio_exist
 **
 ********************************************************************************
 */
 int
-mml_video_resolution(const char* 		original_video_path, 
-                     int* 					width, 
-                     int* 					height)
+mml_audio_exist(const char* original_video_path)
 {
-  AVFormatContext* format_context = NULL;
-  int ret = avformat_open_input(&format_context, original_video_path, NULL, NULL);
-  if (ret < 0) 
+  mml_media_info_t info;
+  AVFormatContext* fmt_ctx = NULL;
+  int ret = 0;
+  
+  if (mml_media_info(original_video_path, 1, &info) != MML_SUCCESS) 
+    return -1;
+
+  for (int i = 0; i < info.nb_streams; i++) 
   {
-    fprintf(stderr, "Could not open input file '%s'.\n", original_video_path);
-    return ret;
+    if (info.streams[i].type == MML_MEDIA_TYPE_AUDIO) 
+      return 1;
   }
+  if (info.nb_streams == info.nb_streams_total)
+    return 0;
+  
+  /*!
+  ** 流太多没有全列出来时，剩下的流从容器头里看。
+  */
+  if (mml_format_open(original_video_path, &fmt_ctx, MML_IO_NORMAL) != MML_SUCCESS)
+    return -1;
+  for (int i = info.nb_streams; i < fmt_ctx->nb_streams && !ret; i++)
+    ret = fmt_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+  mml_format_close(&fmt_ctx);
+  return ret;
+}
 
-  ret = avformat_find_stream_info(format_context, NULL);
-  if (ret < 0) 
+/*!
+** The state of a PCM extraction: the persistent resampler, the FIFO cutting 
+** the converted samples into chunks, and the buffers reused for every frame.
+*/
+typedef struct mml_pcm_s
+{
+  const mml_pcm_format_t*   format;
+  mml_pcm_callback_t        callback;
+  void*                     opaque;
+  SwrContext*               swr;
+  AVAudioFifo*              fifo;
+  enum AVSampleFormat       sample_fmt;
+  /*!
+  ** the converted samples, growing to the largest converted frame
+  */
+  uint8_t*                  samples;
+  int                       max_samples;
+  uint8_t*                  chunk;
+  /*!
+  ** the samples per channel delivered so far
+  */
+  int64_t                   delivered;
+} mml_pcm_t;
+
+/*!
+** Delivers the full chunks in the FIFO, and the remaining samples as a last 
+** shorter chunk when flushing.
+*/
+static int
+mml_pcm_deliver(mml_pcm_t* pcm, int flush)
+{
+  int ret         = MML_SUCCESS;
+  int chunk_size  = pcm->format->chunk_samples;
+  
+  while (ret == MML_SUCCESS && 
+         (av_audio_fifo_size(pcm->fifo) >= chunk_size || 
+          (flush && av_audio_fifo_size(pcm->fifo) > 0)))
   {
-    fprintf(stderr, "Could not find stream information.\n");
-    return ret;
+    int nb_samples = FFMIN(av_audio_fifo_size(pcm->fifo), chunk_size);
+    av_audio_fifo_read(pcm->fifo, (void**)&pcm->chunk, nb_samples);
+    ret = pcm->callback(pcm->opaque, 
+                        pcm->chunk, 
+                        nb_samples, 
+                        (double)pcm->delivered / pcm->format->sample_rate);
+    pcm->delivered += nb_samples;
   }
+  return ret;
+}
 
-  int video_stream_index = -1;
-  for (int i = 0; i < format_context->nb_streams; i++) 
+/*!
+** Resamples a decoded frame, or flushes the resampler with NULL, and delivers 
+** the chunks completed by it.
+*/
+static int
+mml_pcm_convert(mml_pcm_t* pcm, const AVFrame* frame)
+{
+  int nb_samples = swr_get_out_samples(pcm->swr, frame != NULL ? frame->nb_samples : 0);
+  
+  if (nb_samples > pcm->max_samples)
   {
-    if (format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) 
+    av_freep(&pcm->samples);
+    pcm->max_samples = 0;
+    if (av_samples_alloc(&pcm->samples, NULL, pcm->format->channels, nb_samples, pcm->sample_fmt, 0) < 0)
     {
-      video_stream_index = i;
-      break;
+      sprintf(err_msg, "failed to allocate audio samples");
+      return MML_ERROR_FRAME_NOT_CREATED;
     }
+    pcm->max_samples = nb_samples;
   }
-
-  if (video_stream_index == -1) 
+  if (nb_samples > 0)
   {
-    fprintf(stderr, "Could not find video stream in the input file.\n");
-    return -1;
+    nb_samples = swr_convert(pcm->swr, &pcm->samples, nb_samples, 
+                             frame != NULL ? (const uint8_t**)frame->extended_data : NULL, 
+                             frame != NULL ? frame->nb_samples : 0);
+    if (nb_samples > 0 && av_audio_fifo_write(pcm->fifo, (void**)&pcm->samples, nb_samples) < nb_samples)
+    {
+      sprintf(err_msg, "failed to queue audio samples");
+      return MML_ERROR_FRAME_NOT_CREATED;
+    }
   }
-
-  AVCodecParameters* codecpar = format_context->streams[video_stream_index]->codecpar;
-  *width = codecpar->width;
-  *height = codecpar->height;
-	
- 	if (format_context != NULL)
-  	avformat_close_input(&format_context);
-  
-  return MML_SUCCESS;
+  return mml_pcm_deliver(pcm, frame == NULL);
 }
 
 /*
 ********************************************************************************
 **
-** mml_video_resize
+** mml_audio_pcm
 **
 ********************************************************************************
 */
 int
-mml_video_resize(const char* 	original_path, 
-                 const char* 	output_path, 
-                 int 					width, 
-                 int 					height)
+mml_audio_pcm(const char* original_path, 
+              const mml_pcm_format_t* format, 
+              mml_pcm_callback_t callback, 
+              void* opaque)
 {
-	AVFormatContext* input_format_context = NULL;
-  AVFormatContext* output_format_context = NULL;
-  AVCodecContext* input_codec_context = NULL;
-  AVCodecContext* output_codec_context = NULL;
-  AVCodec* output_codec = NULL;
+  int                 ret                   = MML_SUCCESS;
+  AVFormatContext*    input_format_context  = NULL;
+  AVCodecContext*     input_codec_context   = NULL;
+  AVStream*           input_audio_stream    = NULL;
+  AVPacket*           packet                = NULL;
+  AVFrame*            frame                 = NULL;
+  AVChannelLayout     in_layout             = {0};
+  AVChannelLayout     out_layout            = {0};
+  int                 audio_stream_index    = -1;
+  mml_pcm_t           pcm;
+  
+  memset(&pcm, 0, sizeof(pcm));
+  if (format == NULL || callback == NULL || 
+      format->sample_rate <= 0 || format->channels <= 0 || format->chunk_samples <= 0 ||
+      (format->sample_format != MML_SAMPLE_S16 && format->sample_format != MML_SAMPLE_FLT))
+  {
+    ret = MML_ERROR_CODEC_NOT_CREATED;
+    sprintf(err_msg, "unsupported PCM format");
+    return ret;
+  }
+  pcm.format = format;
+  pcm.callback = callback;
+  pcm.opaque = opaque;
+  pcm.sample_fmt = format->sample_format == MML_SAMPLE_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT;
+  
+  ret = mml_stream_open(original_path, 
+                        AVMEDIA_TYPE_AUDIO, 
+                        NULL,
+                        &input_format_context, 
+                        &input_codec_context,
+                        &input_audio_stream,
+                        &audio_stream_index);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+  
+  /*!
+  ** 没有声道布局的输入按声道数取默认布局。
+  */
+  if (input_codec_context->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC)
+    av_channel_layout_default(&in_layout, input_codec_context->ch_layout.nb_channels);
+  else
+    av_channel_layout_copy(&in_layout, &input_codec_context->ch_layout);
+  av_channel_layout_default(&out_layout, format->channels);
+  
+  if (swr_alloc_set_opts2(&pcm.swr, 
+                          &out_layout, 
+                          pcm.sample_fmt, 
+                          format->sample_rate,
+                          &in_layout, 
+                          input_codec_context->sample_fmt, 
+                          input_codec_context->sample_rate,
+                          0, NULL) < 0 || swr_init(pcm.swr) < 0)
+  {
+    ret = MML_ERROR_CODEC_NOT_CREATED;
+    sprintf(err_msg, "failed to create audio resampler");
+    goto RELEASE;
+  }
+  
+  pcm.fifo = av_audio_fifo_alloc(pcm.sample_fmt, format->channels, format->chunk_samples);
+  frame = mml_frame_new();
+  packet = mml_packet_new();
+  if (!pcm.fifo || !frame || !packet ||
+      av_samples_alloc(&pcm.chunk, NULL, format->channels, format->chunk_samples, pcm.sample_fmt, 0) < 0)
+  {
+    ret = MML_ERROR_FRAME_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate audio buffers");
+    goto RELEASE;
+  }
+  
+  /*!
+  ** 读到文件末尾后用NULL包清空解码器，再清空重采样器。
+  */
+  while (ret == MML_SUCCESS) 
+  {
+    int eof = av_read_frame(input_format_context, packet) < 0;
+    if (!eof && packet->stream_index != audio_stream_index) 
+    {
+      av_packet_unref(packet);
+      continue;
+    }
+    if (avcodec_send_packet(input_codec_context, eof ? NULL : packet) == 0) 
+    {
+      while (ret == MML_SUCCESS && avcodec_receive_frame(input_codec_context, frame) == 0) 
+      {
+        ret = mml_pcm_convert(&pcm, frame);
+        av_frame_unref(frame);
+      }
+    }
+    av_packet_unref(packet);
+    if (eof)
+      break;
+  }
+  if (ret == MML_SUCCESS)
+    ret = mml_pcm_convert(&pcm, NULL);
+  
+RELEASE:
+  
+  if (input_codec_context != NULL)
+  	avcodec_free_context(&input_codec_context);
+  if (input_format_context != NULL)
+  	mml_input_close(&input_format_context);
+  if (pcm.swr != NULL)
+    swr_free(&pcm.swr);
+  if (pcm.fifo != NULL)
+    av_audio_fifo_free(pcm.fifo);
+  av_freep(&pcm.samples);
+  av_freep(&pcm.chunk);
+  av_channel_layout_uninit(&in_layout);
+  av_channel_layout_uninit(&out_layout);
+  if (frame != NULL)
+  	av_frame_free(&frame);
+  if (packet != NULL)
+  	av_packet_free(&packet);
+  
+  return ret;
+}
+
+/*
+********************************************************************************
+**
+** mml_video_resolution
+**
+********************************************************************************
+*/
+int
+mml_video_resolution(const char* 		original_video_path, 
+                     int* 					width, 
+                     int* 					height)
+{
+  mml_media_info_t info;
+  int ret = mml_media_info(original_video_path, 1, &info);
+  if (ret != MML_SUCCESS) 
+    return ret;
+
+  for (int i = 0; i < info.nb_streams; i++) 
+  {
+    if (info.streams[i].type == MML_MEDIA_TYPE_VIDEO) 
+    {
+      *width = info.streams[i].width;
+      *height = info.streams[i].height;
+      return MML_SUCCESS;
+    }
+  }
+  
+  sprintf(err_msg, "no video stream found for '%s'", original_video_path);
+  return MML_ERROR_STREAM_NOT_FOUND;
+}
+
+/*!
+** The stages of a pipelined resize, each on its own thread: demux and decode, 
+** scale, and encode and mux. Frames are handed over through blocking queues, a 
+** NULL frame marks the end of the input, and go back to their producer through 
+** lock-free rings.
+*/
+typedef struct mml_resize_pipeline_s
+{
+  AVFormatContext*          input_fmt_ctx;
+  AVCodecContext*           dec_ctx;
+  int                       video_stream_index;
+  struct SwsContext*        sws;
+  int                       width;
+  int                       height;
+  AVRational                enc_tb;
+  mml_frame_pool_p          scaled_pool;
+  /*!
+  ** the copied audio stream, written by the decode stage while the encode 
+  ** stage writes the video, both under the mux lock
+  */
+  AVFormatContext*          output_fmt_ctx;
+  AVStream*                 audio_in;
+  AVStream*                 audio_out;
+  pthread_mutex_t           mux;
+  
+  mml_queue_t               decoded;
+  mml_queue_t               scaled;
+  /*!
+  ** the unreferenced frames handed back by the consumer of each ring, so that 
+  ** the producer reuses them instead of allocating new ones
+  */
+  mml_ring_t                decoded_free;
+  mml_ring_t                scaled_free;
+  /*!
+  ** the first error of any stage and its message, the other stages stop once 
+  ** it is set
+  */
+  int                       ret;
+  char                      error[1024];
+} mml_resize_pipeline_t;
+
+/*!
+** Records the first error of the pipeline with the error message of the 
+** calling stage, and closes the queues to wake up the stages waiting on them.
+*/
+static void
+mml_resize_pipeline_fail(mml_resize_pipeline_t* pipeline, int ret)
+{
+  int expected = MML_SUCCESS;
+  if (__atomic_compare_exchange_n(&pipeline->ret, &expected, ret, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    snprintf(pipeline->error, sizeof(pipeline->error), "%s", err_msg);
+  mml_queue_close(&pipeline->decoded);
+  mml_queue_close(&pipeline->scaled);
+}
+
+static int
+mml_resize_pipeline_failed(mml_resize_pipeline_t* pipeline)
+{
+  return __atomic_load_n(&pipeline->ret, __ATOMIC_ACQUIRE) != MML_SUCCESS;
+}
+
+/*!
+** Gets the error of a failed pipeline, whose queues are closed.
+*/
+static int
+mml_resize_pipeline_error(mml_resize_pipeline_t* pipeline)
+{
+  int ret = __atomic_load_n(&pipeline->ret, __ATOMIC_ACQUIRE);
+  return ret != MML_SUCCESS ? ret : MML_ERROR_NO_CONTENT;
+}
+
+/*!
+** Pushes a frame into a queue, blocking while it is full.
+**
+** @return success, or the error code if the pipeline failed meanwhile
+*/
+static int
+mml_resize_pipeline_push(mml_resize_pipeline_t* pipeline, mml_queue_p queue, AVFrame* frame)
+{
+  if (mml_queue_push(queue, frame) != MML_SUCCESS)
+    return mml_resize_pipeline_error(pipeline);
+  return MML_SUCCESS;
+}
+
+/*!
+** Pops a frame from a queue, blocking while it is empty.
+**
+** @return success, or the error code if the pipeline failed meanwhile
+*/
+static int
+mml_resize_pipeline_pop(mml_resize_pipeline_t* pipeline, mml_queue_p queue, AVFrame** frame)
+{
+  /*!
+  ** 出错后不再处理队列里剩下的帧。
+  */
+  if (mml_resize_pipeline_failed(pipeline) || mml_queue_pop(queue, (void**)frame) != MML_SUCCESS)
+    return mml_resize_pipeline_error(pipeline);
+  return MML_SUCCESS;
+}
+
+/*!
+** Takes a frame handed back through a free ring, or allocates one if there is 
+** none yet.
+*/
+static AVFrame*
+mml_resize_pipeline_frame(mml_ring_p free_ring)
+{
+  AVFrame* frame = NULL;
+  if (mml_ring_pop(free_ring, (void**)&frame) == MML_SUCCESS)
+    return frame;
+  return mml_frame_new();
+}
+
+/*!
+** Hands an unreferenced frame back to its producer through a free ring.
+*/
+static void
+mml_resize_pipeline_recycle(mml_ring_p free_ring, AVFrame* frame)
+{
+  av_frame_unref(frame);
+  if (mml_ring_push(free_ring, frame) != MML_SUCCESS)
+    av_frame_free(&frame);
+}
+
+/*!
+** Releases the frames left in a queue.
+*/
+static void
+mml_resize_pipeline_drain_queue(mml_queue_p queue)
+{
+  AVFrame* frame = NULL;
+  if (queue->items == NULL)
+    return;
+  mml_queue_close(queue);
+  while (mml_queue_pop(queue, (void**)&frame) == MML_SUCCESS)
+    av_frame_free(&frame);
+  mml_queue_free(queue);
+}
+
+/*!
+** Releases the frames left in a ring.
+*/
+static void
+mml_resize_pipeline_drain(mml_ring_p ring)
+{
+  AVFrame* frame = NULL;
+  if (ring->items == NULL)
+    return;
+  while (mml_ring_pop(ring, (void**)&frame) == MML_SUCCESS)
+    av_frame_free(&frame);
+  mml_ring_free(ring);
+}
+
+/*!
+** The demux and decode stage.
+*/
+static void*
+mml_resize_pipeline_decode(void* arg)
+{
+  mml_resize_pipeline_t* pipeline = (mml_resize_pipeline_t*)arg;
+  AVPacket* packet = mml_packet_new();
+  AVFrame* frame = mml_frame_new();
+  int ret = (packet && frame) ? MML_SUCCESS : MML_ERROR_FRAME_NOT_CREATED;
+  
+  if (ret != MML_SUCCESS)
+    sprintf(err_msg, "failed to allocate decoder packet");
+  while (ret == MML_SUCCESS) 
+  {
+    int eof = av_read_frame(pipeline->input_fmt_ctx, packet) < 0;
+    if (!eof && packet->stream_index != pipeline->video_stream_index) 
+    {
+      if (pipeline->audio_in != NULL && packet->stream_index == pipeline->audio_in->index)
+        ret = mml_stream_copy_write(pipeline->output_fmt_ctx, 
+                                    pipeline->audio_in, 
+                                    pipeline->audio_out, 
+                                    packet, 
+                                    &pipeline->mux);
+      else
+        av_packet_unref(packet);
+      continue;
+    }
+    if (avcodec_send_packet(pipeline->dec_ctx, eof ? NULL : packet) == 0) 
+    {
+      while (ret == MML_SUCCESS && avcodec_receive_frame(pipeline->dec_ctx, frame) == 0) 
+      {
+        AVFrame* decoded = mml_resize_pipeline_frame(&pipeline->decoded_free);
+        if (!decoded)
+        {
+          ret = MML_ERROR_FRAME_NOT_CREATED;
+          sprintf(err_msg, "failed to allocate decoded frame");
+          break;
+        }
+        av_frame_move_ref(decoded, frame);
+        ret = mml_resize_pipeline_push(pipeline, &pipeline->decoded, decoded);
+        if (ret != MML_SUCCESS)
+          av_frame_free(&decoded);
+      }
+    }
+    av_packet_unref(packet);
+    if (eof)
+      break;
+  }
+  
+  if (ret == MML_SUCCESS)
+    ret = mml_resize_pipeline_push(pipeline, &pipeline->decoded, NULL);
+  else
+    mml_resize_pipeline_fail(pipeline, ret);
+  av_packet_free(&packet);
+  av_frame_free(&frame);
+  return NULL;
+}
+
+/*!
+** The scale stage, every scaled frame gets its own pooled buffer so it can be 
+** handed over to the encoder.
+*/
+static void*
+mml_resize_pipeline_scale(void* arg)
+{
+  mml_resize_pipeline_t* pipeline = (mml_resize_pipeline_t*)arg;
+  AVFrame* frame = NULL;
+  int ret;
+  
+  while ((ret = mml_resize_pipeline_pop(pipeline, &pipeline->decoded, &frame)) == MML_SUCCESS && 
+         frame != NULL)
+  {
+    AVFrame* scaled_frame = mml_resize_pipeline_frame(&pipeline->scaled_free);
+    if (!scaled_frame || mml_frame_pool_get(pipeline->scaled_pool, scaled_frame) != MML_SUCCESS)
+    {
+      av_frame_free(&scaled_frame);
+      av_frame_free(&frame);
+      ret = MML_ERROR_FRAME_NOT_CREATED;
+      sprintf(err_msg, "failed to allocate scaled frame");
+      break;
+    }
+    
+    sws_scale(pipeline->sws,
+              (const uint8_t * const *)frame->data, 
+              frame->linesize,
+              0,
+              frame->height,
+              scaled_frame->data, 
+              scaled_frame->linesize);
+    scaled_frame->pts = av_rescale_q(frame->pts, 
+                                     pipeline->dec_ctx->time_base, 
+                                     pipeline->enc_tb);
+    mml_resize_pipeline_recycle(&pipeline->decoded_free, frame);
+    
+    ret = mml_resize_pipeline_push(pipeline, &pipeline->scaled, scaled_frame);
+    if (ret != MML_SUCCESS)
+    {
+      av_frame_free(&scaled_frame);
+      break;
+    }
+  }
+  
+  if (ret == MML_SUCCESS)
+    ret = mml_resize_pipeline_push(pipeline, &pipeline->scaled, NULL);
+  else
+    mml_resize_pipeline_fail(pipeline, ret);
+  return NULL;
+}
+
+/*!
+** Runs the decode and scale stages on their own threads and the encode and mux 
+** stage on the calling thread, until the end of the input or the first error.
+*/
+static int
+mml_resize_pipeline_run(mml_resize_pipeline_t* pipeline,
+                        AVFormatContext* output_fmt_ctx,
+                        AVCodecContext* enc_ctx,
+                        AVStream* output_stream,
+                        AVPacket* out_packet)
+{
+  pthread_t       decoder;
+  pthread_t       scaler;
+  int             decoder_started     = 0;
+  int             scaler_started      = 0;
+  AVFrame*        frame               = NULL;
+  int             ret                 = MML_SUCCESS;
+  
+  pipeline->ret = MML_SUCCESS;
+  pipeline->output_fmt_ctx = output_fmt_ctx;
+  pthread_mutex_init(&pipeline->mux, NULL);
+  /*!
+  ** 在途的帧不会超过队列容量加上各阶段手里的各一帧，归还队列放得下全部。
+  */
+  if (mml_queue_init(&pipeline->decoded, 8) != MML_SUCCESS ||
+      mml_queue_init(&pipeline->scaled, 8) != MML_SUCCESS ||
+      mml_ring_init(&pipeline->decoded_free, 16) != MML_SUCCESS ||
+      mml_ring_init(&pipeline->scaled_free, 16) != MML_SUCCESS)
+  {
+    ret = MML_ERROR_THREAD_NOT_CREATED;
+    sprintf(err_msg, "failed to create frame queues");
+    goto RELEASE;
+  }
+  
+  decoder_started = mml_thread_create(&decoder, mml_resize_pipeline_decode, pipeline) == 0;
+  scaler_started = decoder_started && 
+                   mml_thread_create(&scaler, mml_resize_pipeline_scale, pipeline) == 0;
+  if (!scaler_started)
+  {
+    ret = MML_ERROR_THREAD_NOT_CREATED;
+    sprintf(err_msg, "failed to create pipeline threads");
+    mml_resize_pipeline_fail(pipeline, ret);
+    goto RELEASE;
+  }
+  
+  while ((ret = mml_resize_pipeline_pop(pipeline, &pipeline->scaled, &frame)) == MML_SUCCESS && 
+         frame != NULL)
+  {
+    ret = mml_stream_encode_locked(output_fmt_ctx, enc_ctx, output_stream, out_packet, frame, &pipeline->mux);
+    mml_resize_pipeline_recycle(&pipeline->scaled_free, frame);
+    if (ret != MML_SUCCESS)
+      break;
+  }
+  if (ret == MML_SUCCESS)
+    ret = mml_stream_encode(output_fmt_ctx, enc_ctx, output_stream, out_packet, NULL);
+  else if (!mml_resize_pipeline_failed(pipeline))
+    mml_resize_pipeline_fail(pipeline, ret);
+  
+RELEASE:
+  
+  if (decoder_started)
+    mml_thread_join(decoder);
+  if (scaler_started)
+    mml_thread_join(scaler);
+  /*!
+  ** 保留最先出错的阶段的错误信息，它没有留下信息时才用笼统的提示。
+  */
+  if (ret != MML_SUCCESS && mml_resize_pipeline_failed(pipeline))
+  {
+    if (pipeline->error[0] != '\0')
+      snprintf(err_msg, sizeof(err_msg), "%s", pipeline->error);
+    else
+      sprintf(err_msg, "failed to decode or scale frame");
+  }
+  /*!
+  ** 释放出错时还留在队列里的帧和归还的空帧。
+  */
+  mml_resize_pipeline_drain_queue(&pipeline->decoded);
+  mml_resize_pipeline_drain_queue(&pipeline->scaled);
+  mml_resize_pipeline_drain(&pipeline->decoded_free);
+  mml_resize_pipeline_drain(&pipeline->scaled_free);
+  pthread_mutex_destroy(&pipeline->mux);
+  
+  return ret;
+}
+
+/*
+********************************************************************************
+**
+** mml_video_resize
+**
+********************************************************************************
+*/
+int
+mml_video_resize(const char* 	original_path, 
+                 const char* 	output_path, 
+                 int 					width, 
+                 int 					height)
+{
+  return mml_video_resize_ex(original_path, output_path, width, height, NULL);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_resize_ex
+**
+********************************************************************************
+*/
+int
+mml_video_resize_ex(const char* 	original_path, 
+                    const char* 	output_path, 
+                    int 					width, 
+                    int 					height,
+                    const mml_options_t* options)
+{
+	AVFormatContext* input_format_context = NULL;
+  AVFormatContext* output_format_context = NULL;
+  AVCodecContext* input_codec_context = NULL;
+  AVCodecContext* output_codec_context = NULL;
+  AVCodec* output_codec = NULL;
   AVStream* input_video_stream = NULL;
   AVStream* output_video_stream = NULL;
+  AVStream* input_audio_stream = NULL;
+  AVStream* output_audio_stream = NULL;
   AVPacket* packet = NULL;
   AVFrame* frame = NULL;
+  AVPacket* out_packet = NULL;
   AVFrame* scaled_frame = NULL;
+  mml_frame_pool_t scaled_pool = {0};
   struct SwsContext *sws_ctx = NULL;
   int video_stream_index = -1;
   int ret;
 
+  if (options == NULL)
+    options = &options_default;
+
   ret = mml_stream_open(original_path, 
                        	AVMEDIA_TYPE_VIDEO, 
+                       	options,
                        	&input_format_context, 
                        	&input_codec_context,
                        	&input_video_stream,
@@ -977,12 +1864,14 @@ mml_video_resize(const char* 	original_path,
                      &output_format_context, 
                      &output_codec_context,
                      &output_codec);
+	if (ret != MML_SUCCESS)
+		goto RELEASE;
 
   output_codec_context->width = width;
   output_codec_context->height = height;
   output_codec_context->pix_fmt = AV_PIX_FMT_YUV420P;
   output_codec_context->time_base = input_codec_context->time_base;
-  output_codec_context->bit_rate = 400000;
+  mml_codec_options(output_codec_context, options, &mml_profile_default);
 
   ret = mml_stream_new(output_format_context, 
                        output_codec_context, 
@@ -993,8 +1882,15 @@ mml_video_resize(const char* 	original_path,
   
   output_video_stream->time_base = output_codec_context->time_base;
 
+  ret = mml_stream_copy_open(input_format_context, 
+                             output_format_context, 
+                             &input_audio_stream, 
+                             &output_audio_stream);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+
   if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) {
-    if (avio_open(&output_format_context->pb, output_path, AVIO_FLAG_WRITE) < 0) 
+    if (mml_output_open(output_format_context, output_path) != MML_SUCCESS) 
     {
       ret = MML_ERROR_FILE_OPEN_FAILED;
       sprintf(err_msg, "failed to open output file '%s'", output_path);
@@ -1028,8 +1924,8 @@ mml_video_resize(const char* 	original_path,
     goto RELEASE;
   }
 
-  frame = av_frame_alloc();
-  scaled_frame = av_frame_alloc();
+  frame = mml_frame_new();
+  scaled_frame = mml_frame_new();
   if (!frame || !scaled_frame) 
   {
     ret = MML_ERROR_FRAME_NOT_CREATED;
@@ -1037,18 +1933,14 @@ mml_video_resize(const char* 	original_path,
     goto RELEASE;
   }
 
-  scaled_frame->format = AV_PIX_FMT_YUV420P;
-  scaled_frame->width = width;
-  scaled_frame->height = height;
-
-  if (av_frame_get_buffer(scaled_frame, 32) < 0) 
+  ret = mml_frame_pool_init(&scaled_pool, AV_PIX_FMT_YUV420P, width, height);
+  if (ret != MML_SUCCESS) 
   {
-    ret = MML_ERROR_FRAME_NOT_CREATED;
-    sprintf(err_msg, "failed to allocate frame");
+    sprintf(err_msg, "failed to allocate frame pool");
     goto RELEASE;
   }
 
-  packet = av_packet_alloc();
+  packet = mml_packet_new();
   if (!packet) 
   {
     ret = MML_ERROR_FRAME_NOT_CREATED;
@@ -1056,67 +1948,112 @@ mml_video_resize(const char* 	original_path,
     goto RELEASE;
   }
 
-  while (av_read_frame(input_format_context, packet) >= 0) {
-    if (packet->stream_index == video_stream_index) {
-      if (avcodec_send_packet(input_codec_context, packet) == 0) {
-        while (avcodec_receive_frame(input_codec_context, frame) == 0) {
-          // Scale the frame
-          sws_scale(sws_ctx,
-                    (const uint8_t * const *)frame->data, 
-                    frame->linesize,
-                    0,
-                    input_codec_context->height,
-                    scaled_frame->data, 
-                    scaled_frame->linesize);
-
-          scaled_frame->pts = av_rescale_q(frame->pts, 
-                                           input_codec_context->time_base, 
-                                           output_codec_context->time_base);
-
-          if (avcodec_send_frame(output_codec_context, scaled_frame) < 0) 
-          {
-            ret = MML_ERROR_FRAME_NOT_SENT;
-            sprintf(err_msg, "failed to send frame to encoder");
-            goto RELEASE;
-          }
-
-          AVPacket* out_packet = av_packet_alloc();
-          if (!out_packet) 
-          {
-            ret = MML_ERROR_PACKET_NOT_CREATED;
-            sprintf(err_msg, "failed to allocate output packet");
-            goto RELEASE;
-          }
-
-          while (avcodec_receive_packet(output_codec_context, out_packet) == 0) 
-          {
-            av_packet_rescale_ts(out_packet, output_codec_context->time_base, output_video_stream->time_base);
-            out_packet->stream_index = output_video_stream->index;
-            if (av_interleaved_write_frame(output_format_context, out_packet) < 0) 
-            {
-              ret = MML_ERROR_FRAME_NOT_WRITTEN;
-              sprintf(err_msg, "failed to write output frame");
-              goto RELEASE;
-            }
-            av_packet_unref(out_packet);
-          }
-
-          av_packet_free(&out_packet);
-        }
-      }
-      else 
+  out_packet = mml_packet_new();
+  if (!out_packet) 
+  {
+    ret = MML_ERROR_PACKET_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate output packet");
+    goto RELEASE;
+  }
+
+  /*!
+  ** 流水线模式：解码、缩放和编码分别在不同的线程上运行。
+  */
+  if (options->pipeline)
+  {
+    mml_resize_pipeline_t pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.input_fmt_ctx = input_format_context;
+    pipeline.dec_ctx = input_codec_context;
+    pipeline.video_stream_index = video_stream_index;
+    pipeline.sws = sws_ctx;
+    pipeline.width = width;
+    pipeline.height = height;
+    pipeline.enc_tb = output_codec_context->time_base;
+    pipeline.scaled_pool = &scaled_pool;
+    pipeline.audio_in = input_audio_stream;
+    pipeline.audio_out = output_audio_stream;
+    ret = mml_resize_pipeline_run(&pipeline, 
+                                  output_format_context, 
+                                  output_codec_context, 
+                                  output_video_stream, 
+                                  out_packet);
+    if (ret != MML_SUCCESS)
+      goto RELEASE;
+    goto TRAILER;
+  }
+
+  /*!
+  ** 读到文件末尾后用NULL包清空解码器，多线程解码时缓存的帧较多。
+  */
+  while (ret == MML_SUCCESS) 
+  {
+    int eof = av_read_frame(input_format_context, packet) < 0;
+    if (!eof && packet->stream_index != video_stream_index) 
+    {
+      /*!
+      ** 音频直接复制，由复用器和编码后的视频交错写入。
+      */
+      if (input_audio_stream != NULL && packet->stream_index == input_audio_stream->index)
+        ret = mml_stream_copy_write(output_format_context, 
+                                    input_audio_stream, 
+                                    output_audio_stream, 
+                                    packet, 
+                                    NULL);
+      else
+        av_packet_unref(packet);
+      continue;
+    }
+    if (avcodec_send_packet(input_codec_context, eof ? NULL : packet) == 0) 
+    {
+      while (ret == MML_SUCCESS && avcodec_receive_frame(input_codec_context, frame) == 0) 
       {
-				// TODO: audio stream
+        // Scale the frame into a pooled buffer the encoder is not holding
+        av_frame_unref(scaled_frame);
+        ret = mml_frame_pool_get(&scaled_pool, scaled_frame);
+        if (ret != MML_SUCCESS)
+        {
+          sprintf(err_msg, "failed to allocate frame");
+          break;
+        }
+        sws_scale(sws_ctx,
+                  (const uint8_t * const *)frame->data, 
+                  frame->linesize,
+                  0,
+                  input_codec_context->height,
+                  scaled_frame->data, 
+                  scaled_frame->linesize);
+
+        scaled_frame->pts = av_rescale_q(frame->pts, 
+                                         input_codec_context->time_base, 
+                                         output_codec_context->time_base);
+
+        ret = mml_stream_encode(output_format_context, 
+                                output_codec_context, 
+                                output_video_stream, 
+                                out_packet, 
+                                scaled_frame);
       }
-      av_packet_unref(packet);
     }
+    av_packet_unref(packet);
+    if (eof)
+      break;
   }
+  if (ret == MML_SUCCESS)
+    ret = mml_stream_encode(output_format_context, 
+                            output_codec_context, 
+                            output_video_stream, 
+                            out_packet, 
+                            NULL);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
 
+TRAILER:
   av_write_trailer(output_format_context);
 
   if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) 
   {
-    avio_closep(&output_format_context->pb);
+    mml_output_close(output_format_context);
   }
 
 RELEASE:
@@ -1126,7 +2063,7 @@ RELEASE:
   if (output_codec_context != NULL)
   	avcodec_free_context(&output_codec_context);
   if (input_format_context != NULL)
-  	avformat_close_input(&input_format_context);
+  	mml_input_close(&input_format_context);
   if (output_format_context != NULL)
   	avformat_free_context(output_format_context);
   if (sws_ctx != NULL)
@@ -1137,8 +2074,11 @@ RELEASE:
   	av_frame_free(&scaled_frame);
   if (packet != NULL)
   	av_packet_free(&packet);
+  if (out_packet != NULL)
+  	av_packet_free(&out_packet);
+  mml_frame_pool_free(&scaled_pool);
 
-  return 0;
+  return ret;
 }
 
 /*
@@ -1153,6 +2093,23 @@ mml_video_pad(const char* 	original_path,
               const char* 	output_path, 
               int 					width, 
               int 					height)
+{
+  return mml_video_pad_ex(original_path, output_path, width, height, NULL);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_pad_ex
+**
+********************************************************************************
+*/
+int
+mml_video_pad_ex(const char* 	original_path, 
+                 const char* 	output_path, 
+                 int 					width, 
+                 int 					height,
+                 const mml_options_t* options)
 {
 	AVFormatContext* input_format_context = NULL;
   AVFormatContext* output_format_context = NULL;
@@ -1161,15 +2118,23 @@ mml_video_pad(const char* 	original_path,
   AVCodec* output_codec = NULL;
   AVStream* input_video_stream = NULL;
   AVStream* output_video_stream = NULL;
+  AVStream* input_audio_stream = NULL;
+  AVStream* output_audio_stream = NULL;
   AVPacket* packet = NULL;
   AVFrame* frame = NULL;
+  AVPacket* out_packet = NULL;
   AVFrame* padded_frame = NULL;
+  mml_frame_pool_t padded_pool = {0};
   struct SwsContext *sws_ctx = NULL;
   int video_stream_index = -1;
   int ret;
 
+  if (options == NULL)
+    options = &options_default;
+
   ret = mml_stream_open(original_path, 
                        	AVMEDIA_TYPE_VIDEO, 
+                       	options,
                        	&input_format_context, 
                        	&input_codec_context,
                        	&input_video_stream,
@@ -1185,12 +2150,14 @@ mml_video_pad(const char* 	original_path,
                      &output_format_context, 
                      &output_codec_context,
                      &output_codec);
+	if (ret != MML_SUCCESS)
+		goto RELEASE;
 
   output_codec_context->width = width;
   output_codec_context->height = height;
   output_codec_context->pix_fmt = AV_PIX_FMT_YUV420P;
   output_codec_context->time_base = input_codec_context->time_base;
-  output_codec_context->bit_rate = 400000;
+  mml_codec_options(output_codec_context, options, &mml_profile_default);
 
   ret = mml_stream_new(output_format_context, 
                        output_codec_context, 
@@ -1201,8 +2168,15 @@ mml_video_pad(const char* 	original_path,
   
   output_video_stream->time_base = output_codec_context->time_base;
 
+  ret = mml_stream_copy_open(input_format_context, 
+                             output_format_context, 
+                             &input_audio_stream, 
+                             &output_audio_stream);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+
   if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) {
-    if (avio_open(&output_format_context->pb, output_path, AVIO_FLAG_WRITE) < 0) 
+    if (mml_output_open(output_format_context, output_path) != MML_SUCCESS) 
     {
       ret = MML_ERROR_FILE_OPEN_FAILED;
       sprintf(err_msg, "failed to open output file '%s'", output_path);
@@ -1242,10 +2216,12 @@ mml_video_pad(const char* 	original_path,
   }
 
   // Calculate padding (black borders)
+  // 偏移按目标格式的色度采样对齐，否则色度会错开半个采样
   int pad_left = (target_width - scaled_width) / 2;
-  int pad_right = target_width - scaled_width - pad_left;
   int pad_top = (target_height - scaled_height) / 2;
-  int pad_bottom = target_height - scaled_height - pad_top;
+  mml_frame_align_offset(target_format, &pad_left, &pad_top);
+  uint8_t pad_color[3];
+  mml_frame_color_yuv(options->pad_color, pad_color);
 
   // Initialize the scaling context
   sws_ctx = sws_getContext(input_codec_context->width, 
@@ -1253,7 +2229,7 @@ mml_video_pad(const char* 	original_path,
                            input_codec_context->pix_fmt,
                            scaled_width, 
                            scaled_height, 
-                           AV_PIX_FMT_YUV420P,
+                           target_format,
                            SWS_BILINEAR, 
                            NULL, 
                            NULL, 
@@ -1266,8 +2242,8 @@ mml_video_pad(const char* 	original_path,
     goto RELEASE;
   }
 
-  frame = av_frame_alloc();
-  padded_frame = av_frame_alloc();
+  frame = mml_frame_new();
+  padded_frame = mml_frame_new();
   if (!frame || !padded_frame) 
   {
     ret = MML_ERROR_FRAME_NOT_CREATED;
@@ -1275,18 +2251,18 @@ mml_video_pad(const char* 	original_path,
     goto RELEASE;
   }
 
-  padded_frame->format = AV_PIX_FMT_YUV420P;
-  padded_frame->width = width;
-  padded_frame->height = height;
-
-  if (av_frame_get_buffer(padded_frame, 32) < 0) 
+  /*!
+  ** 黑边在池中的缓冲第一次分配时画好，之后缩放只写中间区域。
+  */
+  ret = mml_frame_pool_init(&padded_pool, target_format, width, height);
+  if (ret != MML_SUCCESS)
   {
-    ret = MML_ERROR_FRAME_NOT_CREATED;
-    sprintf(err_msg, "failed to allocate frame");
+    sprintf(err_msg, "failed to allocate frame pool");
     goto RELEASE;
   }
+  mml_frame_pool_border(&padded_pool, pad_left, pad_top, scaled_width, scaled_height, pad_color);
 
-  packet = av_packet_alloc();
+  packet = mml_packet_new();
   if (!packet) 
   {
     ret = MML_ERROR_FRAME_NOT_CREATED;
@@ -1294,75 +2270,86 @@ mml_video_pad(const char* 	original_path,
     goto RELEASE;
   }
 
-  while (av_read_frame(input_format_context, packet) >= 0) {
-    if (packet->stream_index == video_stream_index) {
-      if (avcodec_send_packet(input_codec_context, packet) == 0) {
-        while (avcodec_receive_frame(input_codec_context, frame) == 0) {
-          // Scale the frame
-          AVFrame* scaled_frame = av_frame_alloc();
-          av_image_alloc(scaled_frame->data, scaled_frame->linesize, scaled_width, scaled_height, target_format, 1);
-          
-          sws_scale(sws_ctx,
-                    (const uint8_t * const *)frame->data, 
-                    frame->linesize,
-                    0,
-                    input_codec_context->height,
-                    scaled_frame->data, 
-                    scaled_frame->linesize);
-
-          // Copy the scaled frame into the padded frame at the centered position
-          
-          mml_frame_pad(padded_frame->data, padded_frame->linesize,
-            					 (const uint8_t **)scaled_frame->data, scaled_frame->linesize,
-                      	scaled_width, scaled_height, pad_left, pad_right, pad_top, pad_bottom,
-                      	target_width, target_height, target_format);
-          padded_frame->pts = frame->pts;
-         	padded_frame->duration = frame->duration;
-          
-          scaled_frame->pts = av_rescale_q(frame->pts, 
-                                           input_codec_context->time_base, 
-                                           output_codec_context->time_base);
-
-          if (avcodec_send_frame(output_codec_context, padded_frame) < 0) 
-          {
-            ret = MML_ERROR_FRAME_NOT_SENT;
-            sprintf(err_msg, "failed to send frame to encoder");
-            goto RELEASE;
-          }
-
-          AVPacket* out_packet = av_packet_alloc();
-          if (!out_packet) 
-          {
-            ret = MML_ERROR_PACKET_NOT_CREATED;
-            sprintf(err_msg, "failed to allocate output packet");
-            goto RELEASE;
-          }
-
-          while (avcodec_receive_packet(output_codec_context, out_packet) == 0) 
-          {
-            av_packet_rescale_ts(out_packet, output_codec_context->time_base, output_video_stream->time_base);
-            out_packet->stream_index = output_video_stream->index;
-            if (av_interleaved_write_frame(output_format_context, out_packet) < 0) 
-            {
-              ret = MML_ERROR_FRAME_NOT_WRITTEN;
-              sprintf(err_msg, "failed to write output frame");
-              goto RELEASE;
-            }
-            av_packet_unref(out_packet);
-          }
-          av_frame_free(&scaled_frame);
-          av_packet_free(&out_packet);
+  out_packet = mml_packet_new();
+  if (!out_packet) 
+  {
+    ret = MML_ERROR_PACKET_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate output packet");
+    goto RELEASE;
+  }
+
+  /*!
+  ** 读到文件末尾后用NULL包清空解码器，多线程解码时缓存的帧较多。
+  */
+  while (ret == MML_SUCCESS) 
+  {
+    int eof = av_read_frame(input_format_context, packet) < 0;
+    if (!eof && packet->stream_index != video_stream_index) 
+    {
+      if (input_audio_stream != NULL && packet->stream_index == input_audio_stream->index)
+        ret = mml_stream_copy_write(output_format_context, 
+                                    input_audio_stream, 
+                                    output_audio_stream, 
+                                    packet, 
+                                    NULL);
+      else
+        av_packet_unref(packet);
+      continue;
+    }
+    if (avcodec_send_packet(input_codec_context, eof ? NULL : packet) == 0) 
+    {
+      while (ret == MML_SUCCESS && avcodec_receive_frame(input_codec_context, frame) == 0) 
+      {
+        uint8_t* rect[4];
+        
+        /*!
+        ** 编码器可能还引用着上一帧的缓冲，每帧从池里取一块空闲的。
+        */
+        av_frame_unref(padded_frame);
+        ret = mml_frame_pool_get(&padded_pool, padded_frame);
+        if (ret != MML_SUCCESS)
+        {
+          sprintf(err_msg, "failed to allocate frame");
+          break;
         }
+        
+        // Scale the frame straight into the centered position of the padded frame
+        mml_frame_rect_planes(padded_frame, pad_left, pad_top, rect);
+        sws_scale(sws_ctx,
+                  (const uint8_t * const *)frame->data, 
+                  frame->linesize,
+                  0,
+                  input_codec_context->height,
+                  rect, 
+                  padded_frame->linesize);
+        padded_frame->pts = frame->pts;
+        padded_frame->duration = frame->duration;
+
+        ret = mml_stream_encode(output_format_context, 
+                                output_codec_context, 
+                                output_video_stream, 
+                                out_packet, 
+                                padded_frame);
       }
-      av_packet_unref(packet);
     }
+    av_packet_unref(packet);
+    if (eof)
+      break;
   }
+  if (ret == MML_SUCCESS)
+    ret = mml_stream_encode(output_format_context, 
+                            output_codec_context, 
+                            output_video_stream, 
+                            out_packet, 
+                            NULL);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
 
   av_write_trailer(output_format_context);
 
   if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) 
   {
-    avio_closep(&output_format_context->pb);
+    mml_output_close(output_format_context);
   }
 
 RELEASE:
@@ -1372,7 +2359,7 @@ RELEASE:
   if (output_codec_context != NULL)
   	avcodec_free_context(&output_codec_context);
   if (input_format_context != NULL)
-  	avformat_close_input(&input_format_context);
+  	mml_input_close(&input_format_context);
   if (output_format_context != NULL)
   	avformat_free_context(output_format_context);
   if (sws_ctx != NULL)
@@ -1381,271 +2368,2382 @@ RELEASE:
   	av_frame_free(&frame);
   if (padded_frame != NULL)
   	av_frame_free(&padded_frame);
+  mml_frame_pool_free(&padded_pool);
   if (packet != NULL)
   	av_packet_free(&packet);
+  if (out_packet != NULL)
+  	av_packet_free(&out_packet);
+
+  return ret;
+}
+
+/*!
+** A rendition of a ladder, scaling and encoding the shared decoded frames on 
+** its own thread. A closed frame queue marks the end of the input.
+*/
+typedef struct mml_ladder_branch_s
+{
+  const mml_rendition_t*    rendition;
+  AVFormatContext*          fmt_ctx;
+  AVCodecContext*           enc_ctx;
+  AVStream*                 stream;
+  AVPacket*                 pkt;
+  AVFrame*                  scaled_frame;
+  struct SwsContext*        sws;
+  mml_frame_pool_t          pool;
+  AVRational                dec_tb;
+  /*!
+  ** the decoded frames from the decoder, and their unreferenced frames handed 
+  ** back so that the decoder reuses them
+  */
+  mml_queue_t               frames;
+  mml_ring_t                free_frames;
+  /*!
+  ** set by any branch or the decoder to stop the whole ladder
+  */
+  int*                      failed;
+  pthread_t                 thread;
+  int                       started;
+  int                       ret;
+} mml_ladder_branch_t;
+
+/*!
+** Scales and encodes a shared decoded frame.
+*/
+static int
+mml_ladder_branch_encode(mml_ladder_branch_t* branch, AVFrame* frame)
+{
+  AVCodecContext* enc_ctx = branch->enc_ctx;
+  int             ret;
+  
+  branch->sws = sws_getCachedContext(branch->sws, 
+                                     frame->width, frame->height, frame->format,
+                                     enc_ctx->width, enc_ctx->height, enc_ctx->pix_fmt,
+                                     SWS_BILINEAR, NULL, NULL, NULL);
+  if (!branch->sws)
+    return MML_ERROR_CODEC_NOT_CREATED;
+  
+  av_frame_unref(branch->scaled_frame);
+  ret = mml_frame_pool_get(&branch->pool, branch->scaled_frame);
+  if (ret != MML_SUCCESS)
+    return ret;
+  
+  sws_scale(branch->sws,
+            (const uint8_t * const *)frame->data, 
+            frame->linesize,
+            0,
+            frame->height,
+            branch->scaled_frame->data, 
+            branch->scaled_frame->linesize);
+  branch->scaled_frame->pts = av_rescale_q(frame->pts, branch->dec_tb, enc_ctx->time_base);
+  
+  return mml_stream_encode(branch->fmt_ctx, 
+                           enc_ctx, 
+                           branch->stream, 
+                           branch->pkt, 
+                           branch->scaled_frame);
+}
+
+/*!
+** The thread of a branch. After an error the branch closes its queue, which 
+** stops the decoder, and drops the frames still queued.
+*/
+static void*
+mml_ladder_branch_run(void* arg)
+{
+  mml_ladder_branch_t*  branch  = (mml_ladder_branch_t*)arg;
+  AVFrame*              frame   = NULL;
+  int                   ret     = MML_SUCCESS;
+  
+  while (mml_queue_pop(&branch->frames, (void**)&frame) == MML_SUCCESS)
+  {
+    if (ret == MML_SUCCESS && !__atomic_load_n(branch->failed, __ATOMIC_ACQUIRE))
+    {
+      ret = mml_ladder_branch_encode(branch, frame);
+      if (ret != MML_SUCCESS)
+      {
+        __atomic_store_n(branch->failed, 1, __ATOMIC_RELEASE);
+        mml_queue_close(&branch->frames);
+      }
+    }
+    av_frame_unref(frame);
+    if (mml_ring_push(&branch->free_frames, frame) != MML_SUCCESS)
+      av_frame_free(&frame);
+  }
+  
+  if (ret == MML_SUCCESS && !__atomic_load_n(branch->failed, __ATOMIC_ACQUIRE))
+  {
+    ret = mml_stream_encode(branch->fmt_ctx, branch->enc_ctx, branch->stream, branch->pkt, NULL);
+    if (ret == MML_SUCCESS && av_write_trailer(branch->fmt_ctx) < 0)
+      ret = MML_ERROR_FILE_NOT_WRITTEN;
+  }
+  if (ret != MML_SUCCESS)
+    __atomic_store_n(branch->failed, 1, __ATOMIC_RELEASE);
+  branch->ret = ret;
+  return NULL;
+}
+
+/*!
+** Opens the encoder, the output file and the frame queues of a branch.
+*/
+static int
+mml_ladder_branch_open(mml_ladder_branch_t* branch, 
+                       const AVCodecContext* dec_ctx,
+                       const mml_options_t* options)
+{
+  const mml_rendition_t*  rendition       = branch->rendition;
+  mml_options_t           branch_options  = *options;
+  AVCodec*                codec           = NULL;
+  int                     ret;
+  
+  ret = mml_enc_init(rendition->output_path, 
+                     AV_CODEC_ID_H264, 
+                     &branch->fmt_ctx, 
+                     &branch->enc_ctx,
+                     &codec);
+  if (ret != MML_SUCCESS)
+    return ret;
+  
+  branch->enc_ctx->width = rendition->width;
+  branch->enc_ctx->height = rendition->height;
+  branch->enc_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+  branch->enc_ctx->time_base = dec_ctx->time_base;
+  /*!
+  ** 每档可以有自己的配置和码率，没有时沿用选项里的。
+  */
+  if (rendition->profile != NULL)
+    branch_options.profile = rendition->profile;
+  mml_codec_options(branch->enc_ctx, &branch_options, &mml_profile_default);
+  /*!
+  ** 恒定质量时 x264 不看 bit_rate，码率通过 VBV 的上限和缓冲区限制，
+  ** 按码率编码时同样不超过上限。
+  */
+  if (rendition->bit_rate > 0)
+  {
+    branch->enc_ctx->bit_rate = rendition->bit_rate;
+    branch->enc_ctx->rc_max_rate = rendition->bit_rate;
+    branch->enc_ctx->rc_buffer_size = (int)FFMIN(rendition->bit_rate * 2, INT_MAX);
+  }
+  
+  ret = mml_stream_new(branch->fmt_ctx, branch->enc_ctx, codec, &branch->stream);
+  if (ret != MML_SUCCESS)
+    return ret;
+  branch->stream->time_base = branch->enc_ctx->time_base;
+  
+  if (!(branch->fmt_ctx->oformat->flags & AVFMT_NOFILE)) 
+  {
+    if (mml_output_open(branch->fmt_ctx, rendition->output_path) != MML_SUCCESS) 
+    {
+      sprintf(err_msg, "failed to open output file '%s'", rendition->output_path);
+      return MML_ERROR_FILE_OPEN_FAILED;
+    }
+  }
+  if (avformat_write_header(branch->fmt_ctx, NULL) < 0) 
+  {
+    sprintf(err_msg, "failed to write header to '%s'", rendition->output_path);
+    return MML_ERROR_FILE_NOT_WRITTEN;
+  }
+  
+  branch->dec_tb = dec_ctx->time_base;
+  branch->pkt = mml_packet_new();
+  branch->scaled_frame = mml_frame_new();
+  if (!branch->pkt || !branch->scaled_frame ||
+      mml_frame_pool_init(&branch->pool, AV_PIX_FMT_YUV420P, rendition->width, rendition->height) != MML_SUCCESS)
+  {
+    sprintf(err_msg, "failed to allocate frame");
+    return MML_ERROR_FRAME_NOT_CREATED;
+  }
+  
+  /*!
+  ** 在途的帧不会超过队列容量加上分支手里的一帧，归还队列放得下全部。
+  */
+  if (mml_queue_init(&branch->frames, 8) != MML_SUCCESS ||
+      mml_ring_init(&branch->free_frames, 16) != MML_SUCCESS)
+  {
+    sprintf(err_msg, "failed to create frame queues");
+    return MML_ERROR_THREAD_NOT_CREATED;
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Releases a branch, its thread has to be joined already.
+*/
+static void
+mml_ladder_branch_close(mml_ladder_branch_t* branch)
+{
+  AVFrame* frame = NULL;
+  
+  if (branch->frames.items != NULL)
+  {
+    while (mml_queue_pop(&branch->frames, (void**)&frame) == MML_SUCCESS)
+      av_frame_free(&frame);
+    mml_queue_free(&branch->frames);
+  }
+  if (branch->free_frames.items != NULL)
+  {
+    while (mml_ring_pop(&branch->free_frames, (void**)&frame) == MML_SUCCESS)
+      av_frame_free(&frame);
+    mml_ring_free(&branch->free_frames);
+  }
+  if (branch->enc_ctx != NULL)
+    avcodec_free_context(&branch->enc_ctx);
+  if (branch->fmt_ctx != NULL)
+  {
+    if (!(branch->fmt_ctx->oformat->flags & AVFMT_NOFILE))
+      mml_output_close(branch->fmt_ctx);
+    avformat_free_context(branch->fmt_ctx);
+    branch->fmt_ctx = NULL;
+  }
+  if (branch->sws != NULL)
+    sws_freeContext(branch->sws);
+  if (branch->scaled_frame != NULL)
+    av_frame_free(&branch->scaled_frame);
+  if (branch->pkt != NULL)
+    av_packet_free(&branch->pkt);
+  mml_frame_pool_free(&branch->pool);
+}
 
-  return 0;
+/*!
+** Hands a reference of a decoded frame to every branch, the frame buffers are 
+** shared and not copied.
+**
+** @return success, or the error code if a branch stopped
+*/
+static int
+mml_ladder_dispatch(mml_ladder_branch_t* branches, int nb_branches, const AVFrame* frame)
+{
+  for (int i = 0; i < nb_branches; i++)
+  {
+    AVFrame* ref = NULL;
+    if (mml_ring_pop(&branches[i].free_frames, (void**)&ref) != MML_SUCCESS)
+      ref = mml_frame_new();
+    if (!ref || av_frame_ref(ref, frame) < 0)
+    {
+      av_frame_free(&ref);
+      sprintf(err_msg, "failed to allocate frame");
+      return MML_ERROR_FRAME_NOT_CREATED;
+    }
+    if (mml_queue_push(&branches[i].frames, ref) != MML_SUCCESS)
+    {
+      av_frame_free(&ref);
+      return MML_ERROR_FRAME_NOT_SENT;
+    }
+  }
+  return MML_SUCCESS;
 }
 
 /*
 ********************************************************************************
 **
-** mml_video_concat
+** mml_video_ladder
 **
 ********************************************************************************
 */
 int
-mml_video_concat(const char* original_path1, 
-                 const char* original_path2, 
-                 const char* output_path)
+mml_video_ladder(const char* original_path, 
+                 const mml_rendition_t* renditions, 
+                 int nb_renditions)
+{
+  return mml_video_ladder_ex(original_path, renditions, nb_renditions, NULL);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_ladder_ex
+**
+********************************************************************************
+*/
+int
+mml_video_ladder_ex(const char* original_path, 
+                    const mml_rendition_t* renditions, 
+                    int nb_renditions,
+                    const mml_options_t* options)
+{
+  AVFormatContext*      input_format_context  = NULL;
+  AVCodecContext*       input_codec_context   = NULL;
+  AVStream*             input_video_stream    = NULL;
+  AVPacket*             packet                = NULL;
+  AVFrame*              frame                 = NULL;
+  mml_ladder_branch_t*  branches              = NULL;
+  int                   video_stream_index    = -1;
+  int                   failed                = 0;
+  int                   ret;
+  
+  if (options == NULL)
+    options = &options_default;
+  
+  if (nb_renditions < 1)
+  {
+    ret = MML_ERROR_FILE_NOT_EXIST;
+    sprintf(err_msg, "no rendition to write");
+    return ret;
+  }
+  
+  ret = mml_stream_open(original_path, 
+                        AVMEDIA_TYPE_VIDEO, 
+                        options,
+                        &input_format_context, 
+                        &input_codec_context,
+                        &input_video_stream,
+                        &video_stream_index);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+  
+  input_codec_context->time_base = input_video_stream->time_base;
+  
+  frame = mml_frame_new();
+  packet = mml_packet_new();
+  branches = (mml_ladder_branch_t*)calloc(nb_renditions, sizeof(mml_ladder_branch_t));
+  if (!frame || !packet || !branches) 
+  {
+    ret = MML_ERROR_FRAME_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate frame");
+    goto RELEASE;
+  }
+  
+  for (int i = 0; i < nb_renditions; i++)
+  {
+    branches[i].rendition = &renditions[i];
+    branches[i].failed = &failed;
+    ret = mml_ladder_branch_open(&branches[i], input_codec_context, options);
+    if (ret != MML_SUCCESS)
+      goto RELEASE;
+  }
+  for (int i = 0; i < nb_renditions; i++)
+  {
+    branches[i].started = mml_thread_create(&branches[i].thread, mml_ladder_branch_run, &branches[i]) == 0;
+    if (!branches[i].started)
+    {
+      ret = MML_ERROR_THREAD_NOT_CREATED;
+      sprintf(err_msg, "failed to create rendition threads");
+      __atomic_store_n(&failed, 1, __ATOMIC_RELEASE);
+      goto RELEASE;
+    }
+  }
+  
+  /*!
+  ** 只解码一次，每帧的引用交给所有分支。
+  */
+  while (ret == MML_SUCCESS) 
+  {
+    int eof = av_read_frame(input_format_context, packet) < 0;
+    if (!eof && packet->stream_index != video_stream_index) 
+    {
+      av_packet_unref(packet);
+      continue;
+    }
+    if (avcodec_send_packet(input_codec_context, eof ? NULL : packet) == 0) 
+    {
+      while (ret == MML_SUCCESS && avcodec_receive_frame(input_codec_context, frame) == 0) 
+      {
+        ret = mml_ladder_dispatch(branches, nb_renditions, frame);
+        av_frame_unref(frame);
+      }
+    }
+    av_packet_unref(packet);
+    if (eof)
+      break;
+  }
+  if (ret != MML_SUCCESS)
+    __atomic_store_n(&failed, 1, __ATOMIC_RELEASE);
+  
+RELEASE:
+  
+  if (branches != NULL)
+  {
+    for (int i = 0; i < nb_renditions; i++)
+      mml_queue_close(&branches[i].frames);
+    for (int i = 0; i < nb_renditions; i++)
+    {
+      if (branches[i].started)
+        mml_thread_join(branches[i].thread);
+      /*!
+      ** 分配失败以外的错误以出错分支的为准。
+      */
+      if (branches[i].ret != MML_SUCCESS && 
+          (ret == MML_SUCCESS || ret == MML_ERROR_FRAME_NOT_SENT))
+      {
+        ret = branches[i].ret;
+        sprintf(err_msg, "failed to encode rendition '%s'", branches[i].rendition->output_path);
+      }
+      mml_ladder_branch_close(&branches[i]);
+    }
+    free(branches);
+  }
+  if (input_codec_context != NULL)
+  	avcodec_free_context(&input_codec_context);
+  if (input_format_context != NULL)
+  	mml_input_close(&input_format_context);
+  if (frame != NULL)
+  	av_frame_free(&frame);
+  if (packet != NULL)
+  	av_packet_free(&packet);
+  
+  return ret;
+}
+
+/*!
+** The timestamp continuity state of an output stream, see mml_stream_remux.
+*/
+typedef struct mml_remux_s
+{
+  int64_t                   prev_pts;
+  int64_t                   prev_dts;
+  int64_t                   prev_dur;
+  
+  int64_t                   offset_pts;
+  int64_t                   offset_dts;
+} mml_remux_t;
+
+/*!
+** Maps the streams of an input onto the shared output streams: the n-th input 
+** stream of a media type goes to the n-th output stream of that type, or -1 if 
+** there is none.
+*/
+static void
+mml_stream_map(AVFormatContext* input_fmt_ctx, 
+               AVFormatContext* output_fmt_ctx, 
+               int* stream_map)
+{
+  int used[64] = {0};
+  
+  for (int j = 0; j < input_fmt_ctx->nb_streams; j++)
+  {
+    enum AVMediaType type = input_fmt_ctx->streams[j]->codecpar->codec_type;
+    stream_map[j] = -1;
+    for (int k = 0; k < output_fmt_ctx->nb_streams && k < 64; k++)
+    {
+      if (!used[k] && output_fmt_ctx->streams[k]->codecpar->codec_type == type)
+      {
+        used[k] = 1;
+        stream_map[j] = k;
+        break;
+      }
+    }
+  }
+}
+
+/*
+********************************************************************************
+**
+** mml_video_concat
+**
+********************************************************************************
+*/
+int
+mml_video_concat(const char* original_path1, 
+                 const char* original_path2, 
+                 const char* output_path)
+{
+  const char* original_paths[2] = { original_path1, original_path2 };
+  return mml_video_concat_files(original_paths, 2, output_path);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_concat_files
+**
+********************************************************************************
+*/
+int
+mml_video_concat_files(const char** original_paths, 
+                       int nb_paths, 
+                       const char* output_path)
+{
+  return mml_video_concat_files_ex(original_paths, nb_paths, output_path, NULL);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_concat_files_ex
+**
+********************************************************************************
+*/
+int
+mml_video_concat_files_ex(const char** original_paths, 
+                          int nb_paths, 
+                          const char* output_path,
+                          const mml_options_t* options)
+{
+  AVFormatContext* 		input_fmt_ctx 				= NULL;
+  AVFormatContext* 		output_fmt_ctx 				= NULL;
+  AVPacket* 					packet                = NULL;
+  mml_remux_t*        remux                 = NULL;
+  int*                stream_map            = NULL;
+  int ret;
+  
+  if (nb_paths < 1)
+  {
+    ret = MML_ERROR_FILE_NOT_EXIST;
+    sprintf(err_msg, "no video to concatenate");
+    return ret;
+  }
+  
+  /*!
+  ** 用第一个输入的流创建输出流，之后所有输入都映射到这一组输出流上。
+  */
+  ret = mml_format_open(original_paths[0], 
+                        &input_fmt_ctx,
+                        MML_IO_SEQUENTIAL);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+  
+  avformat_alloc_output_context2(&output_fmt_ctx, NULL, "mp4", output_path);
+  if (!output_fmt_ctx)
+  {
+    ret = MML_ERROR_FORMAT_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate output format context for '%s'", output_path);
+    goto RELEASE;
+  }
+  
+  for (int j = 0; j < input_fmt_ctx->nb_streams; j++)
+  {
+    AVStream* out_stream;
+    AVStream* in_stream = input_fmt_ctx->streams[j];
+    AVCodecParameters *in_codecpar = in_stream->codecpar;
+    
+    if (in_codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+        in_codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+      continue;
+
+    out_stream = avformat_new_stream(output_fmt_ctx, NULL);
+    if (!out_stream) 
+    {
+      ret = MML_ERROR_STREAM_NOT_CREATED;
+      sprintf(err_msg, "failed to create stream");
+      goto RELEASE;
+    }
+
+    ret = avcodec_parameters_copy(out_stream->codecpar, in_codecpar);
+    out_stream->codecpar->frame_size = 5;
+    if (ret < 0) 
+    {
+      ret = MML_ERROR_CODEC_NOT_COPIED;
+      sprintf(err_msg, "failed to copy codec parameters");
+      goto RELEASE;
+    }
+    out_stream->codecpar->codec_tag = 0;
+  }
+  
+  if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+    if (mml_output_open(output_fmt_ctx, output_path) != MML_SUCCESS) 
+    {
+      ret = MML_ERROR_FILE_OPEN_FAILED;
+      sprintf(err_msg, "failed to open file '%s'", output_path);
+      goto RELEASE;
+    }
+  }
+  
+  ret = mml_output_write_header(output_fmt_ctx, options);
+  if (ret < 0) 
+  {
+    ret = MML_ERROR_STREAM_WRITE_FAILED;
+    sprintf(err_msg, "failed to write header to '%s'", output_path);
+    goto RELEASE;
+  }
+  
+  remux = (mml_remux_t*)calloc(output_fmt_ctx->nb_streams, sizeof(mml_remux_t));
+  packet = av_packet_alloc();
+  if (!packet || !remux) 
+  {
+    ret = MML_ERROR_FRAME_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate input packet");
+    goto RELEASE;
+  }
+  
+  /*!
+  ** 同一时刻只打开一个输入文件。
+  */
+  for (int i = 0; i < nb_paths; i++) 
+  {
+    if (input_fmt_ctx == NULL)
+    {
+      ret = mml_format_open(original_paths[i], 
+                            &input_fmt_ctx,
+                            MML_IO_SEQUENTIAL);
+      if (ret != MML_SUCCESS)
+        goto RELEASE;
+    }
+    
+    int* map = (int*)realloc(stream_map, sizeof(int) * input_fmt_ctx->nb_streams);
+    if (!map)
+    {
+      ret = MML_ERROR_STREAM_NOT_CREATED;
+      sprintf(err_msg, "failed to allocate stream map for '%s'", original_paths[i]);
+      goto RELEASE;
+    }
+    stream_map = map;
+    mml_stream_map(input_fmt_ctx, output_fmt_ctx, stream_map);
+    
+    while (av_read_frame(input_fmt_ctx, packet) >= 0) 
+    {
+      AVStream* in_stream = input_fmt_ctx->streams[packet->stream_index];
+      int out_index = stream_map[packet->stream_index];
+      if (out_index == -1)
+      {
+        av_packet_unref(packet);
+        continue;
+      }
+      
+      AVStream* out_stream = output_fmt_ctx->streams[out_index];
+      mml_remux_t* state = &remux[out_index];
+      packet->stream_index = out_index;
+      if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+      {
+        if (packet->pts > packet->dts)
+        {
+          packet->pts = packet->dts;
+        }
+      }
+      mml_stream_remux(packet, 
+                       in_stream->time_base, 
+                       out_stream->time_base,
+                       output_fmt_ctx,
+                       &state->prev_dts, 
+                       &state->prev_pts, 
+                       &state->prev_dur, 
+                       &state->offset_dts, 
+                       &state->offset_pts);
+      av_packet_unref(packet);
+    }
+    
+    mml_format_close(&input_fmt_ctx);
+  }
+  av_write_trailer(output_fmt_ctx);
+  
+  if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) 
+    mml_output_close(output_fmt_ctx);
+  
+RELEASE:
+  
+  if (input_fmt_ctx != NULL)
+  	mml_format_close(&input_fmt_ctx);
+  if (output_fmt_ctx != NULL)
+  	avformat_free_context(output_fmt_ctx);
+  if (packet != NULL)
+  	av_packet_free(&packet);
+  if (remux != NULL)
+    free(remux);
+  if (stream_map != NULL)
+    free(stream_map);
+  
+	return ret;
+}
+
+/*!
+** Tells whether the packets of a stream can be copied into an output stream 
+** with the given codec parameters, i.e. nothing a decoder needs to know up 
+** front differs. NULL stands for a missing stream.
+*/
+static int
+mml_codecpar_match(const AVCodecParameters* codecpar, 
+                   const AVCodecParameters* target)
+{
+  if (codecpar == NULL || target == NULL)
+    return codecpar == target;
+  if (codecpar->codec_type != target->codec_type || 
+      codecpar->codec_id != target->codec_id ||
+      codecpar->profile != target->profile)
+    return 0;
+  if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+    return codecpar->width == target->width && 
+           codecpar->height == target->height &&
+           codecpar->format == target->format;
+  if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+    return codecpar->sample_rate == target->sample_rate && 
+           av_channel_layout_compare(&codecpar->ch_layout, &target->ch_layout) == 0;
+  return 1;
+}
+
+/*!
+** The state of re-encoding one input stream to the codec parameters of an 
+** output stream of the adaptive concat.
+*/
+typedef struct mml_transcode_s
+{
+  AVFormatContext*          output_fmt_ctx;
+  AVStream*                 in_stream;
+  AVStream*                 out_stream;
+  AVCodecContext*           dec_ctx;
+  AVCodecContext*           enc_ctx;
+  struct SwsContext*        sws;
+  SwrContext*               swr;
+  AVAudioFifo*              fifo;
+  AVFrame*                  frame;
+  AVFrame*                  enc_frame;
+  AVPacket*                 pkt;
+  mml_remux_t*              remux;
+  /*!
+  ** the buffers of the encoder frames, and the resampled samples growing to 
+  ** the largest converted frame
+  */
+  mml_frame_pool_t          pool;
+  uint8_t**                 samples;
+  int                       max_samples;
+  /*!
+  ** the pts of the next audio frame, in samples
+  */
+  int64_t                   next_pts;
+} mml_transcode_t;
+
+/*!
+** Releases the decoder, the encoder and the converters of a transcoder.
+*/
+static void
+mml_transcode_close(mml_transcode_t* trans)
+{
+  if (trans->dec_ctx != NULL)
+    avcodec_free_context(&trans->dec_ctx);
+  if (trans->enc_ctx != NULL)
+    avcodec_free_context(&trans->enc_ctx);
+  if (trans->sws != NULL)
+    sws_freeContext(trans->sws);
+  if (trans->swr != NULL)
+    swr_free(&trans->swr);
+  if (trans->fifo != NULL)
+    av_audio_fifo_free(trans->fifo);
+  if (trans->frame != NULL)
+    av_frame_free(&trans->frame);
+  if (trans->enc_frame != NULL)
+    av_frame_free(&trans->enc_frame);
+  if (trans->pkt != NULL)
+    av_packet_free(&trans->pkt);
+  if (trans->samples != NULL)
+  {
+    av_freep(&trans->samples[0]);
+    av_freep(&trans->samples);
+  }
+  mml_frame_pool_free(&trans->pool);
+  memset(trans, 0, sizeof(mml_transcode_t));
+}
+
+/*!
+** Opens a transcoder from an input stream to an output stream. The encoder 
+** takes its codec parameters from the output stream, uses no B-frames and 
+** keeps the parameter sets in-band, so its packets can be joined to copied 
+** ones.
+*/
+static int
+mml_transcode_open(mml_transcode_t* trans, 
+                   AVStream* in_stream, 
+                   AVStream* out_stream,
+                   AVFormatContext* output_fmt_ctx,
+                   mml_remux_t* remux,
+                   const mml_options_t* options)
+{
+  AVCodecParameters* target = out_stream->codecpar;
+  const AVCodec* dec = avcodec_find_decoder(in_stream->codecpar->codec_id);
+  const AVCodec* enc = avcodec_find_encoder(target->codec_id);
+  
+  trans->in_stream = in_stream;
+  trans->out_stream = out_stream;
+  trans->output_fmt_ctx = output_fmt_ctx;
+  trans->remux = remux;
+  trans->next_pts = 0;
+  
+  if (!dec || !enc)
+  {
+    sprintf(err_msg, "no codec found for id: %d", !dec ? in_stream->codecpar->codec_id : target->codec_id);
+    return MML_ERROR_CODEC_NOT_FOUND;
+  }
+  
+  trans->dec_ctx = avcodec_alloc_context3(dec);
+  trans->enc_ctx = avcodec_alloc_context3(enc);
+  trans->frame = mml_frame_new();
+  trans->enc_frame = mml_frame_new();
+  trans->pkt = mml_packet_new();
+  if (!trans->dec_ctx || !trans->enc_ctx || !trans->frame || !trans->enc_frame || !trans->pkt)
+  {
+    sprintf(err_msg, "failed to allocate transcoder");
+    return MML_ERROR_CODEC_NOT_CREATED;
+  }
+  
+  if (avcodec_parameters_to_context(trans->dec_ctx, in_stream->codecpar) < 0 ||
+      avcodec_open2(trans->dec_ctx, dec, NULL) < 0)
+  {
+    sprintf(err_msg, "failed to open decoder codec");
+    return MML_ERROR_CODEC_OPEN_FAILED;
+  }
+  
+  trans->enc_ctx->bit_rate = target->bit_rate;
+  trans->enc_ctx->profile = target->profile;
+  if (target->codec_type == AVMEDIA_TYPE_VIDEO)
+  {
+    trans->enc_ctx->width = target->width;
+    trans->enc_ctx->height = target->height;
+    trans->enc_ctx->pix_fmt = target->format;
+    trans->enc_ctx->sample_aspect_ratio = target->sample_aspect_ratio;
+    trans->enc_ctx->time_base = in_stream->time_base;
+    trans->enc_ctx->framerate = in_stream->avg_frame_rate;
+    mml_codec_options(trans->enc_ctx, options, NULL);
+    trans->enc_ctx->max_b_frames = 0;
+  }
+  else
+  {
+    trans->enc_ctx->sample_rate = target->sample_rate;
+    trans->enc_ctx->sample_fmt = target->format;
+    av_channel_layout_copy(&trans->enc_ctx->ch_layout, &target->ch_layout);
+    trans->enc_ctx->time_base = (AVRational){1, target->sample_rate};
+  }
+  
+  /*!
+  ** MP4 等格式要求参数集放在文件头里，编码器输出 Annex B 参数集后再
+  ** 由 mml_packet_parameter_sets 补到每个关键帧前面。
+  */
+  if (output_fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER)
+    trans->enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  
+  if (avcodec_open2(trans->enc_ctx, enc, NULL) < 0)
+  {
+    sprintf(err_msg, "failed to open encoder codec");
+    return MML_ERROR_CODEC_OPEN_FAILED;
+  }
+  
+  if (target->codec_type == AVMEDIA_TYPE_AUDIO)
+  {
+    if (swr_alloc_set_opts2(&trans->swr, 
+                            &trans->enc_ctx->ch_layout, 
+                            trans->enc_ctx->sample_fmt, 
+                            trans->enc_ctx->sample_rate,
+                            &trans->dec_ctx->ch_layout, 
+                            trans->dec_ctx->sample_fmt, 
+                            trans->dec_ctx->sample_rate,
+                            0, NULL) < 0 || swr_init(trans->swr) < 0)
+    {
+      sprintf(err_msg, "failed to create audio resampler");
+      return MML_ERROR_CODEC_NOT_CREATED;
+    }
+    trans->fifo = av_audio_fifo_alloc(trans->enc_ctx->sample_fmt, 
+                                      trans->enc_ctx->ch_layout.nb_channels, 
+                                      1);
+    if (!trans->fifo || 
+        mml_frame_pool_init_audio(&trans->pool, 
+                                  trans->enc_ctx->sample_fmt, 
+                                  &trans->enc_ctx->ch_layout, 
+                                  trans->enc_ctx->sample_rate, 
+                                  trans->enc_ctx->frame_size > 0 ? trans->enc_ctx->frame_size : 1024) != MML_SUCCESS)
+    {
+      sprintf(err_msg, "failed to allocate audio fifo");
+      return MML_ERROR_CODEC_NOT_CREATED;
+    }
+  }
+  else if (mml_frame_pool_init(&trans->pool, 
+                               trans->enc_ctx->pix_fmt, 
+                               trans->enc_ctx->width, 
+                               trans->enc_ctx->height) != MML_SUCCESS)
+  {
+    sprintf(err_msg, "failed to allocate frame pool");
+    return MML_ERROR_FRAME_NOT_CREATED;
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Encodes a converted frame, or flushes the encoder with NULL, and writes the 
+** packets with the timestamps continuing the output stream.
+*/
+static int
+mml_transcode_encode(mml_transcode_t* trans, AVFrame* frame)
+{
+  if (avcodec_send_frame(trans->enc_ctx, frame) < 0)
+  {
+    sprintf(err_msg, "failed to send frame to encoder");
+    return MML_ERROR_FRAME_NOT_SENT;
+  }
+  while (avcodec_receive_packet(trans->enc_ctx, trans->pkt) == 0)
+  {
+    if (trans->pkt->duration == 0 && trans->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+      trans->pkt->duration = av_rescale_q(1, 
+                                          av_inv_q(trans->enc_ctx->framerate), 
+                                          trans->enc_ctx->time_base);
+    if (mml_packet_parameter_sets(trans->pkt, trans->enc_ctx) != MML_SUCCESS)
+    {
+      av_packet_unref(trans->pkt);
+      return MML_ERROR_PACKET_NOT_CREATED;
+    }
+    trans->pkt->stream_index = trans->out_stream->index;
+    mml_stream_remux(trans->pkt, 
+                     trans->enc_ctx->time_base, 
+                     trans->out_stream->time_base,
+                     trans->output_fmt_ctx,
+                     &trans->remux->prev_dts, 
+                     &trans->remux->prev_pts, 
+                     &trans->remux->prev_dur, 
+                     &trans->remux->offset_dts, 
+                     &trans->remux->offset_pts);
+    av_packet_unref(trans->pkt);
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Resamples a decoded audio frame, or flushes the resampler with NULL, and 
+** encodes the samples in frames of the encoder frame size. The remaining 
+** samples are only encoded when flushing.
+*/
+static int
+mml_transcode_audio(mml_transcode_t* trans, AVFrame* frame)
+{
+  int               ret           = MML_SUCCESS;
+  int               channels      = trans->enc_ctx->ch_layout.nb_channels;
+  int               frame_size    = trans->enc_ctx->frame_size > 0 ? trans->enc_ctx->frame_size : 1024;
+  int               nb_samples;
+  
+  nb_samples = swr_get_out_samples(trans->swr, frame != NULL ? frame->nb_samples : 0);
+  if (nb_samples > trans->max_samples)
+  {
+    /*!
+    ** 转换缓冲只在遇到更大的帧时重新分配。
+    */
+    if (trans->samples != NULL)
+    {
+      av_freep(&trans->samples[0]);
+      av_freep(&trans->samples);
+    }
+    trans->max_samples = 0;
+    if (av_samples_alloc_array_and_samples(&trans->samples, NULL, channels, nb_samples, 
+                                           trans->enc_ctx->sample_fmt, 0) < 0)
+    {
+      sprintf(err_msg, "failed to allocate audio samples");
+      return MML_ERROR_FRAME_NOT_CREATED;
+    }
+    trans->max_samples = nb_samples;
+  }
+  if (nb_samples > 0)
+  {
+    nb_samples = swr_convert(trans->swr, trans->samples, nb_samples, 
+                             frame != NULL ? (const uint8_t**)frame->extended_data : NULL, 
+                             frame != NULL ? frame->nb_samples : 0);
+    if (nb_samples > 0)
+      av_audio_fifo_write(trans->fifo, (void**)trans->samples, nb_samples);
+  }
+  
+  while (ret == MML_SUCCESS && 
+         (av_audio_fifo_size(trans->fifo) >= frame_size || 
+          (frame == NULL && av_audio_fifo_size(trans->fifo) > 0)))
+  {
+    AVFrame* enc_frame = trans->enc_frame;
+    av_frame_unref(enc_frame);
+    if (mml_frame_pool_get(&trans->pool, enc_frame) != MML_SUCCESS)
+    {
+      sprintf(err_msg, "failed to allocate audio frame");
+      return MML_ERROR_FRAME_NOT_CREATED;
+    }
+    enc_frame->nb_samples = FFMIN(av_audio_fifo_size(trans->fifo), frame_size);
+    av_audio_fifo_read(trans->fifo, (void**)enc_frame->data, enc_frame->nb_samples);
+    enc_frame->pts = trans->next_pts;
+    trans->next_pts += enc_frame->nb_samples;
+    ret = mml_transcode_encode(trans, enc_frame);
+  }
+  return ret;
+}
+
+/*!
+** Decodes a packet, or flushes the decoder with NULL, and converts and encodes 
+** the frames.
+*/
+static int
+mml_transcode_decode(mml_transcode_t* trans, AVPacket* packet)
+{
+  int ret = MML_SUCCESS;
+  
+  if (avcodec_send_packet(trans->dec_ctx, packet) < 0)
+    return MML_SUCCESS;
+  while (ret == MML_SUCCESS && avcodec_receive_frame(trans->dec_ctx, trans->frame) == 0)
+  {
+    AVFrame* frame = trans->frame;
+    if (trans->enc_ctx->codec_type == AVMEDIA_TYPE_AUDIO)
+    {
+      ret = mml_transcode_audio(trans, frame);
+      av_frame_unref(frame);
+      continue;
+    }
+    
+    /*!
+    ** 分辨率和像素格式都一致时不需要缩放。
+    */
+    if (frame->width != trans->enc_ctx->width || 
+        frame->height != trans->enc_ctx->height || 
+        frame->format != trans->enc_ctx->pix_fmt)
+    {
+      AVFrame* enc_frame = trans->enc_frame;
+      trans->sws = sws_getCachedContext(trans->sws, 
+                                        frame->width, frame->height, frame->format,
+                                        trans->enc_ctx->width, trans->enc_ctx->height, trans->enc_ctx->pix_fmt,
+                                        SWS_BILINEAR, NULL, NULL, NULL);
+      av_frame_unref(enc_frame);
+      if (mml_frame_pool_get(&trans->pool, enc_frame) != MML_SUCCESS)
+      {
+        ret = MML_ERROR_FRAME_NOT_CREATED;
+        sprintf(err_msg, "failed to allocate video frame");
+        break;
+      }
+      if (!trans->sws)
+      {
+        ret = MML_ERROR_FRAME_NOT_CREATED;
+        sprintf(err_msg, "failed to scale video frame");
+        break;
+      }
+      sws_scale(trans->sws, 
+                (const uint8_t* const*)frame->data, frame->linesize, 0, frame->height,
+                enc_frame->data, enc_frame->linesize);
+      enc_frame->pts = frame->best_effort_timestamp;
+      enc_frame->pict_type = AV_PICTURE_TYPE_NONE;
+      ret = mml_transcode_encode(trans, enc_frame);
+    }
+    else
+    {
+      frame->pts = frame->best_effort_timestamp;
+      frame->pict_type = AV_PICTURE_TYPE_NONE;
+      ret = mml_transcode_encode(trans, frame);
+    }
+    av_frame_unref(frame);
+  }
+  return ret;
+}
+
+/*!
+** Drains the decoder, the resampler and the encoder at the end of an input.
+*/
+static int
+mml_transcode_finish(mml_transcode_t* trans)
+{
+  int ret = mml_transcode_decode(trans, NULL);
+  if (ret == MML_SUCCESS && trans->swr != NULL)
+    ret = mml_transcode_audio(trans, NULL);
+  if (ret == MML_SUCCESS)
+    ret = mml_transcode_encode(trans, NULL);
+  return ret;
+}
+
+/*
+********************************************************************************
+**
+** mml_audio_extract
+**
+********************************************************************************
+*/
+int 
+mml_audio_extract(const char* original_video_path, 
+                  const char* output_audio_path)
+{
+  int									 ret 										= MML_SUCCESS;
+  AVFormatContext* 	 		input_format_context	 	= NULL;
+  AVFormatContext*	 		output_format_context 	= NULL;
+  AVStream*							input_audio_stream			= NULL;
+  AVStream*							output_audio_stream			= NULL;
+  AVPacket* 						packet 									= NULL;
+  mml_transcode_t				trans;
+  mml_remux_t						remux;
+  int										audio_stream_index;
+  
+  memset(&trans, 0, sizeof(trans));
+  memset(&remux, 0, sizeof(remux));
+  
+  ret = mml_format_open(original_video_path, &input_format_context, MML_IO_SEQUENTIAL);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+
+  if (avformat_find_stream_info(input_format_context, NULL) < 0) 
+  {
+    ret = MML_ERROR_STREAM_NOT_FOUND;
+   	sprintf(err_msg, "'%s' stream not found", original_video_path);
+    goto RELEASE;
+  }
+	
+  audio_stream_index = av_find_best_stream(input_format_context, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+  if (audio_stream_index < 0) 
+  {
+    ret = MML_ERROR_STREAM_NOT_FOUND;
+    sprintf(err_msg, "no audio stream found for '%s'", original_video_path);
+		goto RELEASE;
+  }
+  
+  avformat_alloc_output_context2(&output_format_context, NULL, NULL, mml_io_name(output_audio_path));
+  if (!output_format_context) 
+  {
+    ret = MML_ERROR_CODEC_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate output format context for '%s'", output_audio_path);
+    goto RELEASE;
+  }
+  
+  /*!
+  ** 输出格式支持原来的音频编码时直接复制数据包，不解码。
+  */
+  ret = mml_stream_copy_open(input_format_context, 
+                             output_format_context, 
+                             &input_audio_stream, 
+                             &output_audio_stream);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+  
+  /*!
+  ** 否则转码成输出格式默认的音频编码。
+  */
+  if (input_audio_stream == NULL)
+  {
+    enum AVCodecID codec_id = output_format_context->oformat->audio_codec;
+    const AVCodec* enc = avcodec_find_encoder(codec_id);
+    if (codec_id == AV_CODEC_ID_NONE || !enc)
+    {
+      ret = MML_ERROR_CODEC_NOT_FOUND;
+      sprintf(err_msg, "no audio codec found for '%s'", output_audio_path);
+      goto RELEASE;
+    }
+    
+    input_audio_stream = input_format_context->streams[audio_stream_index];
+    output_audio_stream = avformat_new_stream(output_format_context, NULL);
+    if (!output_audio_stream) 
+    {
+      ret = MML_ERROR_STREAM_NOT_CREATED;
+      sprintf(err_msg, "failed to create output audio stream");
+      goto RELEASE;
+    }
+    
+    AVCodecParameters* target = output_audio_stream->codecpar;
+    target->codec_type = AVMEDIA_TYPE_AUDIO;
+    target->codec_id = codec_id;
+    target->sample_rate = input_audio_stream->codecpar->sample_rate;
+    target->format = enc->sample_fmts != NULL ? enc->sample_fmts[0] : input_audio_stream->codecpar->format;
+    av_channel_layout_copy(&target->ch_layout, &input_audio_stream->codecpar->ch_layout);
+    
+    ret = mml_transcode_open(&trans, 
+                             input_audio_stream, 
+                             output_audio_stream, 
+                             output_format_context, 
+                             &remux, 
+                             &options_default);
+    if (ret != MML_SUCCESS)
+      goto RELEASE;
+    
+    if (avcodec_parameters_from_context(output_audio_stream->codecpar, trans.enc_ctx) < 0) 
+    {
+      ret = MML_ERROR_STREAM_NOT_CREATED;
+      sprintf(err_msg, "failed to copy codec parameters for output audio stream");
+      goto RELEASE;
+    }
+    output_audio_stream->time_base = trans.enc_ctx->time_base;
+  }
+
+  if (!(output_format_context->oformat->flags & AVFMT_NOFILE)) {
+    if (mml_output_open(output_format_context, output_audio_path) != MML_SUCCESS) 
+    {
+      ret = MML_ERROR_FILE_OPEN_FAILED;
+      sprintf(err_msg, "failed to open file '%s'", output_audio_path);
+      goto RELEASE;
+    }
+  }
+
+  if (avformat_write_header(output_format_context, NULL) < 0) 
+  {
+    ret = MML_ERROR_STREAM_WRITE_FAILED;
+    sprintf(err_msg, "failed to write header to '%s'", output_audio_path);
+    goto RELEASE;
+  }
+  
+  packet = mml_packet_new();
+  if (!packet) 
+  {
+    ret = MML_ERROR_PACKET_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate input packet");
+    goto RELEASE;
+  }
+  
+  while (ret == MML_SUCCESS && av_read_frame(input_format_context, packet) >= 0) 
+  {
+    if (packet->stream_index != input_audio_stream->index) 
+    {
+      av_packet_unref(packet);
+      continue;
+    }
+    if (trans.enc_ctx != NULL)
+    {
+      ret = mml_transcode_decode(&trans, packet);
+      av_packet_unref(packet);
+    }
+    else
+    {
+      ret = mml_stream_copy_write(output_format_context, 
+                                  input_audio_stream, 
+                                  output_audio_stream, 
+                                  packet, 
+                                  NULL);
+    }
+  }
+  if (ret == MML_SUCCESS && trans.enc_ctx != NULL)
+    ret = mml_transcode_finish(&trans);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+
+  av_write_trailer(output_format_context);
+
+RELEASE:
+  mml_transcode_close(&trans);
+  if (input_format_context != NULL)
+  	mml_input_close(&input_format_context);
+ 	if (output_format_context != NULL)
+  {
+    if (!(output_format_context->oformat->flags & AVFMT_NOFILE))
+      mml_output_close(output_format_context);
+  	avformat_free_context(output_format_context);
+  }
+  if (packet != NULL) 
+    av_packet_free(&packet);
+
+  return ret;
+}
+
+/*!
+** Moves the streams of an output lagging behind its video to the end of the 
+** video, between two inputs. The next input then starts every stream at the 
+** same time, also after an input missing a stream, instead of continuing 
+** that stream where it stopped.
+*/
+static void
+mml_remux_align(AVFormatContext* output_fmt_ctx, mml_remux_t* remux)
+{
+  AVStream*   video_stream  = NULL;
+  int64_t     video_end;
+  
+  for (int k = 0; k < output_fmt_ctx->nb_streams && video_stream == NULL; k++)
+  {
+    if (output_fmt_ctx->streams[k]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+      video_stream = output_fmt_ctx->streams[k];
+  }
+  if (video_stream == NULL)
+    return;
+  video_end = remux[video_stream->index].prev_dts + remux[video_stream->index].prev_dur;
+  
+  for (int k = 0; k < output_fmt_ctx->nb_streams; k++)
+  {
+    AVStream* stream = output_fmt_ctx->streams[k];
+    int64_t end = av_rescale_q(video_end, video_stream->time_base, stream->time_base);
+    /*!
+    ** 下一个包的时间戳不大于 prev 时从 prev + prev_dur 接上，也就是视频的末尾。
+    */
+    if (stream == video_stream || remux[k].prev_dts + remux[k].prev_dur >= end)
+      continue;
+    remux[k].prev_dts = end - remux[k].prev_dur;
+    remux[k].prev_pts = end - remux[k].prev_dur;
+  }
+}
+
+/*!
+** Reads the codec parameters of the first video and the first audio stream of 
+** a file, or NULL for a missing one.
+*/
+static int
+mml_codecpar_probe(const char* path, 
+                   AVCodecParameters** video_codecpar, 
+                   AVCodecParameters** audio_codecpar)
+{
+  AVFormatContext* 		fmt_ctx 				= NULL;
+  int ret;
+  
+  ret = mml_format_open(path, &fmt_ctx, MML_IO_NORMAL);
+  if (ret != MML_SUCCESS)
+    return ret;
+  
+  if (avformat_find_stream_info(fmt_ctx, NULL) < 0)
+  {
+    mml_format_close(&fmt_ctx);
+    sprintf(err_msg, "'%s' stream not found", path);
+    return MML_ERROR_STREAM_NOT_FOUND;
+  }
+  
+  for (int i = 0; i < fmt_ctx->nb_streams; i++)
+  {
+    AVCodecParameters* codecpar = fmt_ctx->streams[i]->codecpar;
+    AVCodecParameters** dst = NULL;
+    if (codecpar->codec_type == AVMEDIA_TYPE_VIDEO && *video_codecpar == NULL)
+      dst = video_codecpar;
+    else if (codecpar->codec_type == AVMEDIA_TYPE_AUDIO && *audio_codecpar == NULL)
+      dst = audio_codecpar;
+    if (dst == NULL)
+      continue;
+    *dst = avcodec_parameters_alloc();
+    if (*dst == NULL || avcodec_parameters_copy(*dst, codecpar) < 0)
+    {
+      ret = MML_ERROR_CODEC_NOT_COPIED;
+      sprintf(err_msg, "failed to copy codec parameters");
+      break;
+    }
+  }
+  mml_format_close(&fmt_ctx);
+  return ret;
+}
+
+/*
+********************************************************************************
+**
+** mml_video_concat_adaptive
+**
+********************************************************************************
+*/
+int
+mml_video_concat_adaptive(const char** original_paths, 
+                          int nb_paths, 
+                          const char* output_path)
+{
+  return mml_video_concat_adaptive_ex(original_paths, nb_paths, output_path, NULL);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_concat_adaptive_ex
+**
+********************************************************************************
+*/
+int
+mml_video_concat_adaptive_ex(const char** original_paths, 
+                             int nb_paths, 
+                             const char* output_path,
+                             const mml_options_t* options)
+{
+  AVFormatContext* 		input_fmt_ctx 				= NULL;
+  AVFormatContext* 		output_fmt_ctx 				= NULL;
+  AVPacket* 					packet                = NULL;
+  AVCodecParameters** codecpars             = NULL;
+  mml_remux_t*        remux                 = NULL;
+  mml_transcode_t*    trans                 = NULL;
+  AVBSFContext*       bsf                   = NULL;
+  int*                stream_map            = NULL;
+  int                 target                = 0;
+  int                 max_matches           = 0;
+  int ret;
+  
+  if (nb_paths < 1)
+  {
+    ret = MML_ERROR_FILE_NOT_EXIST;
+    sprintf(err_msg, "no video to concatenate");
+    return ret;
+  }
+  if (options == NULL)
+    options = &options_default;
+  
+  /*!
+  ** 先读出所有输入的视频和音频编码参数，codecpars[2 * i]是视频，
+  ** codecpars[2 * i + 1]是音频。
+  */
+  codecpars = (AVCodecParameters**)calloc(nb_paths * 2, sizeof(AVCodecParameters*));
+  if (!codecpars)
+  {
+    ret = MML_ERROR_CODEC_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate codec parameters");
+    return ret;
+  }
+  for (int i = 0; i < nb_paths; i++)
+  {
+    ret = mml_codecpar_probe(original_paths[i], &codecpars[2 * i], &codecpars[2 * i + 1]);
+    if (ret != MML_SUCCESS)
+      goto RELEASE;
+  }
+  
+  /*!
+  ** 与最多输入一致的那组编码参数作为输出的编码参数。
+  */
+  for (int i = 0; i < nb_paths; i++)
+  {
+    int matches = 0;
+    for (int j = 0; j < nb_paths; j++)
+    {
+      if (mml_codecpar_match(codecpars[2 * j], codecpars[2 * i]) &&
+          mml_codecpar_match(codecpars[2 * j + 1], codecpars[2 * i + 1]))
+        matches++;
+    }
+    if (matches > max_matches)
+    {
+      max_matches = matches;
+      target = i;
+    }
+  }
+  
+  avformat_alloc_output_context2(&output_fmt_ctx, NULL, "mp4", output_path);
+  if (!output_fmt_ctx)
+  {
+    ret = MML_ERROR_FORMAT_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate output format context for '%s'", output_path);
+    goto RELEASE;
+  }
+  
+  for (int j = 0; j < 2; j++)
+  {
+    AVCodecParameters* codecpar = codecpars[2 * target + j];
+    if (codecpar == NULL)
+      continue;
+    
+    /*!
+    ** 视频流的参数集转成 Annex B，复制的包经过过滤器后带着各自输入的参数集，
+    ** 重新编码的包带着编码器的参数集，MP4 封装时再统一转回长度前缀格式。
+    */
+    if (j == 0)
+    {
+      ret = mml_stream_annexb_open(codecpar, (AVRational){1, 90000}, &bsf);
+      if (ret != MML_SUCCESS)
+        goto RELEASE;
+      if (bsf != NULL)
+        codecpar = bsf->par_out;
+    }
+    
+    AVStream* out_stream = avformat_new_stream(output_fmt_ctx, NULL);
+    if (!out_stream) 
+    {
+      ret = MML_ERROR_STREAM_NOT_CREATED;
+      sprintf(err_msg, "failed to create stream");
+      goto RELEASE;
+    }
+    if (avcodec_parameters_copy(out_stream->codecpar, codecpar) < 0) 
+    {
+      ret = MML_ERROR_CODEC_NOT_COPIED;
+      sprintf(err_msg, "failed to copy codec parameters");
+      goto RELEASE;
+    }
+    out_stream->codecpar->codec_tag = 0;
+    if (j == 0)
+      mml_stream_inband_tag(out_stream->codecpar);
+    av_bsf_free(&bsf);
+  }
+  
+  if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+    if (mml_output_open(output_fmt_ctx, output_path) != MML_SUCCESS) 
+    {
+      ret = MML_ERROR_FILE_OPEN_FAILED;
+      sprintf(err_msg, "failed to open file '%s'", output_path);
+      goto RELEASE;
+    }
+  }
+  
+  if (mml_output_write_header(output_fmt_ctx, options) < 0) 
+  {
+    ret = MML_ERROR_STREAM_WRITE_FAILED;
+    sprintf(err_msg, "failed to write header to '%s'", output_path);
+    goto RELEASE;
+  }
+  
+  remux = (mml_remux_t*)calloc(output_fmt_ctx->nb_streams, sizeof(mml_remux_t));
+  trans = (mml_transcode_t*)calloc(output_fmt_ctx->nb_streams, sizeof(mml_transcode_t));
+  packet = av_packet_alloc();
+  if (!packet || !remux || !trans) 
+  {
+    ret = MML_ERROR_PACKET_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate packet");
+    goto RELEASE;
+  }
+  
+  /*!
+  ** 编码参数一致的流直接复制，不一致的流解码后按输出的编码参数重新编码，
+  ** 同一时刻只打开一个输入文件。
+  */
+  for (int i = 0; i < nb_paths && ret == MML_SUCCESS; i++) 
+  {
+    int copy[2];
+    for (int j = 0; j < 2; j++)
+      copy[j] = mml_codecpar_match(codecpars[2 * i + j], codecpars[2 * target + j]);
+    
+    ret = mml_format_open(original_paths[i], &input_fmt_ctx, MML_IO_SEQUENTIAL);
+    if (ret != MML_SUCCESS)
+      goto RELEASE;
+    if ((!copy[0] || !copy[1]) && avformat_find_stream_info(input_fmt_ctx, NULL) < 0)
+    {
+      ret = MML_ERROR_STREAM_NOT_FOUND;
+      sprintf(err_msg, "'%s' stream not found", original_paths[i]);
+      goto RELEASE;
+    }
+    
+    int* map = (int*)realloc(stream_map, sizeof(int) * input_fmt_ctx->nb_streams);
+    if (!map)
+    {
+      ret = MML_ERROR_STREAM_NOT_CREATED;
+      sprintf(err_msg, "failed to allocate stream map for '%s'", original_paths[i]);
+      goto RELEASE;
+    }
+    stream_map = map;
+    mml_stream_map(input_fmt_ctx, output_fmt_ctx, stream_map);
+    
+    /*!
+    ** 每个输入的参数集不同，复制视频流时每个输入单独打开过滤器。
+    */
+    for (int k = 0; k < input_fmt_ctx->nb_streams && copy[0]; k++)
+    {
+      AVStream* in_stream = input_fmt_ctx->streams[k];
+      if (stream_map[k] == -1 || in_stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO)
+        continue;
+      ret = mml_stream_annexb_open(in_stream->codecpar, in_stream->time_base, &bsf);
+      if (ret != MML_SUCCESS)
+        goto RELEASE;
+      break;
+    }
+    
+    while (ret == MML_SUCCESS && av_read_frame(input_fmt_ctx, packet) >= 0) 
+    {
+      AVStream* in_stream = input_fmt_ctx->streams[packet->stream_index];
+      int out_index = stream_map[packet->stream_index];
+      if (out_index == -1)
+      {
+        av_packet_unref(packet);
+        continue;
+      }
+      
+      AVStream* out_stream = output_fmt_ctx->streams[out_index];
+      int is_video = in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
+      if (!copy[is_video ? 0 : 1])
+      {
+        if (trans[out_index].enc_ctx == NULL)
+          ret = mml_transcode_open(&trans[out_index], 
+                                   in_stream, 
+                                   out_stream, 
+                                   output_fmt_ctx, 
+                                   &remux[out_index],
+                                   options);
+        if (ret == MML_SUCCESS)
+          ret = mml_transcode_decode(&trans[out_index], packet);
+        av_packet_unref(packet);
+        continue;
+      }
+      
+      mml_remux_t*  state   = &remux[out_index];
+      AVBSFContext* filter  = is_video ? bsf : NULL;
+      if (filter != NULL && av_bsf_send_packet(filter, packet) < 0)
+      {
+        ret = MML_ERROR_FRAME_NOT_WRITTEN;
+        sprintf(err_msg, "failed to filter copied packet");
+        av_packet_unref(packet);
+        continue;
+      }
+      while (filter == NULL || av_bsf_receive_packet(filter, packet) == 0)
+      {
+        packet->stream_index = out_index;
+        if (is_video && packet->pts > packet->dts)
+          packet->pts = packet->dts;
+        mml_stream_remux(packet, 
+                         in_stream->time_base, 
+                         out_stream->time_base,
+                         output_fmt_ctx,
+                         &state->prev_dts, 
+                         &state->prev_pts, 
+                         &state->prev_dur, 
+                         &state->offset_dts, 
+                         &state->offset_pts);
+        av_packet_unref(packet);
+        if (filter == NULL)
+          break;
+      }
+    }
+    
+    for (int k = 0; k < output_fmt_ctx->nb_streams; k++)
+    {
+      if (trans[k].enc_ctx == NULL)
+        continue;
+      if (ret == MML_SUCCESS)
+        ret = mml_transcode_finish(&trans[k]);
+      mml_transcode_close(&trans[k]);
+    }
+    av_bsf_free(&bsf);
+    mml_format_close(&input_fmt_ctx);
+    mml_remux_align(output_fmt_ctx, remux);
+  }
+  av_write_trailer(output_fmt_ctx);
+  
+  if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) 
+    mml_output_close(output_fmt_ctx);
+  
+RELEASE:
+  
+  if (trans != NULL)
+  {
+    for (int k = 0; k < output_fmt_ctx->nb_streams; k++)
+      mml_transcode_close(&trans[k]);
+    free(trans);
+  }
+  if (bsf != NULL)
+    av_bsf_free(&bsf);
+  if (input_fmt_ctx != NULL)
+  	mml_format_close(&input_fmt_ctx);
+  if (output_fmt_ctx != NULL)
+  	avformat_free_context(output_fmt_ctx);
+  if (packet != NULL)
+  	av_packet_free(&packet);
+  if (remux != NULL)
+    free(remux);
+  if (stream_map != NULL)
+    free(stream_map);
+  for (int i = 0; i < nb_paths * 2; i++)
+  {
+    if (codecpars[i] != NULL)
+      avcodec_parameters_free(&codecpars[i]);
+  }
+  free(codecpars);
+  
+	return ret;
+}
+
+/*!
+** The state of one range of a keyframe-aligned cut.
+*/
+typedef struct mml_cut_s
+{
+  AVFormatContext*          output_fmt_ctx;
+  double                    start_time;
+  double                    end_time;
+  int                       opened;
+  int                       start;
+  int                       stop;
+  int64_t                   start_audio_pts;
+  int64_t                   start_video_pts;
+  
+  int64_t                   prev_audio_pts;
+  int64_t                   prev_audio_dts;
+  int64_t                   prev_audio_dur;
+  
+  int64_t                   offset_audio_pts;
+  int64_t                   offset_audio_dts;
+} mml_cut_t;
+
+/*!
+** Creates the output of a cut range with a copy of every input stream and 
+** writes its header.
+*/
+static int
+mml_cut_open(mml_cut_t* cut, 
+             AVFormatContext* input_fmt_ctx, 
+             double start_time,
+             double end_time,
+             const char* output_path,
+             const mml_options_t* options)
+{
+  int ret;
+  
+  memset(cut, 0, sizeof(mml_cut_t));
+  cut->start_time = start_time;
+  cut->end_time = end_time;
+  cut->start_audio_pts = -1;
+  cut->start_video_pts = -1;
+  
+  avformat_alloc_output_context2(&cut->output_fmt_ctx, NULL, "mp4", output_path);
+  if (!cut->output_fmt_ctx)
+  {
+    sprintf(err_msg, "failed to allocate output format context for '%s'", output_path);
+    return MML_ERROR_FORMAT_NOT_CREATED;
+  }
+  
+  for (int j = 0; j < input_fmt_ctx->nb_streams; j++)
+  {
+    AVStream* out_stream;
+    AVStream* in_stream = input_fmt_ctx->streams[j];
+    AVCodecParameters *in_codecpar = in_stream->codecpar;
+
+    out_stream = avformat_new_stream(cut->output_fmt_ctx, NULL);
+    if (!out_stream) 
+    {
+      sprintf(err_msg, "failed to create stream");
+      return MML_ERROR_STREAM_NOT_CREATED;
+    }
+
+    ret = avcodec_parameters_copy(out_stream->codecpar, in_codecpar);
+    out_stream->codecpar->frame_size = 5;
+    if (ret < 0) 
+    {
+      sprintf(err_msg, "failed to copy codec parameters");
+      return MML_ERROR_CODEC_NOT_COPIED;
+    }
+    out_stream->codecpar->codec_tag = 0;
+  }
+  
+  if (!(cut->output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+    if (mml_output_open(cut->output_fmt_ctx, output_path) != MML_SUCCESS) 
+    {
+      sprintf(err_msg, "failed to open file '%s'", output_path);
+      return MML_ERROR_FILE_OPEN_FAILED;
+    }
+  }
+  
+  ret = mml_output_write_header(cut->output_fmt_ctx, options);
+  if (ret < 0) 
+  {
+    sprintf(err_msg, "failed to write header to '%s'", output_path);
+    return MML_ERROR_STREAM_WRITE_FAILED;
+  }
+  cut->opened = 1;
+  
+  return MML_SUCCESS;
+}
+
+/*!
+** Routes an input packet to a cut range. The range starts on the first 
+** keyframe at its start time and stops on the first keyframe after its end 
+** time. The packet is consumed.
+**
+** @return non-zero once the range has stopped
+*/
+static int
+mml_cut_write(mml_cut_t* cut, 
+              AVFormatContext* input_fmt_ctx, 
+              AVPacket* packet)
+{
+  AVStream* in_stream = input_fmt_ctx->streams[packet->stream_index];
+  AVStream* out_stream = cut->output_fmt_ctx->streams[packet->stream_index];
+  double duration_seconds = packet->pts * av_q2d(in_stream->time_base);
+  int keyframe = 0;
+
+  /*!
+  ** 音频，可以粗略地用时间判断起始。
+  */
+  if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && duration_seconds < cut->start_time) 
+  {
+    // 音频未开始
+    av_packet_unref(packet);
+    return cut->stop;
+  }
+  
+  /*!
+  ** 关键帧标识位
+  */
+  if (packet->flags & AV_PKT_FLAG_KEY) 
+    keyframe = 1;
+  else 
+    keyframe = 0;
+  /*!
+  ** 视频，只允许关键帧作为起始帧。
+  */
+  if ((cut->start_time - duration_seconds) < 0.05 && keyframe)
+  {
+    cut->start = 1;
+  }
+  if (!cut->start && in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+  {
+    av_packet_unref(packet);
+    return cut->stop;
+  }
+  /*!
+  ** 视频，必须用关键帧结束。
+  */
+  if (duration_seconds - cut->end_time >= 0.05 && keyframe)
+    cut->stop = 1;
+  av_packet_rescale_ts(packet, in_stream->time_base, out_stream->time_base);
+  packet->pos = -1;
+  if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) 
+  {
+    if (cut->start_audio_pts == -1) 
+      cut->start_audio_pts = packet->pts;
+    packet->pts -= cut->start_audio_pts;
+    packet->dts -= cut->start_audio_pts;
+    mml_stream_remux(packet,
+                     in_stream->time_base, 
+                     out_stream->time_base,
+                     cut->output_fmt_ctx,
+                     &cut->prev_audio_dts, 
+                     &cut->prev_audio_pts, 
+                     &cut->prev_audio_dur, 
+                     &cut->offset_audio_dts, 
+                     &cut->offset_audio_pts);
+  }
+  else if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+  {
+    if (cut->start_video_pts == -1) 
+      cut->start_video_pts = packet->pts;
+    packet->pts -= cut->start_video_pts;
+    packet->dts -= cut->start_video_pts;
+    av_interleaved_write_frame(cut->output_fmt_ctx, packet);
+  }
+  av_packet_unref(packet);
+  return cut->stop;
+}
+
+/*!
+** Finishes the output of a cut range and releases it.
+*/
+static void
+mml_cut_close(mml_cut_t* cut)
+{
+  if (cut->output_fmt_ctx == NULL)
+    return;
+  if (cut->opened)
+    av_write_trailer(cut->output_fmt_ctx);
+  if (!(cut->output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) 
+    mml_output_close(cut->output_fmt_ctx);
+  avformat_free_context(cut->output_fmt_ctx);
+  cut->output_fmt_ctx = NULL;
+  cut->opened = 0;
+}
+
+/*!
+** Releases the output of a cut range that was never written to, deleting 
+** the file it created.
+*/
+static void
+mml_cut_discard(mml_cut_t* cut, const char* output_path)
+{
+  int created;
+  
+  if (cut->output_fmt_ctx == NULL)
+    return;
+  created = cut->output_fmt_ctx->pb != NULL && !mml_io_is_path(output_path);
+  if (!(cut->output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) 
+    mml_output_close(cut->output_fmt_ctx);
+  avformat_free_context(cut->output_fmt_ctx);
+  cut->output_fmt_ctx = NULL;
+  cut->opened = 0;
+  if (created)
+    avpriv_io_delete(output_path);
+}
+
+/*!
+** Finds the index of the first video stream.
+*/
+static int
+mml_video_stream_find(AVFormatContext* fmt_ctx)
+{
+  for (int j = 0; j < fmt_ctx->nb_streams; j++)
+  {
+    if (fmt_ctx->streams[j]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+      return j;
+  }
+  return -1;
+}
+
+/*
+********************************************************************************
+**
+** mml_video_cut
+**
+********************************************************************************
+*/
+int
+mml_video_cut(const char* original_path, 
+              double start_time,
+              double end_time,
+              const char* output_path)
+{
+  return mml_video_cut_ex(original_path, start_time, end_time, output_path, NULL);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_cut_ex
+**
+********************************************************************************
+*/
+int
+mml_video_cut_ex(const char* original_path, 
+                 double start_time,
+                 double end_time,
+                 const char* output_path,
+                 const mml_options_t* options)
+{
+  int                 ret                   = MML_SUCCESS;
+  AVFormatContext* 		input_fmt_ctx 				= NULL;
+  AVPacket* 					packet                = NULL;
+  mml_cut_t           cut;
+  
+  memset(&cut, 0, sizeof(cut));
+  mml_context_current()->bytes_read = 0;
+  ret = mml_format_open(original_path, 
+                        &input_fmt_ctx,
+                        MML_IO_SEQUENTIAL);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+
+  ret = mml_cut_open(&cut, input_fmt_ctx, start_time, end_time, output_path, options);
+  if (ret != MML_SUCCESS)
+    goto RELEASE;
+  
+  packet = av_packet_alloc();
+  if (!packet) 
+  {
+    ret = MML_ERROR_FRAME_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate input packet");
+    goto RELEASE;
+  }
+  
+  /*!
+  ** 直接定位到起始时间之前（含）的视频关键帧，各流都从该位置开始读取，
+  ** 音频由此预读，早于起始时间的音频包仍由下面的循环丢弃。
+  */
+  int video_stream_index = mml_video_stream_find(input_fmt_ctx);
+  if (video_stream_index != -1 && start_time > 0)
+  {
+    mml_stream_seek(input_fmt_ctx, video_stream_index, start_time);
+  }
+  
+  while (av_read_frame(input_fmt_ctx, packet) >= 0) 
+  {
+    /*!
+    ** 结束处理
+    */
+    if (mml_cut_write(&cut, input_fmt_ctx, packet))
+      break;
+  }
+  
+RELEASE:
+  
+  mml_cut_close(&cut);
+  if (input_fmt_ctx != NULL)
+  	mml_format_close(&input_fmt_ctx);
+  if (packet != NULL)
+  	av_packet_free(&packet);
+  
+	return ret;
+}
+
+/*
+********************************************************************************
+**
+** mml_video_cut_ranges
+**
+********************************************************************************
+*/
+int
+mml_video_cut_ranges(const char* original_path, 
+                     const mml_cut_range_t* ranges,
+                     int nb_ranges)
+{
+  return mml_video_cut_ranges_ex(original_path, ranges, nb_ranges, NULL);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_cut_ranges_ex
+**
+********************************************************************************
+*/
+int
+mml_video_cut_ranges_ex(const char* original_path, 
+                        const mml_cut_range_t* ranges,
+                        int nb_ranges,
+                        const mml_options_t* options)
 {
-  AVFormatContext* 		input_fmt_ctx1 				= NULL;
-  AVFormatContext* 		input_fmt_ctx2 				= NULL;
-  AVFormatContext* 		output_fmt_ctx 				= NULL;
-  AVCodecContext* 		dec_ctx1 							= NULL;
-  AVCodecContext* 		dec_ctx2 							= NULL;
-  AVCodecContext* 		enc_ctx 							= NULL;
-  AVCodec*				 		enc			 							= NULL;
-  AVPacket* 					packet                 = NULL;
-  AVFrame* 						frame 								= NULL;
-  AVStream*						input_video_stream1		= NULL;
-  AVStream*						input_video_stream2		= NULL;
-  AVStream*						output_video_stream		= NULL;
-  int									input_video_index1;
-  int									input_video_index2;
-  int									got_frame = 0;
-  int ret;
+  int                 ret                   = MML_SUCCESS;
+  AVFormatContext* 		input_fmt_ctx 				= NULL;
+  AVPacket* 					packet                = NULL;
+  AVPacket* 					range_packet          = NULL;
+  mml_cut_t*          cuts                  = NULL;
+  int                 nb_active             = nb_ranges;
+  int                 nb_opened             = 0;
+  double              start_time            = -1;
   
-  ret = mml_format_open(original_path1, 
-                        &input_fmt_ctx1);
+  mml_context_current()->bytes_read = 0;
+  ret = mml_format_open(original_path, 
+                        &input_fmt_ctx,
+                        MML_IO_SEQUENTIAL);
   if (ret != MML_SUCCESS)
     goto RELEASE;
- 
-  ret = mml_format_open(original_path2, 
-                        &input_fmt_ctx2);
   
-  if (ret != MML_SUCCESS)
+  cuts = (mml_cut_t*)calloc(nb_ranges, sizeof(mml_cut_t));
+  if (!cuts)
+  {
+    ret = MML_ERROR_FORMAT_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate %d cut ranges", nb_ranges);
     goto RELEASE;
-	
-  /*
-  ret = mml_enc_init(output_path, 
-                     AV_CODEC_ID_H264, 
-                     &output_fmt_ctx, 
-                     &enc_ctx, 
-                     &enc);
-                     */
-  ret = avformat_alloc_output_context2(&output_fmt_ctx, NULL, "mp4", output_path);
+  }
   
-  if (ret != MML_SUCCESS)
+  for (int i = 0; i < nb_ranges; i++)
+  {
+    ret = mml_cut_open(&cuts[i], 
+                       input_fmt_ctx, 
+                       ranges[i].start_time, 
+                       ranges[i].end_time, 
+                       ranges[i].output_path,
+                       options);
+    if (ret != MML_SUCCESS)
+      goto RELEASE;
+    nb_opened++;
+    if (start_time < 0 || ranges[i].start_time < start_time)
+      start_time = ranges[i].start_time;
+  }
+  
+  packet = av_packet_alloc();
+  range_packet = av_packet_alloc();
+  if (!packet || !range_packet) 
+  {
+    ret = MML_ERROR_FRAME_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate input packet");
     goto RELEASE;
+  }
+  
+  /*!
+  ** 定位到最早的起始时间，之后源文件只顺序读取一遍，每个包分发给所有未结束的区间。
+  */
+  int video_stream_index = mml_video_stream_find(input_fmt_ctx);
+  if (video_stream_index != -1 && start_time > 0)
+  {
+    mml_stream_seek(input_fmt_ctx, video_stream_index, start_time);
+  }
   
-  for (int i = 0; i < 2; i++)
+  while (nb_active > 0 && av_read_frame(input_fmt_ctx, packet) >= 0) 
   {
-    AVFormatContext* input_fmt_ctx = (i == 0) ? input_fmt_ctx1 : input_fmt_ctx2;
-		for (int j = 0; j < input_fmt_ctx->nb_streams; j++)
+    for (int i = 0; i < nb_ranges; i++)
     {
-			AVStream* out_stream;
-      AVStream* in_stream = input_fmt_ctx->streams[j];
-      AVCodecParameters *in_codecpar = in_stream->codecpar;
-
-      out_stream = avformat_new_stream(output_fmt_ctx, NULL);
-      if (!out_stream) 
-      {
-        ret = MML_ERROR_STREAM_NOT_CREATED;
-        sprintf(err_msg, "failed to create stream");
-        goto RELEASE;
-      }
-
-    	ret = avcodec_parameters_copy(out_stream->codecpar, in_codecpar);
-      out_stream->codecpar->frame_size = 5;
-      if (ret < 0) 
+      if (cuts[i].stop)
+        continue;
+      if (av_packet_ref(range_packet, packet) < 0)
       {
-        ret = MML_ERROR_CODEC_NOT_COPIED;
-        sprintf(err_msg, "failed to copy codec parameters");
+        ret = MML_ERROR_PACKET_NOT_CREATED;
+        sprintf(err_msg, "failed to reference input packet");
         goto RELEASE;
       }
-      out_stream->codecpar->codec_tag = 0;
       /*!
-      ** time base change is working.
-      **
-      ** sample:
-      **		ffprobe -v error -show_entries stream=index,codec_type,time_base ../../data/V1V2.mp4
+      ** 区间结束后立即写入文件尾，不必等待其它区间。
       */
-      /*
-      if (out_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+      if (mml_cut_write(&cuts[i], input_fmt_ctx, range_packet))
       {
-      	out_stream->time_base = (AVRational){1, 44100};
+        mml_cut_close(&cuts[i]);
+        nb_active--;
       }
-      */
-    } // input_fmt_ctx->nb_streams
+    }
+    av_packet_unref(packet);
   }
   
-  if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-    if (avio_open(&output_fmt_ctx->pb, output_path, AVIO_FLAG_WRITE) < 0) 
-    {
-      ret = MML_ERROR_FILE_OPEN_FAILED;
-      sprintf(err_msg, "failed to open file '%s'", output_path);
-      goto RELEASE;
-    }
+RELEASE:
+  
+  /*!
+  ** 有区间打不开时一个包也还没写，已经建好的输出文件全部删掉，不留下空文件。
+  */
+  for (int i = 0; cuts != NULL && i < nb_ranges; i++)
+  {
+    if (nb_opened < nb_ranges)
+      mml_cut_discard(&cuts[i], ranges[i].output_path);
+    else
+      mml_cut_close(&cuts[i]);
   }
+  if (cuts != NULL)
+    free(cuts);
+  if (input_fmt_ctx != NULL)
+  	mml_format_close(&input_fmt_ctx);
+  if (packet != NULL)
+  	av_packet_free(&packet);
+  if (range_packet != NULL)
+  	av_packet_free(&range_packet);
   
-  ret = avformat_write_header(output_fmt_ctx, NULL);
-  if (ret < 0) 
+	return ret;
+}
+
+/*!
+** The state of a frame-accurate cut. Only the partial GOPs at the head and at 
+** the tail are decoded and re-encoded, every whole GOP in between is copied.
+*/
+typedef struct mml_smart_cut_s
+{
+  AVFormatContext*          output_fmt_ctx;
+  AVStream*                 in_stream;
+  AVStream*                 out_stream;
+  AVCodecContext*           dec_ctx;
+  AVCodecContext*           enc_ctx;
+  AVFrame*                  frame;
+  AVPacket*                 pkt;
+  /*!
+  ** turns the copied packets into Annex B like the re-encoded ones, NULL when 
+  ** they already are
+  */
+  AVBSFContext*             bsf;
+  /*!
+  ** the cut range and the end of the segment being re-encoded, in the time 
+  ** base of the input video stream
+  */
+  int64_t                   start_pts;
+  int64_t                   end_pts;
+  int64_t                   segment_end_pts;
+  /*!
+  ** the distance between pts and dts of the copied keyframes, applied to the 
+  ** re-encoded packets to keep dts monotonous across the seams
+  */
+  int64_t                   delay;
+  const mml_options_t*      options;
+} mml_smart_cut_t;
+
+/*!
+** Rebases a video packet in input time base onto the cut start and writes it.
+*/
+static int
+mml_smart_cut_write(mml_smart_cut_t* cut, AVPacket* pkt)
+{
+  if (pkt->pts != AV_NOPTS_VALUE)
+    pkt->pts -= cut->start_pts;
+  if (pkt->dts != AV_NOPTS_VALUE)
+    pkt->dts -= cut->start_pts;
+  av_packet_rescale_ts(pkt, cut->in_stream->time_base, cut->out_stream->time_base);
+  pkt->stream_index = cut->out_stream->index;
+  pkt->pos = -1;
+  if (av_interleaved_write_frame(cut->output_fmt_ctx, pkt) < 0)
   {
-    ret = MML_ERROR_STREAM_WRITE_FAILED;
-    sprintf(err_msg, "failed to write header to '%s'", output_path);
-    goto RELEASE;
+    sprintf(err_msg, "failed to write output frame");
+    return MML_ERROR_FRAME_NOT_WRITTEN;
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Writes a copied video packet, through the Annex B filter when there is one.
+** The packet is consumed.
+*/
+static int
+mml_smart_cut_copy(mml_smart_cut_t* cut, AVPacket* packet)
+{
+  int ret = MML_SUCCESS;
+  
+  if (cut->bsf == NULL)
+    return mml_smart_cut_write(cut, packet);
+  if (av_bsf_send_packet(cut->bsf, packet) < 0)
+  {
+    av_packet_unref(packet);
+    sprintf(err_msg, "failed to filter copied packet");
+    return MML_ERROR_FRAME_NOT_WRITTEN;
+  }
+  while (ret == MML_SUCCESS && av_bsf_receive_packet(cut->bsf, cut->pkt) == 0)
+  {
+    ret = mml_smart_cut_write(cut, cut->pkt);
+    av_packet_unref(cut->pkt);
+  }
+  return ret;
+}
+
+/*!
+** Opens an encoder matching the input video stream for a boundary segment. No 
+** B-frames are used, and the parameter sets the encoder keeps in its global 
+** header are put back in front of its keyframes, so the segment can be 
+** stitched to the copied GOPs.
+*/
+static int
+mml_smart_cut_encoder_open(mml_smart_cut_t* cut)
+{
+  AVCodecParameters* codecpar = cut->in_stream->codecpar;
+  const AVCodec* enc = avcodec_find_encoder(codecpar->codec_id);
+  if (!enc)
+  {
+    sprintf(err_msg, "no encoder found for id: %d", codecpar->codec_id);
+    return MML_ERROR_CODEC_NOT_FOUND;
   }
   
-  int64_t prev_audio_pts = 0;
-  int64_t prev_audio_dts = 0;
-  int64_t prev_audio_dur = 0;
+  cut->enc_ctx = avcodec_alloc_context3(enc);
+  if (!cut->enc_ctx)
+  {
+    sprintf(err_msg, "no encoder codec created for id: %d", codecpar->codec_id);
+    return MML_ERROR_CODEC_NOT_CREATED;
+  }
   
-  int64_t offset_audio_pts = 0;
-  int64_t offset_audio_dts = 0;
+  cut->enc_ctx->width = cut->dec_ctx->width;
+  cut->enc_ctx->height = cut->dec_ctx->height;
+  cut->enc_ctx->pix_fmt = cut->dec_ctx->pix_fmt;
+  cut->enc_ctx->sample_aspect_ratio = cut->dec_ctx->sample_aspect_ratio;
+  cut->enc_ctx->time_base = cut->in_stream->time_base;
+  cut->enc_ctx->framerate = cut->in_stream->avg_frame_rate;
+  cut->enc_ctx->bit_rate = codecpar->bit_rate;
+  mml_codec_options(cut->enc_ctx, cut->options, NULL);
+  cut->enc_ctx->max_b_frames = 0;
+  if (cut->output_fmt_ctx->oformat->flags & AVFMT_GLOBALHEADER)
+    cut->enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
   
-  int64_t prev_video_pts = 0;
-  int64_t prev_video_dts = 0;
-  int64_t prev_video_dur = 0;
+  if (avcodec_open2(cut->enc_ctx, enc, NULL) < 0)
+  {
+    sprintf(err_msg, "failed to open encoder codec");
+    return MML_ERROR_CODEC_OPEN_FAILED;
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Encodes a frame of a boundary segment, or flushes the encoder with NULL.
+*/
+static int
+mml_smart_cut_encode(mml_smart_cut_t* cut, AVFrame* frame)
+{
+  int ret;
   
-  int64_t offset_video_pts = 0;
-  int64_t offset_video_dts = 0;
+  if (cut->enc_ctx == NULL)
+  {
+    if (frame == NULL)
+      return MML_SUCCESS;
+    if ((ret = mml_smart_cut_encoder_open(cut)) != MML_SUCCESS)
+      return ret;
+  }
   
-  packet = av_packet_alloc();
-  if (!packet) 
+  if (avcodec_send_frame(cut->enc_ctx, frame) < 0)
   {
-    ret = MML_ERROR_FRAME_NOT_CREATED;
-    sprintf(err_msg, "failed to allocate input packet");
-    goto RELEASE;
+    sprintf(err_msg, "failed to send frame to encoder");
+    return MML_ERROR_FRAME_NOT_SENT;
   }
+  while (avcodec_receive_packet(cut->enc_ctx, cut->pkt) == 0)
+  {
+    cut->pkt->dts = cut->pkt->pts - cut->delay;
+    ret = mml_packet_parameter_sets(cut->pkt, cut->enc_ctx);
+    if (ret == MML_SUCCESS)
+      ret = mml_smart_cut_write(cut, cut->pkt);
+    av_packet_unref(cut->pkt);
+    if (ret != MML_SUCCESS)
+      return ret;
+  }
+  return MML_SUCCESS;
+}
+
+/*!
+** Decodes a packet of a boundary segment, or flushes the decoder with NULL, 
+** and re-encodes the frames inside the cut range.
+*/
+static int
+mml_smart_cut_decode(mml_smart_cut_t* cut, AVPacket* packet)
+{
+  int ret = avcodec_send_packet(cut->dec_ctx, packet);
   
-  for (int i = 0; i < 2; i++) 
+  /*!
+  ** 冲刷时解码器已经结束不算错误。
+  */
+  if (ret < 0 && !(packet == NULL && ret == AVERROR_EOF))
   {
-    AVFormatContext* input_fmt_ctx = (i == 0) ? input_fmt_ctx1 : input_fmt_ctx2;
-    while (av_read_frame(input_fmt_ctx, packet) >= 0) 
+    sprintf(err_msg, "failed to send packet to decoder");
+    return MML_ERROR_PACKET_NOT_SENT;
+  }
+  ret = MML_SUCCESS;
+  while (ret == MML_SUCCESS && avcodec_receive_frame(cut->dec_ctx, cut->frame) == 0)
+  {
+    int64_t pts = cut->frame->best_effort_timestamp;
+    if (pts >= cut->start_pts && pts < cut->segment_end_pts)
     {
-      AVStream* in_stream = input_fmt_ctx->streams[packet->stream_index];
-      AVStream* out_stream = output_fmt_ctx->streams[packet->stream_index];
-      if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) 
-      {
-        mml_stream_remux(packet, 
-                         in_stream->time_base, 
-                         out_stream->time_base,
-                         output_fmt_ctx,
-                         &prev_audio_dts, 
-                         &prev_audio_pts, 
-                         &prev_audio_dur, 
-                         &offset_audio_dts, 
-                         &offset_audio_pts);
-      }
-      else if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
-      {
-        if (packet->pts > packet->dts)
-        {
-          packet->pts = packet->dts;
-        }
-        mml_stream_remux(packet, 
-                         in_stream->time_base, 
-                         out_stream->time_base,
-                         output_fmt_ctx,
-                         &prev_video_dts, 
-                         &prev_video_pts, 
-                         &prev_video_dur, 
-                         &offset_video_dts, 
-                         &offset_video_pts);
-      }
-      av_packet_unref(packet);
+      cut->frame->pts = pts;
+      cut->frame->pict_type = AV_PICTURE_TYPE_NONE;
+      ret = mml_smart_cut_encode(cut, cut->frame);
     }
+    av_frame_unref(cut->frame);
   }
-  av_write_trailer(output_fmt_ctx);
-  
-  if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) 
-    avio_closep(&output_fmt_ctx->pb);
-  
-RELEASE:
-  
-  if (dec_ctx1 != NULL)
-  	avcodec_free_context(&dec_ctx1);
-  if (dec_ctx2 != NULL)
-  	avcodec_free_context(&dec_ctx2);
-  if (enc_ctx != NULL)
-  	avcodec_free_context(&enc_ctx);
-  if (input_fmt_ctx1 != NULL)
-  	avformat_close_input(&input_fmt_ctx1);
-  if (input_fmt_ctx2 != NULL)
-  	avformat_close_input(&input_fmt_ctx2);
-  if (output_fmt_ctx != NULL)
-  	avformat_free_context(output_fmt_ctx);
-  if (frame != NULL)
-  	av_frame_free(&frame);
-  if (packet != NULL)
-  	av_packet_free(&packet);
-  
-	return ret;
+  return ret;
+}
+
+/*!
+** Drains the decoder and the encoder at the end of a boundary segment and 
+** readies the decoder for the next one.
+*/
+static int
+mml_smart_cut_finish(mml_smart_cut_t* cut)
+{
+  int ret = mml_smart_cut_decode(cut, NULL);
+  if (ret == MML_SUCCESS)
+    ret = mml_smart_cut_encode(cut, NULL);
+  if (cut->enc_ctx != NULL)
+    avcodec_free_context(&cut->enc_ctx);
+  avcodec_flush_buffers(cut->dec_ctx);
+  return ret;
 }
 
 /*
 ********************************************************************************
 **
-** mml_video_cut
+** mml_video_cut_exact
 **
 ********************************************************************************
 */
 int
-mml_video_cut(const char* original_path, 
-              double start_time,
-              double end_time,
-              const char* output_path)
+mml_video_cut_exact(const char* original_path, 
+                    double start_time,
+                    double end_time,
+                    const char* output_path)
+{
+  return mml_video_cut_exact_ex(original_path, start_time, end_time, output_path, NULL);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_cut_exact_ex
+**
+********************************************************************************
+*/
+int
+mml_video_cut_exact_ex(const char* original_path, 
+                       double start_time,
+                       double end_time,
+                       const char* output_path,
+                       const mml_options_t* options)
 {
   int                 ret                   = MML_SUCCESS;
   AVFormatContext* 		input_fmt_ctx 				= NULL;
-  AVFormatContext* 		output_fmt_ctx 				= NULL;
-  AVCodecContext* 		dec_ctx 							= NULL;
-  AVCodecContext* 		enc_ctx 							= NULL;
-  AVCodec*				 		enc			 							= NULL;
   AVPacket* 					packet                = NULL;
-  AVFrame* 						frame 								= NULL;
-  AVStream*						input_video_stream		= NULL;
-  AVStream*						output_video_stream		= NULL;
-  int									got_frame = 0;
+  int*                stream_map            = NULL;
+  int                 video_stream_index    = -1;
+  mml_smart_cut_t     cut;
   
-  ret = mml_format_open(original_path, 
-                        &input_fmt_ctx);
+  memset(&cut, 0, sizeof(cut));
+  if (options == NULL)
+    options = &options_default;
+  cut.options = options;
+  
+  ret = mml_stream_open(original_path, 
+                        AVMEDIA_TYPE_VIDEO, 
+                        options,
+                        &input_fmt_ctx, 
+                        &cut.dec_ctx,
+                        &cut.in_stream,
+                        &video_stream_index);
   if (ret != MML_SUCCESS)
     goto RELEASE;
-
-  ret = avformat_alloc_output_context2(&output_fmt_ctx, NULL, "mp4", output_path);
   
-  if (ret != MML_SUCCESS)
+  ret = avformat_alloc_output_context2(&cut.output_fmt_ctx, NULL, "mp4", output_path);
+  if (!cut.output_fmt_ctx)
+  {
+    ret = MML_ERROR_FORMAT_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate output format context for '%s'", output_path);
     goto RELEASE;
+  }
   
+  /*!
+  ** 只输出视频和音频流。
+  */
+  stream_map = (int*)malloc(sizeof(int) * input_fmt_ctx->nb_streams);
+  if (!stream_map)
+  {
+    ret = MML_ERROR_STREAM_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate stream map");
+    goto RELEASE;
+  }
   for (int j = 0; j < input_fmt_ctx->nb_streams; j++)
   {
-    AVStream* out_stream;
     AVStream* in_stream = input_fmt_ctx->streams[j];
-    AVCodecParameters *in_codecpar = in_stream->codecpar;
-
-    out_stream = avformat_new_stream(output_fmt_ctx, NULL);
+    stream_map[j] = -1;
+    if (in_stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+        in_stream->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+      continue;
+    if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && j != video_stream_index)
+      continue;
+    
+    AVStream* out_stream = avformat_new_stream(cut.output_fmt_ctx, NULL);
     if (!out_stream) 
     {
       ret = MML_ERROR_STREAM_NOT_CREATED;
       sprintf(err_msg, "failed to create stream");
       goto RELEASE;
     }
-
-    ret = avcodec_parameters_copy(out_stream->codecpar, in_codecpar);
-    out_stream->codecpar->frame_size = 5;
-    if (ret < 0) 
+    /*!
+    ** 视频流的参数取自 Annex B 过滤器的输出，复制的包和重新编码的包格式一致。
+    */
+    AVCodecParameters* codecpar = in_stream->codecpar;
+    if (j == video_stream_index)
+    {
+      if ((ret = mml_stream_annexb_open(codecpar, in_stream->time_base, &cut.bsf)) != MML_SUCCESS)
+        goto RELEASE;
+      if (cut.bsf != NULL)
+        codecpar = cut.bsf->par_out;
+    }
+    if (avcodec_parameters_copy(out_stream->codecpar, codecpar) < 0) 
     {
       ret = MML_ERROR_CODEC_NOT_COPIED;
       sprintf(err_msg, "failed to copy codec parameters");
       goto RELEASE;
     }
     out_stream->codecpar->codec_tag = 0;
+    if (j == video_stream_index)
+      mml_stream_inband_tag(out_stream->codecpar);
+    out_stream->time_base = in_stream->time_base;
+    stream_map[j] = out_stream->index;
+    if (j == video_stream_index)
+      cut.out_stream = out_stream;
   }
   
-  if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-    if (avio_open(&output_fmt_ctx->pb, output_path, AVIO_FLAG_WRITE) < 0) 
+  if (!(cut.output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+    if (mml_output_open(cut.output_fmt_ctx, output_path) != MML_SUCCESS) 
     {
       ret = MML_ERROR_FILE_OPEN_FAILED;
       sprintf(err_msg, "failed to open file '%s'", output_path);
@@ -1653,161 +4751,444 @@ mml_video_cut(const char* original_path,
     }
   }
   
-  ret = avformat_write_header(output_fmt_ctx, NULL);
-  if (ret < 0) 
+  if (mml_output_write_header(cut.output_fmt_ctx, options) < 0) 
   {
     ret = MML_ERROR_STREAM_WRITE_FAILED;
     sprintf(err_msg, "failed to write header to '%s'", output_path);
     goto RELEASE;
   }
   
-  int64_t prev_audio_pts = 0;
-  int64_t prev_audio_dts = 0;
-  int64_t prev_audio_dur = 0;
-  
-  int64_t offset_audio_pts = 0;
-  int64_t offset_audio_dts = 0;
-  
-  int64_t prev_video_pts = 0;
-  int64_t prev_video_dts = 0;
-  int64_t prev_video_dur = 0;
-  
-  int64_t offset_video_pts = 0;
-  int64_t offset_video_dts = 0;
-  
-  
   packet = av_packet_alloc();
-  if (!packet) 
+  cut.pkt = av_packet_alloc();
+  cut.frame = av_frame_alloc();
+  if (!packet || !cut.pkt || !cut.frame) 
   {
-    ret = MML_ERROR_FRAME_NOT_CREATED;
-    sprintf(err_msg, "failed to allocate input packet");
+    ret = MML_ERROR_PACKET_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate packet");
     goto RELEASE;
   }
   
-  int start = 0;
-  int stop = 0;
-  int keyframe = 0;
-  int64_t start_audio_pts = -1;
-  int64_t start_video_pts = -1;
-  while (av_read_frame(input_fmt_ctx, packet) >= 0) 
+  AVRational video_tb = cut.in_stream->time_base;
+  cut.start_pts = av_rescale_q((int64_t)(start_time * AV_TIME_BASE), AV_TIME_BASE_Q, video_tb);
+  cut.end_pts = av_rescale_q((int64_t)(end_time * AV_TIME_BASE), AV_TIME_BASE_Q, video_tb);
+  
+  /*!
+  ** 第一遍只读视频包（不解码），找出起始时间之后的第一个关键帧（k1）和
+  ** 结束时间之前的最后一个关键帧（k2），[k1, k2)之间的GOP直接复制。
+  */
+  int64_t k1 = AV_NOPTS_VALUE;
+  int64_t k2 = AV_NOPTS_VALUE;
+  int64_t gop_pts = AV_NOPTS_VALUE;
+  int open_gop = 0;
+  int delay_found = 0;
+  for (int j = 0; j < input_fmt_ctx->nb_streams; j++)
+    input_fmt_ctx->streams[j]->discard = (j == video_stream_index) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+  mml_stream_seek(input_fmt_ctx, video_stream_index, start_time);
+  while (av_read_frame(input_fmt_ctx, packet) >= 0)
   {
-    AVStream* in_stream = input_fmt_ctx->streams[packet->stream_index];
-    AVStream* out_stream = output_fmt_ctx->streams[packet->stream_index];
-    double duration_seconds = packet->pts * av_q2d(in_stream->time_base);
-
+    int keyframe = (packet->flags & AV_PKT_FLAG_KEY) && packet->stream_index == video_stream_index;
+    int64_t pts = packet->pts;
+    if (keyframe && !delay_found && packet->dts != AV_NOPTS_VALUE)
+    {
+      cut.delay = packet->pts - packet->dts;
+      delay_found = 1;
+    }
     /*!
-    ** 音频，可以粗略地用时间判断起始。
+    ** 解码顺序在关键帧之后、显示时间却在它之前的帧是开放GOP的前导帧。
     */
-    if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && duration_seconds < start_time) 
+    if (packet->stream_index == video_stream_index && !keyframe && 
+        pts != AV_NOPTS_VALUE && gop_pts != AV_NOPTS_VALUE && pts < gop_pts)
+      open_gop = 1;
+    if (keyframe)
+      gop_pts = pts;
+    av_packet_unref(packet);
+    if (!keyframe || pts < cut.start_pts)
+      continue;
+    if (pts > cut.end_pts)
+      break;
+    if (k1 == AV_NOPTS_VALUE)
+      k1 = pts;
+    k2 = pts;
+  }
+  for (int j = 0; j < input_fmt_ctx->nb_streams; j++)
+    input_fmt_ctx->streams[j]->discard = AVDISCARD_DEFAULT;
+  /*!
+  ** 开放GOP的前导帧参考上一个GOP，复制的GOP和重新编码的GOP接不上，
+  ** 这时整段重新编码。
+  */
+  if (open_gop)
+  {
+    k1 = AV_NOPTS_VALUE;
+    k2 = AV_NOPTS_VALUE;
+  }
+  
+  /*!
+  ** 第二遍：头部不完整的GOP重新编码，中间完整的GOP复制，尾部不完整的GOP重新编码。
+  */
+  enum { HEAD, COPY, TAIL, DONE } phase = HEAD;
+  cut.segment_end_pts = (k1 != AV_NOPTS_VALUE) ? k1 : cut.end_pts;
+  
+  mml_stream_seek(input_fmt_ctx, video_stream_index, start_time);
+  while (ret == MML_SUCCESS && av_read_frame(input_fmt_ctx, packet) >= 0) 
+  {
+    AVStream* in_stream = input_fmt_ctx->streams[packet->stream_index];
+    int out_index = stream_map[packet->stream_index];
+    
+    if (out_index == -1)
     {
-      // 音频未开始
-			av_packet_unref(packet);
+      av_packet_unref(packet);
       continue;
     }
     
-    /*!
-    ** 关键帧标识位
-    */
-    if (packet->flags & AV_PKT_FLAG_KEY) 
-      keyframe = 1;
-    else 
-      keyframe = 0;
-    /*!
-    ** 视频，只允许关键帧作为起始帧。
-    */
-    if ((start_time - duration_seconds) < 0.05 && keyframe)
+    if (packet->stream_index != video_stream_index)
     {
-      start = 1;
+      AVStream* out_stream = cut.output_fmt_ctx->streams[out_index];
+      int64_t start_pts = av_rescale_q(cut.start_pts, video_tb, in_stream->time_base);
+      int64_t end_pts = av_rescale_q(cut.end_pts, video_tb, in_stream->time_base);
+      if (packet->pts >= end_pts && phase == DONE)
+      {
+        av_packet_unref(packet);
+        break;
+      }
+      if (packet->pts >= start_pts && packet->pts < end_pts)
+      {
+        packet->pts -= start_pts;
+        packet->dts -= start_pts;
+        av_packet_rescale_ts(packet, in_stream->time_base, out_stream->time_base);
+        packet->stream_index = out_index;
+        packet->pos = -1;
+        av_interleaved_write_frame(cut.output_fmt_ctx, packet);
+      }
+      av_packet_unref(packet);
+      continue;
     }
-    if (!start && in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+    
+    int keyframe = packet->flags & AV_PKT_FLAG_KEY;
+    if (phase == HEAD && keyframe && packet->pts == k1)
     {
-			av_packet_unref(packet);
-      continue;
+      ret = mml_smart_cut_finish(&cut);
+      if (k1 == k2)
+        phase = (k2 >= cut.end_pts) ? DONE : TAIL;
+      else
+        phase = COPY;
+      cut.segment_end_pts = cut.end_pts;
     }
-    /*!
-    ** 视频，必须用关键帧结束。
-    */
-    if (duration_seconds - end_time >= 0.05 && keyframe)
-      stop = 1;
-    av_packet_rescale_ts(packet, in_stream->time_base, out_stream->time_base);
-    packet->pos = -1;
-    if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) 
+    else if (phase == COPY && keyframe && packet->pts == k2)
     {
-      if (start_audio_pts == -1) 
-        start_audio_pts = packet->pts;
-      packet->pts -= start_audio_pts;
-      packet->dts -= start_audio_pts;
-      mml_stream_remux(packet,
-                       in_stream->time_base, 
-                       out_stream->time_base,
-                       output_fmt_ctx,
-                       &prev_audio_dts, 
-                       &prev_audio_pts, 
-                       &prev_audio_dur, 
-                       &offset_audio_dts, 
-                       &offset_audio_pts);
+      phase = (k2 >= cut.end_pts) ? DONE : TAIL;
     }
-    else if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+    else if (phase != DONE && phase != COPY && keyframe && packet->pts > cut.end_pts)
     {
-      if (start_video_pts == -1) 
-        start_video_pts = packet->pts;
-      packet->pts -= start_video_pts;
-      packet->dts -= start_video_pts;
-      av_interleaved_write_frame(output_fmt_ctx, packet);
+      ret = mml_smart_cut_finish(&cut);
+      phase = DONE;
     }
+    
+    if (ret == MML_SUCCESS && (phase == HEAD || phase == TAIL))
+      ret = mml_smart_cut_decode(&cut, packet);
+    else if (ret == MML_SUCCESS && phase == COPY)
+      ret = mml_smart_cut_copy(&cut, packet);
     av_packet_unref(packet);
-    /*!
-    ** 结束处理
-    */
-    if (stop)
+    
+    if (phase == DONE && cut.output_fmt_ctx->nb_streams == 1)
       break;
   }
-  av_write_trailer(output_fmt_ctx);
+  if (ret == MML_SUCCESS && (phase == HEAD || phase == TAIL))
+    ret = mml_smart_cut_finish(&cut);
   
-  if (!(output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) 
-    avio_closep(&output_fmt_ctx->pb);
+  av_write_trailer(cut.output_fmt_ctx);
+  
+  if (!(cut.output_fmt_ctx->oformat->flags & AVFMT_NOFILE)) 
+    mml_output_close(cut.output_fmt_ctx);
   
 RELEASE:
   
-  if (dec_ctx != NULL)
-  	avcodec_free_context(&dec_ctx);
-  if (enc_ctx != NULL)
-  	avcodec_free_context(&enc_ctx);
+  if (cut.dec_ctx != NULL)
+  	avcodec_free_context(&cut.dec_ctx);
+  if (cut.enc_ctx != NULL)
+  	avcodec_free_context(&cut.enc_ctx);
+  if (cut.bsf != NULL)
+    av_bsf_free(&cut.bsf);
   if (input_fmt_ctx != NULL)
-  	avformat_close_input(&input_fmt_ctx);
-  if (output_fmt_ctx != NULL)
-  	avformat_free_context(output_fmt_ctx);
-  if (frame != NULL)
-  	av_frame_free(&frame);
+  	mml_format_close(&input_fmt_ctx);
+  if (cut.output_fmt_ctx != NULL)
+  	avformat_free_context(cut.output_fmt_ctx);
+  if (cut.frame != NULL)
+  	av_frame_free(&cut.frame);
+  if (cut.pkt != NULL)
+  	av_packet_free(&cut.pkt);
   if (packet != NULL)
   	av_packet_free(&packet);
+  if (stream_map != NULL)
+    free(stream_map);
   
 	return ret;
 }
 
 /*!
+** A decoded frame travelling through the image export pipeline. The slot is 
+** reused once its image is written, so the number of slots bounds the memory.
+*/
+typedef struct mml_image_slot_s
+{
+  AVFrame*                  frame;
+  AVPacket*                 pkt;
+  int                       seq;
+  int                       index;
+  int                       ret;
+} mml_image_slot_t;
+
+/*!
+** The image export pipeline: the calling thread demuxes and decodes, the 
+** workers convert and compress, and the writer finishes files in index order.
+*/
+typedef struct mml_image_pipeline_s
+{
+  mml_queue_t               free_slots;
+  mml_queue_t               frames;
+  mml_queue_t               images;
+  mml_image_slot_t*         slots;
+  int                       nb_slots;
+  pthread_t*                workers;
+  int                       nb_workers;
+  int                       nb_started;
+  pthread_t                 writer;
+  int                       writer_started;
+  const char*               output_path;
+  int                       seq;
+  int                       ret;
+  char                      err[4096];
+} mml_image_pipeline_t;
+
+static void*
+mml_image_pipeline_work(void* arg)
+{
+  mml_image_pipeline_t* pipeline = (mml_image_pipeline_t*)arg;
+  mml_encoder_p encoder = NULL;
+  mml_image_slot_t* slot;
+  int ret;
+  
+  ret = mml_encoder_init(&encoder, AV_CODEC_ID_PNG);
+  
+  while (mml_queue_pop(&pipeline->frames, (void**)&slot) == MML_SUCCESS)
+  {
+    if (ret == MML_SUCCESS)
+      slot->ret = mml_frame_encode_image(encoder, slot->frame, slot->pkt);
+    else
+      slot->ret = ret;
+    av_frame_unref(slot->frame);
+    mml_queue_push(&pipeline->images, slot);
+  }
+  
+  mml_encoder_free(encoder);
+  return NULL;
+}
+
+static void*
+mml_image_pipeline_write(void* arg)
+{
+  mml_image_pipeline_t* pipeline = (mml_image_pipeline_t*)arg;
+  mml_image_slot_t** pending;
+  mml_image_slot_t* slot;
+  int next = 0;
+  int ret = MML_SUCCESS;
+  
+  /*!
+  ** 最多有nb_slots个槽位在途，序号取模即可定位。
+  */
+  pending = (mml_image_slot_t**)calloc(pipeline->nb_slots, sizeof(mml_image_slot_t*));
+  if (!pending)
+  {
+    ret = MML_ERROR_THREAD_NOT_CREATED;
+    sprintf(err_msg, "failed to allocate the image reorder buffer");
+    goto RELEASE;
+  }
+  
+  while (mml_queue_pop(&pipeline->images, (void**)&slot) == MML_SUCCESS)
+  {
+    pending[slot->seq % pipeline->nb_slots] = slot;
+    while ((slot = pending[next % pipeline->nb_slots]) != NULL && slot->seq == next)
+    {
+      pending[next % pipeline->nb_slots] = NULL;
+      if (slot->ret == MML_SUCCESS && 
+          __atomic_load_n(&pipeline->ret, __ATOMIC_ACQUIRE) == MML_SUCCESS)
+      {
+        char filepath[4096];
+        snprintf(filepath, sizeof(filepath), "%s/%08d.png", pipeline->output_path, slot->index);
+        FILE* f = fopen(filepath, "wb");
+        if (f)
+        {
+          fwrite(slot->pkt->data, 1, slot->pkt->size, f);
+          fclose(f);
+        }
+        else
+        {
+          snprintf(pipeline->err, sizeof(pipeline->err), "failed to save image '%s'", filepath);
+          __atomic_store_n(&pipeline->ret, MML_ERROR_FILE_OPEN_FAILED, __ATOMIC_RELEASE);
+        }
+      }
+      else if (slot->ret != MML_SUCCESS && 
+               __atomic_load_n(&pipeline->ret, __ATOMIC_ACQUIRE) == MML_SUCCESS)
+      {
+        snprintf(pipeline->err, sizeof(pipeline->err), "failed to convert image %d", slot->index);
+        __atomic_store_n(&pipeline->ret, slot->ret, __ATOMIC_RELEASE);
+      }
+      av_packet_unref(slot->pkt);
+      mml_queue_push(&pipeline->free_slots, slot);
+      next++;
+    }
+  }
+  
+RELEASE:
+  /*!
+  ** 出错后仍要把槽位还回去，否则提交方会一直等空槽。
+  */
+  if (ret != MML_SUCCESS)
+  {
+    snprintf(pipeline->err, sizeof(pipeline->err), "%s", err_msg);
+    __atomic_store_n(&pipeline->ret, ret, __ATOMIC_RELEASE);
+    while (mml_queue_pop(&pipeline->images, (void**)&slot) == MML_SUCCESS)
+    {
+      av_packet_unref(slot->pkt);
+      mml_queue_push(&pipeline->free_slots, slot);
+    }
+  }
+  free(pending);
+  return NULL;
+}
+
+/*!
+** Waits until every submitted image is written and releases the pipeline.
 **
+** @return success or the first error of the workers and the writer
 */
-int
-mml_video_save_images(const char* original_path, 
-                      double start_time, 
-                      double end_time, 
-                      const char* output_path,
-                      int image_index)
+static int
+mml_image_pipeline_free(mml_image_pipeline_t* pipeline)
+{
+  int ret;
+  
+  mml_queue_close(&pipeline->frames);
+  for (int i = 0; i < pipeline->nb_started; i++)
+    mml_thread_join(pipeline->workers[i]);
+  mml_queue_close(&pipeline->images);
+  if (pipeline->writer_started)
+    mml_thread_join(pipeline->writer);
+  
+  for (int i = 0; pipeline->slots != NULL && i < pipeline->nb_slots; i++)
+  {
+    av_frame_free(&pipeline->slots[i].frame);
+    av_packet_free(&pipeline->slots[i].pkt);
+  }
+  mml_queue_free(&pipeline->free_slots);
+  mml_queue_free(&pipeline->frames);
+  mml_queue_free(&pipeline->images);
+  free(pipeline->slots);
+  free(pipeline->workers);
+  
+  ret = pipeline->ret;
+  if (ret != MML_SUCCESS)
+    sprintf(err_msg, "%s", pipeline->err);
+  free(pipeline);
+  return ret;
+}
+
+static int
+mml_image_pipeline_init(mml_image_pipeline_t** pipeline, 
+                        const char* output_path, 
+                        int threads)
+{
+  mml_image_pipeline_t* p;
+  
+  p = (mml_image_pipeline_t*)calloc(1, sizeof(mml_image_pipeline_t));
+  if (!p)
+    return MML_ERROR_THREAD_NOT_CREATED;
+  *pipeline = p;
+  
+  p->output_path = output_path;
+  p->nb_workers = threads;
+  p->nb_slots = threads * 2;
+  p->slots = (mml_image_slot_t*)calloc(p->nb_slots, sizeof(mml_image_slot_t));
+  p->workers = (pthread_t*)calloc(p->nb_workers, sizeof(pthread_t));
+  if (!p->slots || !p->workers ||
+      mml_queue_init(&p->free_slots, p->nb_slots) != MML_SUCCESS ||
+      mml_queue_init(&p->frames, p->nb_slots) != MML_SUCCESS ||
+      mml_queue_init(&p->images, p->nb_slots) != MML_SUCCESS)
+    return MML_ERROR_THREAD_NOT_CREATED;
+  
+  for (int i = 0; i < p->nb_slots; i++)
+  {
+    p->slots[i].frame = av_frame_alloc();
+    p->slots[i].pkt = av_packet_alloc();
+    if (!p->slots[i].frame || !p->slots[i].pkt)
+      return MML_ERROR_FRAME_NOT_CREATED;
+    mml_queue_push(&p->free_slots, &p->slots[i]);
+  }
+  
+  for (; p->nb_started < p->nb_workers; p->nb_started++)
+  {
+    if (mml_thread_create(&p->workers[p->nb_started], mml_image_pipeline_work, p) != 0)
+      return MML_ERROR_THREAD_NOT_CREATED;
+  }
+  if (mml_thread_create(&p->writer, mml_image_pipeline_write, p) != 0)
+    return MML_ERROR_THREAD_NOT_CREATED;
+  p->writer_started = 1;
+  
+  return MML_SUCCESS;
+}
+
+/*!
+** Hands a decoded frame over to the workers, blocking while all slots are in 
+** use. The frame is left empty.
+*/
+static int
+mml_image_pipeline_submit(mml_image_pipeline_t* pipeline, 
+                          AVFrame* frame, 
+                          int image_index)
+{
+  mml_image_slot_t* slot;
+  
+  int ret = __atomic_load_n(&pipeline->ret, __ATOMIC_ACQUIRE);
+  if (ret != MML_SUCCESS)
+    return ret;
+  if (mml_queue_pop(&pipeline->free_slots, (void**)&slot) != MML_SUCCESS)
+    return MML_ERROR_THREAD_NOT_CREATED;
+  av_frame_move_ref(slot->frame, frame);
+  slot->seq = pipeline->seq++;
+  slot->index = image_index;
+  slot->ret = MML_SUCCESS;
+  mml_queue_push(&pipeline->frames, slot);
+  return MML_SUCCESS;
+}
+
+/*!
+** Exports the frames of a video segment as images, on the calling thread when 
+** threads is 1 and through the image pipeline otherwise.
+**
+** In keyframe mode the input is positioned by seeking to the keyframe at or 
+** before start_time, the other streams are not demuxed and inter frames are 
+** never decoded, so the cost follows the length of the segment instead of its 
+** position in the file.
+*/
+static int
+mml_images_export(const char* original_path, 
+                  double start_time, 
+                  double end_time, 
+                  const char* output_path,
+                  int image_index,
+                  int threads,
+                  int keyframes)
 {
   int                 ret                   = MML_SUCCESS;
   AVFormatContext* 		input_fmt_ctx 				= NULL;
   AVCodecContext* 		dec_ctx 							= NULL;
-  AVCodecContext* 		enc_ctx 							= NULL;
-  AVCodec*				 		enc			 							= NULL;
   AVPacket* 					packet                = NULL;
   AVFrame* 						frame 								= NULL;
-  AVFrame* 						rgb_frame 						= NULL;
-  AVStream*						input_video_stream		= NULL;
-  AVStream*						output_video_stream		= NULL;
-  int									got_frame             = 0;
+  mml_encoder_p       encoder               = NULL;
+  mml_image_pipeline_t* pipeline            = NULL;
   
-  ret = mml_format_open(original_path, &input_fmt_ctx);
+  /*!
+  ** 关键帧模式跳过帧间数据，读取位置是跳跃的。
+  */
+  ret = mml_format_open(original_path, &input_fmt_ctx, keyframes ? MML_IO_RANDOM : MML_IO_SEQUENTIAL);
   if (ret != MML_SUCCESS)
     goto RELEASE;
   
@@ -1818,32 +5199,53 @@ mml_video_save_images(const char* original_path,
       break;
     }
   }
+  if (video_stream_index == -1)
+  {
+    ret = MML_ERROR_STREAM_NOT_FOUND;
+    sprintf(err_msg, "no video stream found for '%s'", original_path);
+    goto RELEASE;
+  }
   
   AVCodecParameters *codecpar = input_fmt_ctx->streams[video_stream_index]->codecpar;
   const AVCodec *decoder = avcodec_find_decoder(codecpar->codec_id);
   
-  dec_ctx = avcodec_alloc_context3(decoder);
-  avcodec_parameters_to_context(dec_ctx, input_fmt_ctx->streams[video_stream_index]->codecpar);
-  avcodec_open2(dec_ctx, decoder, NULL);
-  
-  int64_t prev_audio_pts = 0;
-  int64_t prev_audio_dts = 0;
-  int64_t prev_audio_dur = 0;
-  
-  int64_t offset_audio_pts = 0;
-  int64_t offset_audio_dts = 0;
-  
-  int64_t prev_video_pts = 0;
-  int64_t prev_video_dts = 0;
-  int64_t prev_video_dur = 0;
-  
-  int64_t offset_video_pts = 0;
-  int64_t offset_video_dts = 0;
+  if (decoder == NULL ||
+      (dec_ctx = avcodec_alloc_context3(decoder)) == NULL ||
+      avcodec_parameters_to_context(dec_ctx, codecpar) < 0)
+  {
+    ret = MML_ERROR_CODEC_OPEN_FAILED;
+    sprintf(err_msg, "failed to open decoder codec for '%s'", original_path);
+    goto RELEASE;
+  }
+  if (keyframes)
+  {
+    /*!
+    ** 只解码关键帧，其余流不再读取。
+    */
+    dec_ctx->skip_frame = AVDISCARD_NONKEY;
+    for (unsigned int i = 0; i < input_fmt_ctx->nb_streams; i++) 
+    {
+      if (i != video_stream_index)
+        input_fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+  if (avcodec_open2(dec_ctx, decoder, NULL) < 0)
+  {
+    ret = MML_ERROR_CODEC_OPEN_FAILED;
+    sprintf(err_msg, "failed to open decoder codec for '%s'", original_path);
+    goto RELEASE;
+  }
   
+  if (keyframes && start_time > 0)
+  {
+    /*!
+    ** 定位到起始时间之前（含）的关键帧。
+    */
+    mml_stream_seek(input_fmt_ctx, video_stream_index, start_time);
+  }
   
   packet = av_packet_alloc();
   frame = av_frame_alloc();
-  rgb_frame = av_frame_alloc();
   
   if (!packet) 
   {
@@ -1852,13 +5254,22 @@ mml_video_save_images(const char* original_path,
     goto RELEASE;
   }
 
-  mml_encoder_p encoder;
-  mml_encoder_init(&encoder, AV_CODEC_ID_PNG);
+  /*!
+  ** 图片编码器、缩放器和RGB帧在整个导出过程中复用。
+  */
+  if (threads == 1)
+    ret = mml_encoder_init(&encoder, AV_CODEC_ID_PNG);
+  else
+    ret = mml_image_pipeline_init(&pipeline, output_path, threads);
+  if (ret != MML_SUCCESS)
+  {
+    sprintf(err_msg, "failed to create image encoder");
+    goto RELEASE;
+  }
 
   int start = 0;
   int stop = 0;
   int keyframe = 0;
-  int64_t start_audio_pts = -1;
   int64_t start_video_pts = -1;
   while (av_read_frame(input_fmt_ctx, packet) >= 0) 
   {
@@ -1894,11 +5305,24 @@ mml_video_save_images(const char* original_path,
       av_packet_unref(packet);
       continue;
     }
+    if (keyframes && !keyframe)
+    {
+      av_packet_unref(packet);
+      continue;
+    }
     /*!
     ** 视频，必须用关键帧结束。
     */
     if (duration_seconds - end_time >= 0.05 && keyframe)
       stop = 1;
+    /*!
+    ** 关键帧模式下结束的关键帧已在时间段之外，不再解码。
+    */
+    if (keyframes && stop)
+    {
+      av_packet_unref(packet);
+      break;
+    }
     packet->pos = -1;
     if (in_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
     {
@@ -1907,15 +5331,34 @@ mml_video_save_images(const char* original_path,
       packet->pts -= start_video_pts;
       packet->dts -= start_video_pts;
       // 在包中只导出一帧
-      ret = avcodec_send_packet(dec_ctx, packet);
-      if (ret < 0) break;
+      if (avcodec_send_packet(dec_ctx, packet) < 0)
+      {
+        ret = MML_ERROR_PACKET_NOT_SENT;
+        sprintf(err_msg, "failed to send packet to decoder for '%s'", original_path);
+        av_packet_unref(packet);
+        break;
+      }
       if (avcodec_receive_frame(dec_ctx, frame) >= 0) 
       {
-        char filepath[4096];
-        sprintf(filepath, "%s/%08d.png", output_path, image_index);
-        mml_frame_save_image(encoder, frame, rgb_frame, filepath);
+        if (pipeline != NULL)
+        {
+          ret = mml_image_pipeline_submit(pipeline, frame, image_index);
+        }
+        else
+        {
+          char filepath[4096];
+          sprintf(filepath, "%s/%08d.png", output_path, image_index);
+          ret = mml_frame_save_image(encoder, frame, filepath);
+          if (ret != MML_SUCCESS)
+            sprintf(err_msg, "failed to save image '%s'", filepath);
+        }
         image_index++;
         av_frame_unref(frame);
+        if (ret != MML_SUCCESS)
+        {
+          av_packet_unref(packet);
+          break;
+        }
       }
     }
     av_packet_unref(packet);
@@ -1926,22 +5369,138 @@ mml_video_save_images(const char* original_path,
       break;
   }
   
+  /*!
+  ** 关键帧模式下，取出解码器中缓存的最后几帧。
+  */
+  if (keyframes && ret == MML_SUCCESS && avcodec_send_packet(dec_ctx, NULL) >= 0)
+  {
+    AVRational time_base = input_fmt_ctx->streams[video_stream_index]->time_base;
+    while (avcodec_receive_frame(dec_ctx, frame) >= 0)
+    {
+      /*!
+      ** 缓存的帧同样按结束时间截止，与读包时的判断一致。
+      */
+      double frame_seconds = (frame->best_effort_timestamp + start_video_pts) * av_q2d(time_base);
+      if (frame_seconds - end_time >= 0.05)
+      {
+        av_frame_unref(frame);
+        continue;
+      }
+      if (pipeline != NULL)
+      {
+        ret = mml_image_pipeline_submit(pipeline, frame, image_index);
+      }
+      else
+      {
+        char filepath[4096];
+        sprintf(filepath, "%s/%08d.png", output_path, image_index);
+        ret = mml_frame_save_image(encoder, frame, filepath);
+        if (ret != MML_SUCCESS)
+          sprintf(err_msg, "failed to save image '%s'", filepath);
+      }
+      image_index++;
+      av_frame_unref(frame);
+      if (ret != MML_SUCCESS)
+        break;
+    }
+  }
+  
 RELEASE:
   
   if (dec_ctx != NULL)
     avcodec_free_context(&dec_ctx);
-  if (enc_ctx != NULL)
-    avcodec_free_context(&enc_ctx);
   if (input_fmt_ctx != NULL)
-    avformat_close_input(&input_fmt_ctx);
+    mml_format_close(&input_fmt_ctx);
   if (frame != NULL)
     av_frame_free(&frame);
-  if (rgb_frame != NULL)
-    av_frame_free(&rgb_frame);
   if (packet != NULL)
     av_packet_free(&packet);
   
   if (encoder != NULL)
     mml_encoder_free(encoder);
+  if (pipeline != NULL)
+  {
+    /*!
+    ** 等待所有图片写完，再取流水线中的错误。
+    */
+    int pipeline_ret = mml_image_pipeline_free(pipeline);
+    if (ret == MML_SUCCESS)
+      ret = pipeline_ret;
+  }
   return ret;
-}
\ No newline at end of file
+}
+
+/*
+********************************************************************************
+**
+** mml_video_save_images
+**
+********************************************************************************
+*/
+int
+mml_video_save_images(const char* original_path, 
+                      double start_time, 
+                      double end_time, 
+                      const char* output_path,
+                      int image_index)
+{
+  return mml_images_export(original_path, 
+                           start_time, 
+                           end_time, 
+                           output_path, 
+                           image_index, 
+                           1,
+                           0);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_save_images_parallel
+**
+********************************************************************************
+*/
+int
+mml_video_save_images_parallel(const char* original_path, 
+                               double start_time, 
+                               double end_time, 
+                               const char* output_path,
+                               int image_index,
+                               int threads)
+{
+  if (threads <= 0)
+    threads = av_cpu_count();
+  return mml_images_export(original_path, 
+                           start_time, 
+                           end_time, 
+                           output_path, 
+                           image_index, 
+                           threads,
+                           0);
+}
+
+/*
+********************************************************************************
+**
+** mml_video_save_keyframes
+**
+********************************************************************************
+*/
+int
+mml_video_save_keyframes(const char* original_path, 
+                         double start_time, 
+                         double end_time, 
+                         const char* output_path,
+                         int image_index,
+                         int threads)
+{
+  if (threads <= 0)
+    threads = av_cpu_count();
+  return mml_images_export(original_path, 
+                           start_time, 
+                           end_time, 
+                           output_path, 
+                           image_index, 
+                           threads,
+                           1);
+}
@@ -9,6 +9,9 @@
 #ifndef __LIBMML_H__
 #define __LIBMML_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" 
 {
@@ -35,6 +38,7 @@ extern "C"
 #define MML_ERROR_STREAM_WRITE_FAILED           600407
 
 #define MML_ERROR_PACKET_NOT_CREATED            700405
+#define MML_ERROR_PACKET_NOT_SENT               700408
 
 #define MML_ERROR_FRAME_NOT_CREATED             710405
 #define MML_ERROR_FRAME_NOT_SENT                710408
@@ -42,14 +46,241 @@ extern "C"
   
 #define MML_ERROR_FORMAT_NOT_CREATED            720405  
 
+#define MML_ERROR_THREAD_NOT_CREATED            730405
+
+#define MML_ERROR_CACHE_NOT_CREATED             740405
+
+#define MML_ERROR_CONTEXT_NOT_CREATED           750405
+
+#define MML_MEDIA_TYPE_UNKNOWN                  0
+#define MML_MEDIA_TYPE_VIDEO                    1
+#define MML_MEDIA_TYPE_AUDIO                    2
+#define MML_MEDIA_TYPE_SUBTITLE                 3
+#define MML_MEDIA_TYPE_DATA                     4
+
+#define MML_MEDIA_MAX_STREAMS                   16
+
+#define MML_THREADS_AUTO                        0
+#define MML_THREAD_FRAME                        1
+#define MML_THREAD_SLICE                        2
+
+#define MML_SAMPLE_S16                          1
+#define MML_SAMPLE_FLT                          2
+
+#define MML_IO_SIZE                             0x10000
+
+#define MML_IO_NORMAL                           0
+#define MML_IO_SEQUENTIAL                       1
+#define MML_IO_RANDOM                           2
+
 struct mml_encoder_s;
 struct mml_decoder_s;
 
+/*!
+** A range of a multi-range cut.
+*/
+typedef struct mml_cut_range_s
+{
+  double                start_time;
+  double                end_time;
+  const char*           output_path;
+} mml_cut_range_t;
+
+/*!
+** An encoding profile trading speed for quality and size. A positive crf 
+** selects constant quality, bit_rate is used otherwise. The preset, the tune, 
+** the crf and the lookahead are x264 settings, NULL and -1 keep the encoder 
+** defaults, as do a gop_size of 0 and max_b_frames of -1. A threads count of 
+** MML_THREADS_AUTO keeps the encoder threads of the options.
+*/
+typedef struct mml_profile_s
+{
+  const char*           preset;
+  const char*           tune;
+  int                   crf;
+  int64_t               bit_rate;
+  int                   gop_size;
+  int                   max_b_frames;
+  int                   lookahead;
+  int                   threads;
+} mml_profile_t;
+
+/*!
+** The fastest profile, for previews.
+*/
+extern const mml_profile_t mml_profile_proxy;
+
+/*!
+** The profile used when none is given, 400 kbps with the encoder defaults.
+*/
+extern const mml_profile_t mml_profile_default;
+
+/*!
+** The slowest profile, for masters.
+*/
+extern const mml_profile_t mml_profile_archive;
+
+/*!
+** The options of a transcoding call. A thread count of MML_THREADS_AUTO uses 
+** the number of cores and a thread type of 0 allows both frame and slice 
+** threading. With pipeline set, decoding, scaling and encoding run on their 
+** own threads. The profile is NULL for the default of each call. The pad 
+** color is a 0xRRGGBB value, black by default. With fragmented set, MP4 
+** outputs are written as fragmented MP4, playable while they are written and 
+** writable to an io that cannot seek.
+*/
+typedef struct mml_options_s
+{
+  int                   decoder_threads;
+  int                   decoder_thread_type;
+  int                   encoder_threads;
+  int                   encoder_thread_type;
+  int                   pipeline;
+  const mml_profile_t*  profile;
+  uint32_t              pad_color;
+  int                   fragmented;
+} mml_options_t;
+
+/*!
+** The information of a stream in a media file. The fields not applying to the 
+** stream type are 0.
+*/
+typedef struct mml_stream_info_s
+{
+  int                   type;
+  char                  codec[32];
+  int                   width;
+  int                   height;
+  double                frame_rate;
+  int                   sample_rate;
+  int                   channels;
+  int64_t               bit_rate;
+  int64_t               nb_frames;
+} mml_stream_info_t;
+
+/*!
+** The information of a media file, at most MML_MEDIA_MAX_STREAMS streams are 
+** listed in nb_streams; nb_streams_total is the number of streams the file 
+** really has, so the list was cut short when it is greater.
+*/
+typedef struct mml_media_info_s
+{
+  double                duration;
+  int64_t               bit_rate;
+  int                   nb_streams;
+  int                   nb_streams_total;
+  mml_stream_info_t     streams[MML_MEDIA_MAX_STREAMS];
+} mml_media_info_t;
+
+/*!
+** A file of a batch probe, the path is set by the caller and the rest is 
+** filled by mml_media_info_batch.
+*/
+typedef struct mml_media_probe_s
+{
+  const char*           path;
+  int                   status;
+  char                  error[256];
+  mml_media_info_t      info;
+} mml_media_probe_t;
+
+/*!
+** A rendition of a ladder, one output file of the given size. The profile is 
+** NULL for the one of the options. A positive bit rate is the maximum bit rate 
+** of the rendition, enforced with a VBV buffer of two seconds: with a constant 
+** quality profile the quality is kept below that cap (capped CRF), otherwise 
+** it is also the average bit rate aimed at.
+*/
+typedef struct mml_rendition_s
+{
+  const char*           output_path;
+  int                   width;
+  int                   height;
+  int64_t               bit_rate;
+  const mml_profile_t*  profile;
+} mml_rendition_t;
+
+/*!
+** The PCM delivered by mml_audio_pcm: interleaved MML_SAMPLE_S16 or 
+** MML_SAMPLE_FLT samples at the given rate and channel count, in chunks of 
+** chunk_samples samples per channel.
+*/
+typedef struct mml_pcm_format_s
+{
+  int                   sample_rate;
+  int                   channels;
+  int                   sample_format;
+  int                   chunk_samples;
+} mml_pcm_format_t;
+
+/*!
+** Receives a chunk of PCM. The samples are only valid during the call, the 
+** buffer is reused for the next chunk.
+**
+** @param opaque
+**        the opaque pointer given to mml_audio_pcm
+**
+** @param samples
+**        the interleaved samples
+**
+** @param nb_samples
+**        the number of samples per channel, chunk_samples except for the last 
+**        chunk
+**
+** @param time
+**        the time of the first sample in seconds from the start of the audio
+**
+** @return MML_SUCCESS to go on, anything else stops the extraction and is 
+**         returned by mml_audio_pcm
+*/
+typedef int (*mml_pcm_callback_t)(void* opaque, const void* samples, int nb_samples, double time);
+
+/*!
+** A source or destination of bytes standing in for a file. Any path argument 
+** accepts mml_io_path(io) instead of a file path, the io has to stay alive 
+** until the call returns and be released with mml_io_free afterwards.
+**
+** Memory ios can be read by several calls at once, each reading from its own 
+** position. Other ios, and ios being written, are opened by one call at a 
+** time, a second open fails until the first is closed.
+**
+** The callbacks get the opaque pointer. read returns the number of bytes read, 
+** 0 at the end and a negative value on error, write returns the number of 
+** bytes written, and seek takes SEEK_SET, SEEK_CUR, SEEK_END or MML_IO_SIZE to 
+** get the total size, and returns the new position or a negative value. read 
+** is NULL for write-only ios and write for read-only ones, without seek the io 
+** is read or written once from start to end, which MP4 outputs do not support.
+**
+** name is a file name hint, its extension guesses the format of outputs.
+*/
+typedef struct mml_io_s
+{
+  int                   (*read)(void* opaque, uint8_t* buf, int size);
+  int                   (*write)(void* opaque, const uint8_t* buf, int size);
+  int64_t               (*seek)(void* opaque, int64_t offset, int whence);
+  void*                 opaque;
+  const char*           name;
+  /*!
+  ** the state of the memory and file descriptor ios.
+  */
+  uint8_t*              data;
+  size_t                size;
+  size_t                capacity;
+  size_t                pos;
+  int                   fd;
+  int                   owned;
+  int                   mapped;
+  int                   opens;
+  char                  path[32];
+} mml_io_t;
+
 typedef struct mml_encoder_s mml_encoder_t;
 typedef struct mml_decoder_s mml_decoder_t;
+typedef struct mml_context_s mml_context_t;
 
 typedef mml_encoder_t* mml_encoder_p;
 typedef mml_decoder_t* mml_decoder_p;
+typedef mml_context_t* mml_context_p;
 
 int
 mml_encoder_init(mml_encoder_p* encoder, int encoder_id);
@@ -61,12 +292,226 @@ mml_decoder_p
 mml_decoder_init();
 
 /*!
-** Gets the last error message.
+** Gets the last error message of the calling thread, set by the functions 
+** called without a context.
 **
 ** @return last error message
 */  
 const char*
 mml_error(void);  
+
+/*!
+** Gets the number of bytes read from the input file by the last 
+** mml_video_cut or mml_video_cut_ranges call on the calling thread.
+**
+** @return the number of bytes read
+*/
+int64_t
+mml_bytes_read(void);
+
+/*!
+** Gets the number of frames, packets and frame buffers allocated by the 
+** library since the process started, across all threads. Frame buffers come 
+** from pools and are reused, so the count stays flat while a transcode runs.
+**
+** @return the number of allocations
+*/
+int64_t
+mml_buffers_allocated(void);
+
+/*!
+** Gets the duration and the stream information of a media file, opening it 
+** only once. In fast mode the probing is limited to a small part of the file 
+** and no frame is decoded when the container header already has every field.
+**
+** @param original_path
+**        the media file path
+**
+** @param fast
+**        non-zero to limit the probing
+**
+** @param info [out]
+**        the media information
+**
+** @return success or error code
+*/
+int
+mml_media_info(const char* original_path, 
+               int fast, 
+               mml_media_info_t* info);
+
+/*!
+** Probes many media files at once on a pool of worker threads, like 
+** mml_media_info does for one. Every file gets its own status and error 
+** message, the last error message is only set when the batch cannot run.
+**
+** @param probes [in,out]
+**        the files to probe, with their paths set
+**
+** @param nb_probes
+**        the number of files to probe
+**
+** @param fast
+**        non-zero to limit the probing
+**
+** @param threads
+**        the number of worker threads, 0 or less for twice the number of CPUs
+**
+** @return success or error code
+*/
+int
+mml_media_info_batch(mml_media_probe_t* probes, 
+                     int nb_probes, 
+                     int fast, 
+                     int threads);
+
+/*!
+** Enables the process-wide probe cache used by mml_media_info and the other 
+** media information functions, or disables it with a capacity of 0. Entries 
+** are keyed by path, fast or full probe, device, inode, size and modification 
+** time to the nanosecond, so a changed file is probed again, and the least 
+** recently used entry is evicted when the cache is full.
+**
+** @param capacity
+**        the maximum number of cached files, 0 to disable the cache
+**
+** @param file_path
+**        the file the cache is loaded from and saved to, or NULL to keep it in 
+**        memory only
+**
+** @return success or error code
+*/
+int
+mml_cache_open(int capacity, const char* file_path);
+
+/*!
+** Saves the probe cache to its file, if it has one.
+**
+** @return success or error code
+*/
+int
+mml_cache_save(void);
+
+/*!
+** Saves the probe cache to its file, if it has one, and disables it.
+**
+** @return success or error code
+*/
+int
+mml_cache_close(void);
+  
+/*!
+** Gets the path standing for an io, to be given to any function in place of a 
+** file path. The path holds a number, not the address of the io, and stops 
+** working once the io is freed or initialized again.
+**
+** @param io
+**        the io
+**
+** @return the path, stored in the io
+*/
+const char*
+mml_io_path(mml_io_t* io);
+
+/*!
+** Initializes a read-only io over a memory buffer owned by the caller.
+**
+** @param io
+**        the io
+**
+** @param data
+**        the buffer, kept alive by the caller while the io is used
+**
+** @param size
+**        the size of the buffer in bytes
+*/
+void
+mml_io_memory(mml_io_t* io, const void* data, size_t size);
+
+/*!
+** Initializes an io writing to a growing memory buffer, the data and size 
+** fields of the io. It can be read back as an input afterwards.
+**
+** @param io
+**        the io
+**
+** @param name
+**        the file name hint guessing the output format, e.g. "out.mp4"
+*/
+void
+mml_io_buffer(mml_io_t* io, const char* name);
+
+/*!
+** Initializes an io over an open file descriptor, which is left open. Pipes 
+** and sockets cannot seek, so they only suit formats read or written in one 
+** pass.
+**
+** @param io
+**        the io
+**
+** @param fd
+**        the file descriptor
+**
+** @param name
+**        the file name hint guessing the output format, or NULL for inputs
+*/
+void
+mml_io_fd(mml_io_t* io, int fd, const char* name);
+
+/*!
+** Initializes a read-only io over a local file mapped into memory, read 
+** without any system call once the pages are in. The kernel is told how the 
+** file will be read to tune its read-ahead. libavformat still reads through 
+** its own buffer, so the data is copied once from the mapping, where read 
+** copies it from the page cache.
+**
+** The file must not be truncated while it is mapped: reading a page past the 
+** new end raises SIGBUS in the process. Only map files that are not being 
+** rewritten, or leave mapping off for them.
+**
+** @param io
+**        the io
+**
+** @param path
+**        the local file path
+**
+** @param access
+**        MML_IO_NORMAL, MML_IO_SEQUENTIAL for reading from start to end, or 
+**        MML_IO_RANDOM for reading with many seeks
+**
+** @return success or error code, empty files and non-regular files cannot be 
+**         mapped
+*/
+int
+mml_io_mmap(mml_io_t* io, const char* path, int access);
+
+/*!
+** Enables mapping local input files into memory in every function, or 
+** disables it. Each function picks the access pattern of its reads, and falls 
+** back to ordinary reads for files that cannot be mapped. Disabled by default, 
+** as an input truncated by another process while mapped raises SIGBUS, see 
+** mml_io_mmap.
+**
+** @param enable
+**        non-zero to map input files
+*/
+void
+mml_io_map_inputs(int enable);
+
+/*!
+** Seeks an io back to its start, which is done each time it is opened as an 
+** input.
+*/
+void
+mml_io_rewind(mml_io_t* io);
+
+/*!
+** Frees the buffer written by a memory io, or unmaps a mapped file, and 
+** retires the path of the io. Every io given a path goes through it, read-only 
+** memory ios included.
+*/
+void
+mml_io_free(mml_io_t* io);
   
 /*!
 ** Removes audio stream in video file.
@@ -96,7 +541,9 @@ int
 mml_audio_exist(const char* original_video_path);  
 
 /*!
-** Extracts audio stream as a file from video file.
+** Extracts audio stream as a file from video file. The audio packets are 
+** copied without decoding when the output format supports their codec, and 
+** transcoded to the default audio codec of the output format otherwise.
 **
 ** @param original_video_path
 **        the original video path
@@ -108,7 +555,32 @@ mml_audio_exist(const char* original_video_path);
 */
 int  
 mml_audio_extract(const char* original_video_path, 
-                  const char* output_audio_path);  
+                  const char* output_audio_path);
+
+/*!
+** Decodes the first audio stream of a file, whatever its codec, and delivers 
+** it as PCM of the given format to a callback while decoding, without writing 
+** any file.
+**
+** @param original_path
+**        the original media path
+**
+** @param format
+**        the PCM format and chunk size
+**
+** @param callback
+**        the callback receiving the chunks
+**
+** @param opaque
+**        passed to the callback
+**
+** @return success, error code, or the value the callback stopped with
+*/
+int
+mml_audio_pcm(const char* original_path, 
+              const mml_pcm_format_t* format, 
+              mml_pcm_callback_t callback, 
+              void* opaque);  
 
 /*!
 ** Gets video resolution information.
@@ -130,7 +602,8 @@ mml_video_resolution(const char* original_video_path,
                      int* height);
 
 /*!
-** Resizes video stream to a new size.
+** Resizes video stream to a new size. The audio stream is copied as it is 
+** when the output format supports its codec.
 **
 ** @param original_path
 **        the original video path
@@ -152,11 +625,104 @@ mml_video_resize(const char* original_path,
                  int width, 
                  int height);
 
+/*!
+** Resizes video stream to a new size with the given options.
+**
+** @param original_path
+**        the original video path
+**
+** @param output_path
+**        the output video path
+**
+** @param width 
+**        the new video width
+**
+** @param height
+**        the new video height
+**
+** @param options
+**        the transcoding options, or NULL for the defaults
+**
+** @return success or error code
+*/  
+int
+mml_video_resize_ex(const char* original_path, 
+                    const char* output_path, 
+                    int width, 
+                    int height,
+                    const mml_options_t* options);
+
 int
 mml_video_pad(const char* original_path, 
               const char* output_path, 
               int width, 
               int height);  
+
+/*!
+** Scales video stream to fit a new size, keeping the aspect ratio and filling 
+** the borders with the pad color of the options. The audio stream is copied 
+** as it is when the output format supports its codec.
+**
+** @param original_path
+**        the original video path
+**
+** @param output_path
+**        the output video path
+**
+** @param width 
+**        the new video width
+**
+** @param height
+**        the new video height
+**
+** @param options
+**        the transcoding options, or NULL for the defaults
+**
+** @return success or error code
+*/  
+int
+mml_video_pad_ex(const char* original_path, 
+                 const char* output_path, 
+                 int width, 
+                 int height,
+                 const mml_options_t* options);  
+
+/*!
+** Resizes a video stream into several renditions at once, for an adaptive 
+** bitrate ladder. The video is decoded once and every decoded frame is shared 
+** by the renditions, each scaled and encoded on its own thread.
+**
+** @param original_path
+**        the original video path
+**
+** @param renditions
+**        the renditions to write
+**
+** @param nb_renditions
+**        the number of renditions
+**
+** @return success or error code
+*/
+int
+mml_video_ladder(const char* original_path, 
+                 const mml_rendition_t* renditions, 
+                 int nb_renditions);
+
+/*!
+** Resizes a video stream into several renditions at once with the given 
+** options, see mml_video_ladder. The pipeline option has no effect, the 
+** renditions always run in parallel.
+**
+** @param options
+**        the transcoding options, or NULL for the defaults
+**
+** @return success or error code
+*/
+int
+mml_video_ladder_ex(const char* original_path, 
+                    const mml_rendition_t* renditions, 
+                    int nb_renditions,
+                    const mml_options_t* options);
   
 /*!
 ** Concatenates two videos into one.
@@ -176,12 +742,257 @@ int
 mml_video_concat(const char* original_path1, 
                  const char* original_path2, 
                  const char* output_path);  
+
+/*!
+** Concatenates videos into one in a single pass without re-encoding. Only one 
+** input is open at a time and the streams of every input are mapped onto the 
+** streams of the first one by media type, with the timestamps kept continuous 
+** from one input to the next.
+**
+** @param original_paths
+**        the original video paths in playing order
+**
+** @param nb_paths
+**        the number of original video paths
+**
+** @param output_path
+**        the output video path
+**
+** @return success or error code
+*/
+int
+mml_video_concat_files(const char** original_paths, 
+                       int nb_paths, 
+                       const char* output_path);  
+
+/*!
+** Concatenates videos like mml_video_concat_files with the given options, of 
+** which only fragmented applies.
+**
+** @param original_paths
+**        the original video paths in playing order
+**
+** @param nb_paths
+**        the number of original video paths
+**
+** @param output_path
+**        the output video path
+**
+** @param options
+**        the options, or NULL for the defaults
+**
+** @return success or error code
+*/
+int
+mml_video_concat_files_ex(const char** original_paths, 
+                          int nb_paths, 
+                          const char* output_path,
+                          const mml_options_t* options);  
+
+/*!
+** Concatenates videos into one, re-encoding only the streams that do not fit. 
+** The video and audio codec parameters shared by most inputs become those of 
+** the output; every stream already matching them is copied and every other 
+** one is decoded, scaled or resampled and re-encoded to them, all in a single 
+** pass with one input open at a time.
+**
+** @param original_paths
+**        the original video paths in playing order
+**
+** @param nb_paths
+**        the number of original video paths
+**
+** @param output_path
+**        the output video path
+**
+** @return success or error code
+*/
+int
+mml_video_concat_adaptive(const char** original_paths, 
+                          int nb_paths, 
+                          const char* output_path);  
+
+/*!
+** Concatenates videos like mml_video_concat_adaptive with the given options. 
+** The re-encoded video never has B-frames so it can be joined to the copied 
+** streams.
+**
+** @param original_paths
+**        the original video paths in playing order
+**
+** @param nb_paths
+**        the number of original video paths
+**
+** @param output_path
+**        the output video path
+**
+** @param options
+**        the transcoding options, or NULL to re-encode at the bit rate of the 
+**        target stream
+**
+** @return success or error code
+*/
+int
+mml_video_concat_adaptive_ex(const char** original_paths, 
+                             int nb_paths, 
+                             const char* output_path,
+                             const mml_options_t* options);  
   
+/*!
+** Cuts a segment of video into a new file without re-encoding. The input is 
+** seeked to the keyframe at or before the start time, and the segment starts 
+** and ends on keyframes.
+**
+** @param original_path
+**        the original video path
+**
+** @param start_time
+**        the start time of the segment
+**
+** @param end_time
+**        the end time of the segment
+**
+** @param output_path
+**        the output video path
+**
+** @return success or error code
+*/
 int
 mml_video_cut(const char* original_path, 
               double start_time,
               double end_time,
               const char* output_path);  
+
+/*!
+** Cuts a segment of video like mml_video_cut with the given options, of which 
+** only fragmented applies.
+**
+** @param original_path
+**        the original video path
+**
+** @param start_time
+**        the start time of the segment
+**
+** @param end_time
+**        the end time of the segment
+**
+** @param output_path
+**        the output video path
+**
+** @param options
+**        the options, or NULL for the defaults
+**
+** @return success or error code
+*/
+int
+mml_video_cut_ex(const char* original_path, 
+                 double start_time,
+                 double end_time,
+                 const char* output_path,
+                 const mml_options_t* options);  
+  
+/*!
+** Cuts several segments of video into new files in a single pass. The input 
+** is demuxed once, from the keyframe at or before the earliest start time, and 
+** every packet is routed to all the ranges it belongs to, so ranges may 
+** overlap. Each range is aligned on keyframes like mml_video_cut does.
+**
+** @param original_path
+**        the original video path
+**
+** @param ranges
+**        the ranges with their start time, end time and output video path
+**
+** @param nb_ranges
+**        the number of ranges
+**
+** @return success or error code
+*/
+int
+mml_video_cut_ranges(const char* original_path, 
+                     const mml_cut_range_t* ranges,
+                     int nb_ranges);
+
+/*!
+** Cuts several segments of video like mml_video_cut_ranges with the given 
+** options, of which only fragmented applies.
+**
+** @param original_path
+**        the original video path
+**
+** @param ranges
+**        the ranges with their start time, end time and output video path
+**
+** @param nb_ranges
+**        the number of ranges
+**
+** @param options
+**        the options, or NULL for the defaults
+**
+** @return success or error code
+*/
+int
+mml_video_cut_ranges_ex(const char* original_path, 
+                        const mml_cut_range_t* ranges,
+                        int nb_ranges,
+                        const mml_options_t* options);
+
+/*!
+** Cuts a segment of video into a new file with frame accuracy. Only the partial 
+** GOP at the head and the partial GOP at the tail are decoded and re-encoded, 
+** every whole GOP in between is copied unchanged, so the cost stays close to 
+** the one of mml_video_cut. Open GOPs, whose leading frames refer to the GOP 
+** before, cannot be stitched that way, so such a segment is re-encoded 
+** whole. H.264 output is tagged avc3, as the parameter sets change in band.
+**
+** @param original_path
+**        the original video path
+**
+** @param start_time
+**        the start time of the segment
+**
+** @param end_time
+**        the end time of the segment
+**
+** @param output_path
+**        the output video path
+**
+** @return success or error code
+*/
+int
+mml_video_cut_exact(const char* original_path, 
+                    double start_time,
+                    double end_time,
+                    const char* output_path);  
+
+/*!
+** Cuts a segment of video like mml_video_cut_exact with the given options for 
+** the re-encoded GOPs, which never have B-frames.
+**
+** @param original_path
+**        the original video path
+**
+** @param start_time
+**        the start time of the segment
+**
+** @param end_time
+**        the end time of the segment
+**
+** @param output_path
+**        the output video path
+**
+** @param options
+**        the transcoding options, or NULL to re-encode at the bit rate of the 
+**        original video
+**
+** @return success or error code
+*/
+int
+mml_video_cut_exact_ex(const char* original_path, 
+                       double start_time,
+                       double end_time,
+                       const char* output_path,
+                       const mml_options_t* options);  
   
 int
 mml_video_add_audio(const char* original_video_path, 
@@ -215,6 +1026,77 @@ mml_video_save_images(const char* original_path,
                       double end_time, 
                       const char* output_path, 
                       int image_index);
+
+/*!
+** Saves a segment of video as images like mml_video_save_images does, but 
+** converts and compresses the images on a pool of worker threads while the 
+** calling thread keeps demuxing and decoding. A writer thread finishes the 
+** files in index order, so the file names are the same as the sequential 
+** ones. At most two frames per worker are in flight at any time.
+**
+** @param original_path
+**        the original video path
+**
+** @param start_time
+**        the start time of the segment
+**
+** @param end_time
+**        the end time of the segment
+**
+** @param output_path
+**        the output image directory path
+**
+** @param image_index
+**        the index of the first image
+**
+** @param threads
+**        the number of image workers, zero or less for one per CPU core
+**
+** @return success or error code
+*/
+int
+mml_video_save_images_parallel(const char* original_path, 
+                               double start_time, 
+                               double end_time, 
+                               const char* output_path, 
+                               int image_index,
+                               int threads);
+
+/*!
+** Saves the keyframes of a segment of video as images. The input is seeked 
+** to the keyframe at or before the start time and only keyframes are decoded, 
+** so the export time follows the length of the segment, not its position in 
+** the file. Keyframes after the end time are not saved, including the ones 
+** still buffered in the decoder at the end.
+**
+** @param original_path
+**        the original video path
+**
+** @param start_time
+**        the start time of the segment
+**
+** @param end_time
+**        the end time of the segment
+**
+** @param output_path
+**        the output image directory path
+**
+** @param image_index
+**        the index of the first image
+**
+** @param threads
+**        the number of image workers, 1 to convert on the calling thread, zero 
+**        or less for one per CPU core
+**
+** @return success or error code
+*/
+int
+mml_video_save_keyframes(const char* original_path, 
+                         double start_time, 
+                         double end_time, 
+                         const char* output_path, 
+                         int image_index,
+                         int threads);
                                           
 /*!
 **
@@ -222,6 +1104,203 @@ mml_video_save_images(const char* original_path,
 int  
 mml_script_add(const char* original_video_path, const char* output_script_path);
 
+/*
+********************************************************************************
+** CONTEXTS
+********************************************************************************
+*/
+
+/*!
+** Creates a context, owning the error message, the options, the input mapping 
+** and the statistics of the operations run in it. Operations in different 
+** contexts can run concurrently on different threads; a context runs one 
+** operation at a time. The functions without context use a default context 
+** of the calling thread.
+**
+** @param ctx [out]
+**        the context
+**
+** @param options
+**        the options of the operations, or NULL for the defaults
+**
+** @return success or error code
+*/
+int
+mml_context_new(mml_context_p* ctx, const mml_options_t* options);
+
+/*!
+** Frees a context.
+*/
+void
+mml_context_free(mml_context_p ctx);
+
+/*!
+** Sets the options of the operations run in a context, the profile they point 
+** to is not copied.
+**
+** @param options
+**        the options, or NULL for the defaults
+*/
+void
+mml_context_options(mml_context_p ctx, const mml_options_t* options);
+
+/*!
+** Enables mapping local input files into memory in a context, like 
+** mml_io_map_inputs does for all of them.
+*/
+void
+mml_context_map_inputs(mml_context_p ctx, int enable);
+
+/*!
+** Gets the last error message of a context.
+*/
+const char*
+mml_context_error(mml_context_p ctx);
+
+/*!
+** Gets the number of bytes read by the last cut of a context, see 
+** mml_bytes_read.
+*/
+int64_t
+mml_context_bytes_read(mml_context_p ctx);
+
+/*!
+** Gets the number of frames, packets and frame buffers allocated by the 
+** operations of a context, see mml_buffers_allocated.
+*/
+int64_t
+mml_context_buffers_allocated(mml_context_p ctx);
+
+/*!
+** The operations in a context. Each behaves as the function of the same name 
+** without the suffix, the _ex one when there is one, with the options of the 
+** context; its error message and statistics go to the context, also from the 
+** threads it starts.
+*/
+int
+mml_media_info_ctx(mml_context_p ctx, 
+                   const char* original_path, 
+                   int fast, 
+                   mml_media_info_t* info);
+
+int
+mml_media_info_batch_ctx(mml_context_p ctx, 
+                         mml_media_probe_t* probes, 
+                         int nb_probes, 
+                         int fast, 
+                         int threads);
+
+int
+mml_audio_remove_ctx(mml_context_p ctx, 
+                     const char* original_video_path, 
+                     const char* output_video_path);
+
+int
+mml_audio_exist_ctx(mml_context_p ctx, 
+                    const char* original_video_path);
+
+int
+mml_audio_extract_ctx(mml_context_p ctx, 
+                      const char* original_video_path, 
+                      const char* output_audio_path);
+
+int
+mml_audio_pcm_ctx(mml_context_p ctx, 
+                  const char* original_path, 
+                  const mml_pcm_format_t* format, 
+                  mml_pcm_callback_t callback, 
+                  void* opaque);
+
+int
+mml_video_resolution_ctx(mml_context_p ctx, 
+                         const char* original_video_path, 
+                         int* width, 
+                         int* height);
+
+int
+mml_video_resize_ctx(mml_context_p ctx, 
+                     const char* original_path, 
+                     const char* output_path, 
+                     int width, 
+                     int height);
+
+int
+mml_video_pad_ctx(mml_context_p ctx, 
+                  const char* original_path, 
+                  const char* output_path, 
+                  int width, 
+                  int height);
+
+int
+mml_video_ladder_ctx(mml_context_p ctx, 
+                     const char* original_path, 
+                     const mml_rendition_t* renditions, 
+                     int nb_renditions);
+
+int
+mml_video_concat_ctx(mml_context_p ctx, 
+                     const char* original_path1, 
+                     const char* original_path2, 
+                     const char* output_path);
+
+int
+mml_video_concat_files_ctx(mml_context_p ctx, 
+                           const char** original_paths, 
+                           int nb_paths, 
+                           const char* output_path);
+
+int
+mml_video_concat_adaptive_ctx(mml_context_p ctx, 
+                              const char** original_paths, 
+                              int nb_paths, 
+                              const char* output_path);
+
+int
+mml_video_cut_ctx(mml_context_p ctx, 
+                  const char* original_path, 
+                  double start_time,
+                  double end_time,
+                  const char* output_path);
+
+int
+mml_video_cut_ranges_ctx(mml_context_p ctx, 
+                         const char* original_path, 
+                         const mml_cut_range_t* ranges,
+                         int nb_ranges);
+
+int
+mml_video_cut_exact_ctx(mml_context_p ctx, 
+                        const char* original_path, 
+                        double start_time,
+                        double end_time,
+                        const char* output_path);
+
+int
+mml_video_save_images_ctx(mml_context_p ctx, 
+                          const char* original_path, 
+                          double start_time, 
+                          double end_time, 
+                          const char* output_path, 
+                          int image_index);
+
+int
+mml_video_save_images_parallel_ctx(mml_context_p ctx, 
+                                   const char* original_path, 
+                                   double start_time, 
+                                   double end_time, 
+                                   const char* output_path, 
+                                   int image_index,
+                                   int threads);
+
+int
+mml_video_save_keyframes_ctx(mml_context_p ctx, 
+                             const char* original_path, 
+                             double start_time, 
+                             double end_time, 
+                             const char* output_path, 
+                             int image_index,
+                             int threads);
+
 #ifdef __cplusplus
 }
 #endif
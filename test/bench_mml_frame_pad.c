@@ -0,0 +1,142 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <string.h>
+#include <libavutil/frame.h>
+#include "libmml-internal.h"
+#include "mml_test.h"
+
+#define ITERATIONS            100
+
+/*!
+** The previous padding loop, filling the whole frame byte by byte before 
+** copying the scaled frame in.
+*/
+static void 
+bench_frame_pad_loop(AVFrame* padded, const AVFrame* scaled, int pad_left, int pad_top)
+{
+  for (int y = 0; y < padded->height; y++) {
+    for (int x = 0; x < padded->width; x++) {
+      padded->data[0][y * padded->linesize[0] + x] = 0;
+      if (y < padded->height / 2 && x < padded->width / 2) {
+        padded->data[1][y * padded->linesize[1] + x] = 128;
+        padded->data[2][y * padded->linesize[2] + x] = 128;
+      }
+    }
+  }
+  for (int y = 0; y < scaled->height; y++) {
+    memcpy(padded->data[0] + (y + pad_top) * padded->linesize[0] + pad_left,
+           scaled->data[0] + y * scaled->linesize[0],
+           scaled->width);
+  }
+  for (int y = 0; y < scaled->height / 2; y++) {
+    memcpy(padded->data[1] + (y + pad_top / 2) * padded->linesize[1] + pad_left / 2,
+           scaled->data[1] + y * scaled->linesize[1],
+           scaled->width / 2);
+    memcpy(padded->data[2] + (y + pad_top / 2) * padded->linesize[2] + pad_left / 2,
+           scaled->data[2] + y * scaled->linesize[2],
+           scaled->width / 2);
+  }
+}
+
+/*!
+** Pads a frame with the previous loop and with the border kernel and checks 
+** that both give the same image, then prints the time of each.
+*/
+static int
+bench_frame_pad(int width, int height, int format, const char* name)
+{
+  /*!
+  ** 4:3的内容居中放进16:9的画面，左右各有黑边。
+  */
+  int scaled_width = (height * 4 / 3) & ~1;
+  int pad_left = ((width - scaled_width) / 2) & ~1;
+  /*!
+  ** 与原循环一样填Y=0的黑色，两种结果才能逐字节比较。
+  */
+  uint8_t color[3] = { 0, 128, 128 };
+  AVFrame* padded = av_frame_alloc();
+  AVFrame* scaled = av_frame_alloc();
+  AVFrame* expected = av_frame_alloc();
+  double start, loop = 0, kernel;
+  
+  padded->format = format;
+  padded->width = width;
+  padded->height = height;
+  scaled->format = format;
+  scaled->width = scaled_width;
+  scaled->height = height;
+  expected->format = format;
+  expected->width = width;
+  expected->height = height;
+  MML_TEST_CHECK(av_frame_get_buffer(padded, 32) >= 0 && av_frame_get_buffer(scaled, 32) >= 0 && 
+                 av_frame_get_buffer(expected, 32) >= 0, "%s frames not allocated", name);
+  for (int p = 0; format == AV_PIX_FMT_YUV420P && p < 3; p++)
+  {
+    for (int y = 0; y < (p == 0 ? height : height / 2); y++)
+      memset(scaled->data[p] + y * scaled->linesize[p], 16 + y * 7 + p * 50, scaled->linesize[p]);
+  }
+  
+  if (format == AV_PIX_FMT_YUV420P)
+  {
+    start = mml_test_now();
+    for (int i = 0; i < ITERATIONS; i++)
+      bench_frame_pad_loop(expected, scaled, pad_left, 0);
+    loop = (mml_test_now() - start) * 1000 / ITERATIONS;
+  }
+  
+  start = mml_test_now();
+  for (int i = 0; i < ITERATIONS; i++)
+  {
+    MML_TEST_CHECK(mml_frame_fill_border(padded, pad_left, 0, scaled_width, height, color) == MML_SUCCESS && 
+                   mml_frame_copy_rect(padded, scaled, pad_left, 0) == MML_SUCCESS, 
+                   "%s not supported", name);
+  }
+  kernel = (mml_test_now() - start) * 1000 / ITERATIONS;
+  
+  if (format == AV_PIX_FMT_YUV420P)
+  {
+    for (int p = 0; p < 3; p++)
+    {
+      int plane_width = p == 0 ? width : width / 2;
+      int plane_height = p == 0 ? height : height / 2;
+      for (int y = 0; y < plane_height; y++)
+      {
+        MML_TEST_CHECK(memcmp(padded->data[p] + y * padded->linesize[p], 
+                              expected->data[p] + y * expected->linesize[p], 
+                              plane_width) == 0, 
+                       "%s %dx%d plane %d row %d differs from the loop", name, width, height, p, y);
+      }
+    }
+  }
+  
+  if (format == AV_PIX_FMT_YUV420P)
+    printf("%-12s %5dx%-5d loop: %8.3fms  kernel: %8.3fms  x%.1f\n", name, width, height, loop, kernel, loop / kernel);
+  else
+    printf("%-12s %5dx%-5d loop:        -    kernel: %8.3fms\n", name, width, height, kernel);
+  
+  av_frame_free(&padded);
+  av_frame_free(&scaled);
+  av_frame_free(&expected);
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  int formats[] = { AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV420P10LE };
+  const char* names[] = { "yuv420p", "nv12", "yuv422p", "yuv420p10le" };
+  
+  for (int i = 0; i < 4; i++)
+  {
+    if (bench_frame_pad(1920, 1080, formats[i], names[i]) != 0 || 
+        bench_frame_pad(3840, 2160, formats[i], names[i]) != 0)
+      return 1;
+  }
+  return 0;
+}
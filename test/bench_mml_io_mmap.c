@@ -0,0 +1,186 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "libmml.h"
+#include "mml_test.h"
+
+#define ROUNDS                10
+
+typedef struct counted_io_s
+{
+  mml_io_t              io;
+  int                   (*read)(void* opaque, uint8_t* buf, int size);
+  int64_t               (*seek)(void* opaque, int64_t offset, int whence);
+  int64_t               syscalls;
+} counted_io_t;
+
+static long
+page_faults(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt + usage.ru_majflt;
+}
+
+/*!
+** 每次回调就是一次 read、lseek 或取大小的 fstat 系统调用，和 file 协议一样。
+*/
+static int
+counted_read(void* opaque, uint8_t* buf, int size)
+{
+  counted_io_t* counted = (counted_io_t*)opaque;
+  counted->syscalls++;
+  return counted->read(&counted->io, buf, size);
+}
+
+static int64_t
+counted_seek(void* opaque, int64_t offset, int whence)
+{
+  counted_io_t* counted = (counted_io_t*)opaque;
+  counted->syscalls++;
+  return counted->seek(&counted->io, offset, whence);
+}
+
+/*!
+** Runs the probe, the cut and the keyframe export of a file.
+*/
+static int
+run(const char* path, const char* output_path, const char* image_path)
+{
+  mml_media_info_t info;
+  
+  if (mml_media_info(path, 0, &info) != MML_SUCCESS)
+    return -1;
+  if (mml_video_cut(path, 2.0, 6.0, output_path) != MML_SUCCESS)
+    return -1;
+  if (mml_video_save_keyframes(path, 0.0, 10.0, image_path, 0, 1) != MML_SUCCESS)
+    return -1;
+  return 0;
+}
+
+/*!
+** Tells whether the cut of a mode holds the same bytes as the one of the file 
+** protocol.
+*/
+static int
+same_output(const char* output_path, const uint8_t* reference, size_t reference_size)
+{
+  uint8_t* data = NULL;
+  size_t size = 0;
+  int same = mml_test_read_file(output_path, &data, &size) == 0 && 
+             size == reference_size && memcmp(data, reference, size) == 0;
+  free(data);
+  return same;
+}
+
+/*!
+** Reads the sample files with the file protocol of libavformat, through a 
+** counting file descriptor io issuing the same read, lseek and fstat calls 
+** with the same 32 KiB buffer, and mapped into memory, and prints the time, 
+** the system calls and the page faults of each. The system calls of the file 
+** protocol and of the mapping are not counted here, they can be measured with 
+** strace -f -c -e trace=read,lseek,fstat,mmap,munmap,madvise. The cuts of 
+** the three modes must hold the same bytes.
+*/
+int main(int argc, char* argv[])
+{
+  const char* default_paths[] = { "../../data/V1.mp4", "../../data/V2.mp4", "../../data/V1_1920x1080.mp4" };
+  const char** paths = argc > 1 ? (const char**)argv + 1 : default_paths;
+  int nb_paths = argc > 1 ? argc - 1 : 3;
+  const char* output_path = "../../data/bench.mmap.mp4";
+  const char* image_path = "../../data/bench.mmap";
+  double start, elapsed;
+  long faults;
+  
+  mkdir(image_path, 0755);
+  printf("%-32s %-6s %10s %10s %10s\n", "file", "mode", "ms", "syscalls", "faults");
+  for (int i = 0; i < nb_paths; i++)
+  {
+    counted_io_t counted;
+    uint8_t* reference = NULL;
+    size_t reference_size = 0;
+    int fd;
+    
+    /*!
+    ** libavformat 自带的 file 协议。
+    */
+    mml_io_map_inputs(0);
+    faults = page_faults();
+    start = mml_test_now();
+    for (int j = 0; j < ROUNDS; j++)
+    {
+      if (run(paths[i], output_path, image_path) < 0)
+      {
+        printf("error: %s\n", mml_error());
+        return 1;
+      }
+    }
+    elapsed = (mml_test_now() - start) * 1000 / ROUNDS;
+    printf("%-32s %-6s %10.3f %10s %10ld\n", paths[i], "file", elapsed, "-", (page_faults() - faults) / ROUNDS);
+    MML_TEST_CHECK(mml_test_read_file(output_path, &reference, &reference_size) == 0, "'%s' not read", output_path);
+    
+    if ((fd = open(paths[i], O_RDONLY)) < 0)
+    {
+      printf("error: '%s' not open\n", paths[i]);
+      return 1;
+    }
+    mml_io_fd(&counted.io, fd, paths[i]);
+    counted.read = counted.io.read;
+    counted.seek = counted.io.seek;
+    counted.io.read = counted_read;
+    counted.io.seek = counted_seek;
+    counted.io.write = NULL;
+    counted.io.opaque = &counted;
+    counted.syscalls = 0;
+    faults = page_faults();
+    start = mml_test_now();
+    for (int j = 0; j < ROUNDS; j++)
+    {
+      if (run(mml_io_path(&counted.io), output_path, image_path) < 0)
+      {
+        printf("error: %s\n", mml_error());
+        mml_io_free(&counted.io);
+        close(fd);
+        return 1;
+      }
+    }
+    elapsed = (mml_test_now() - start) * 1000 / ROUNDS;
+    mml_io_free(&counted.io);
+    close(fd);
+    printf("%-32s %-6s %10.3f %10lld %10ld\n", paths[i], "fd", elapsed, (long long)counted.syscalls / ROUNDS, (page_faults() - faults) / ROUNDS);
+    MML_TEST_CHECK(same_output(output_path, reference, reference_size), "'%s' differs through the fd io", paths[i]);
+    
+    /*!
+    ** 映射到内存，每次打开只有 open、fstat、mmap、madvise、close 和 munmap。
+    */
+    mml_io_map_inputs(1);
+    faults = page_faults();
+    start = mml_test_now();
+    for (int j = 0; j < ROUNDS; j++)
+    {
+      if (run(paths[i], output_path, image_path) < 0)
+      {
+        printf("error: %s\n", mml_error());
+        return 1;
+      }
+    }
+    elapsed = (mml_test_now() - start) * 1000 / ROUNDS;
+    printf("%-32s %-6s %10.3f %10s %10ld\n", paths[i], "mmap", elapsed, "-", (page_faults() - faults) / ROUNDS);
+    mml_io_map_inputs(0);
+    MML_TEST_CHECK(same_output(output_path, reference, reference_size), "'%s' differs when mapped", paths[i]);
+    free(reference);
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <sys/stat.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          20
+#define CLIP_FPS              25
+
+/*!
+** Resizes a generated clip with every built-in profile, checks that each 
+** output has every frame at the target size, and prints the speed and the 
+** output size of each.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/bench.profiles.mp4";
+  const char* output_path = "../../data/bench.profiles.out.mp4";
+  const char* names[] = { "proxy", "default", "archive" };
+  const mml_profile_t* profiles[] = { &mml_profile_proxy, &mml_profile_default, &mml_profile_archive };
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 1280, 720, CLIP_FPS) >= 0, 
+                 "failed to generate '%s'", video_path);
+  
+  printf(" profile  seconds      fps      bytes\n");
+  for (int i = 0; i < 3; i++)
+  {
+    mml_options_t options = { MML_THREADS_AUTO, 0, MML_THREADS_AUTO, 0, 0, profiles[i] };
+    mml_test_clip_info_t info;
+    struct stat output_stat;
+    double start = mml_test_now();
+    int rc = mml_video_resize_ex(video_path, output_path, 640, 360, &options);
+    double elapsed = mml_test_now() - start;
+    MML_TEST_CHECK(rc == MML_SUCCESS, "%s: %s", names[i], mml_error());
+    MML_TEST_CHECK(stat(output_path, &output_stat) == 0 && mml_test_clip_probe(output_path, &info) == 0, 
+                   "'%s' not readable", output_path);
+    MML_TEST_CHECK(info.width == 640 && info.height == 360 && info.decode_errors == 0 && 
+                   info.video_frames == CLIP_SECONDS * CLIP_FPS, 
+                   "%s: %dx%d, %d frames, %d decoding errors", 
+                   names[i], info.width, info.height, info.video_frames, info.decode_errors);
+    printf("%8s %8.3f %8.1f %10lld\n", 
+           names[i], 
+           elapsed, 
+           CLIP_SECONDS * CLIP_FPS / elapsed, 
+           (long long)output_stat.st_size);
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          20
+#define CLIP_FPS              25
+
+/*!
+** Builds a four rendition ladder from a generated clip, once with a resize per 
+** rendition and once with a single ladder call, checks the renditions of the 
+** ladder, and prints the time of both.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/bench.ladder.mp4";
+  mml_rendition_t renditions[] = {
+    { "../../data/bench.ladder.1080p.mp4", 1920, 1080, 0, NULL },
+    { "../../data/bench.ladder.720p.mp4", 1280, 720, 0, NULL },
+    { "../../data/bench.ladder.480p.mp4", 854, 480, 0, NULL },
+    { "../../data/bench.ladder.360p.mp4", 640, 360, 0, NULL },
+  };
+  double start, resize, ladder;
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 1920, 1080, CLIP_FPS) >= 0, 
+                 "failed to generate '%s'", video_path);
+  
+  start = mml_test_now();
+  for (int i = 0; i < 4; i++)
+  {
+    MML_TEST_CHECK(mml_video_resize(video_path, renditions[i].output_path, renditions[i].width, renditions[i].height) == MML_SUCCESS, 
+                   "resize: %s", mml_error());
+  }
+  resize = mml_test_now() - start;
+  
+  start = mml_test_now();
+  MML_TEST_CHECK(mml_video_ladder(video_path, renditions, 4) == MML_SUCCESS, "ladder: %s", mml_error());
+  ladder = mml_test_now() - start;
+  
+  for (int i = 0; i < 4; i++)
+  {
+    mml_test_clip_info_t info;
+    MML_TEST_CHECK(mml_test_clip_probe(renditions[i].output_path, &info) == 0, 
+                   "'%s' not readable", renditions[i].output_path);
+    MML_TEST_CHECK(info.width == renditions[i].width && info.height == renditions[i].height && 
+                   info.decode_errors == 0 && info.video_frames == CLIP_SECONDS * CLIP_FPS, 
+                   "'%s': %dx%d, %d frames, %d decoding errors", renditions[i].output_path, 
+                   info.width, info.height, info.video_frames, info.decode_errors);
+  }
+  
+  printf("  mode  seconds\n");
+  printf("resize %8.3f\n", resize);
+  printf("ladder %8.3f  x%.2f\n", ladder, resize / ladder);
+  return 0;
+}
@@ -0,0 +1,47 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          20
+#define CLIP_FPS              25
+
+/*!
+** Resizes a generated clip with the sequential loop and with the pipelined 
+** stages, checks that both outputs have every frame at the target size, and 
+** prints the frames per second of both.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/bench.pipeline.mp4";
+  const char* output_path = "../../data/bench.pipeline.out.mp4";
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 1280, 720, CLIP_FPS) >= 0, 
+                 "failed to generate '%s'", video_path);
+  
+  printf("    mode  seconds      fps\n");
+  for (int pipeline = 0; pipeline <= 1; pipeline++)
+  {
+    mml_options_t options = { MML_THREADS_AUTO, 0, MML_THREADS_AUTO, 0, pipeline };
+    mml_test_clip_info_t info;
+    double start = mml_test_now();
+    int rc = mml_video_resize_ex(video_path, output_path, 640, 360, &options);
+    double elapsed = mml_test_now() - start;
+    MML_TEST_CHECK(rc == MML_SUCCESS, "%s: %s", pipeline ? "pipeline" : "loop", mml_error());
+    MML_TEST_CHECK(mml_test_clip_probe(output_path, &info) == 0, "'%s' not readable", output_path);
+    MML_TEST_CHECK(info.width == 640 && info.height == 360 && info.decode_errors == 0 && 
+                   info.video_frames == CLIP_SECONDS * CLIP_FPS, 
+                   "%s: %dx%d, %d frames, %d decoding errors", pipeline ? "pipeline" : "loop", 
+                   info.width, info.height, info.video_frames, info.decode_errors);
+    printf("%8s %8.3f %8.1f\n", pipeline ? "pipeline" : "loop", elapsed, CLIP_SECONDS * CLIP_FPS / elapsed);
+  }
+  return 0;
+}
@@ -0,0 +1,50 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          20
+#define CLIP_FPS              25
+
+/*!
+** Resizes a generated clip with 1 to N decoder and encoder threads and prints 
+** the frames per second of each run, checking that every output has every 
+** frame at the target size.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/bench.threads.mp4";
+  const char* output_path = "../../data/bench.threads.out.mp4";
+  int max_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 1280, 720, CLIP_FPS) >= 0, 
+                 "failed to generate '%s'", video_path);
+  
+  printf("threads  seconds      fps\n");
+  for (int threads = 1; threads <= max_threads; threads++)
+  {
+    mml_options_t options = { threads, 0, threads, 0 };
+    mml_test_clip_info_t info;
+    double start = mml_test_now();
+    int rc = mml_video_resize_ex(video_path, output_path, 640, 360, &options);
+    double elapsed = mml_test_now() - start;
+    MML_TEST_CHECK(rc == MML_SUCCESS, "%d threads: %s", threads, mml_error());
+    MML_TEST_CHECK(mml_test_clip_probe(output_path, &info) == 0, "'%s' not readable", output_path);
+    MML_TEST_CHECK(info.width == 640 && info.height == 360 && info.decode_errors == 0 && 
+                   info.video_frames == CLIP_SECONDS * CLIP_FPS, 
+                   "%d threads: %dx%d, %d frames, %d decoding errors", threads, 
+                   info.width, info.height, info.video_frames, info.decode_errors);
+    printf("%7d %8.3f %8.1f\n", threads, elapsed, CLIP_SECONDS * CLIP_FPS / elapsed);
+  }
+  return 0;
+}
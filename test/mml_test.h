@@ -0,0 +1,65 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#ifndef __MML_TEST_H__
+#define __MML_TEST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+/*!
+** Fails the test, returning 1 from main, when a condition does not hold.
+*/
+#define MML_TEST_CHECK(cond, ...)                                             \
+  do                                                                          \
+  {                                                                           \
+    if (!(cond))                                                              \
+    {                                                                         \
+      printf("failed: ");                                                     \
+      printf(__VA_ARGS__);                                                    \
+      printf(" (%s:%d)\n", __FILE__, __LINE__);                               \
+      return 1;                                                               \
+    }                                                                         \
+  } while (0)
+
+/*!
+** Reads the monotonic clock, in seconds, for timing the benchmarks.
+*/
+static inline double
+mml_test_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*!
+** Reads a whole file into a buffer to be freed by the caller.
+**
+** @return zero or -1 if the file cannot be read
+*/
+static inline int
+mml_test_read_file(const char* path, uint8_t** data, size_t* size)
+{
+  FILE* file = fopen(path, "rb");
+  long length;
+  
+  if (file == NULL)
+    return -1;
+  fseek(file, 0, SEEK_END);
+  length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  *data = (uint8_t*)malloc(length > 0 ? length : 1);
+  *size = fread(*data, 1, length, file);
+  fclose(file);
+  return *size == (size_t)length ? 0 : -1;
+}
+
+#endif // __MML_TEST_H__
@@ -0,0 +1,342 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#ifndef __MML_TEST_CLIP_H__
+#define __MML_TEST_CLIP_H__
+
+#include <math.h>
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+
+/*!
+** Encodes one frame (or flushes with NULL) and writes the packets.
+*/
+static int
+mml_test_clip_write(AVFormatContext* fmt, 
+                    AVCodecContext* enc, 
+                    AVStream* stream, 
+                    AVFrame* frame)
+{
+  AVPacket* pkt = av_packet_alloc();
+  int ret = avcodec_send_frame(enc, frame);
+  while (ret >= 0)
+  {
+    ret = avcodec_receive_packet(enc, pkt);
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+    {
+      ret = 0;
+      break;
+    }
+    if (ret < 0)
+      break;
+    av_packet_rescale_ts(pkt, enc->time_base, stream->time_base);
+    pkt->stream_index = stream->index;
+    ret = av_interleaved_write_frame(fmt, pkt);
+  }
+  av_packet_free(&pkt);
+  return ret;
+}
+
+/*!
+** H.264 with B-frames and open GOPs, whose leading frames refer to the GOP 
+** before their keyframe.
+*/
+#define MML_TEST_CLIP_OPEN_GOP                  1
+
+/*!
+** No audio stream.
+*/
+#define MML_TEST_CLIP_NO_AUDIO                  2
+
+/*!
+** Generates a test clip with a video stream of the given codec (one keyframe 
+** per second) and an AAC audio stream.
+**
+** @param path
+**        the output clip path
+**
+** @param codec_id
+**        the video codec, AV_CODEC_ID_H264 gives avcC extradata in MP4
+**
+** @param seconds
+**        the clip duration
+**
+** @param width
+**        the video width
+**
+** @param height
+**        the video height
+**
+** @param fps
+**        the video frame rate
+**
+** @param flags
+**        MML_TEST_CLIP_* flags
+**
+** @return zero or a negative error
+*/
+static int
+mml_test_clip_create_ex(const char* path, int codec_id, int seconds, int width, int height, int fps, int flags)
+{
+  AVFormatContext* fmt = NULL;
+  AVCodecContext* venc = NULL;
+  AVCodecContext* aenc = NULL;
+  AVStream* vst;
+  AVStream* ast = NULL;
+  int audio = !(flags & MML_TEST_CLIP_NO_AUDIO);
+  AVFrame* vframe = av_frame_alloc();
+  AVFrame* aframe = av_frame_alloc();
+  int64_t vnext = 0;
+  int64_t anext = 0;
+  int ret = -1;
+
+  if (avformat_alloc_output_context2(&fmt, NULL, NULL, path) < 0)
+    goto RELEASE;
+
+  if (avcodec_find_encoder(codec_id) == NULL)
+    goto RELEASE;
+  venc = avcodec_alloc_context3(avcodec_find_encoder(codec_id));
+  venc->width = width;
+  venc->height = height;
+  venc->pix_fmt = AV_PIX_FMT_YUV420P;
+  venc->time_base = (AVRational){1, fps};
+  venc->framerate = (AVRational){fps, 1};
+  venc->gop_size = fps;
+  venc->max_b_frames = 0;
+  venc->bit_rate = 200000;
+  if (flags & MML_TEST_CLIP_OPEN_GOP)
+  {
+    if (codec_id != AV_CODEC_ID_H264)
+      goto RELEASE;
+    venc->max_b_frames = 2;
+    av_opt_set(venc->priv_data, "x264-params", "open-gop=1", 0);
+  }
+  if (fmt->oformat->flags & AVFMT_GLOBALHEADER)
+    venc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  if (avcodec_open2(venc, venc->codec, NULL) < 0)
+    goto RELEASE;
+  vst = avformat_new_stream(fmt, NULL);
+  avcodec_parameters_from_context(vst->codecpar, venc);
+  vst->time_base = venc->time_base;
+
+  aenc = avcodec_alloc_context3(avcodec_find_encoder(AV_CODEC_ID_AAC));
+  aenc->sample_fmt = AV_SAMPLE_FMT_FLTP;
+  aenc->sample_rate = 44100;
+  av_channel_layout_default(&aenc->ch_layout, 1);
+  aenc->bit_rate = 64000;
+  aenc->time_base = (AVRational){1, aenc->sample_rate};
+  if (fmt->oformat->flags & AVFMT_GLOBALHEADER)
+    aenc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  if (avcodec_open2(aenc, aenc->codec, NULL) < 0)
+    goto RELEASE;
+  if (audio)
+  {
+    ast = avformat_new_stream(fmt, NULL);
+    avcodec_parameters_from_context(ast->codecpar, aenc);
+    ast->time_base = aenc->time_base;
+  }
+
+  if (avio_open(&fmt->pb, path, AVIO_FLAG_WRITE) < 0)
+    goto RELEASE;
+  if (avformat_write_header(fmt, NULL) < 0)
+    goto RELEASE;
+
+  vframe->format = venc->pix_fmt;
+  vframe->width = width;
+  vframe->height = height;
+  av_frame_get_buffer(vframe, 0);
+
+  aframe->format = aenc->sample_fmt;
+  aframe->sample_rate = aenc->sample_rate;
+  aframe->nb_samples = aenc->frame_size;
+  av_channel_layout_copy(&aframe->ch_layout, &aenc->ch_layout);
+  av_frame_get_buffer(aframe, 0);
+
+  while (vnext < (int64_t)seconds * fps || (audio && anext < (int64_t)seconds * aenc->sample_rate))
+  {
+    if (!audio || av_compare_ts(vnext, venc->time_base, anext, aenc->time_base) <= 0)
+    {
+      av_frame_make_writable(vframe);
+      for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+          vframe->data[0][y * vframe->linesize[0] + x] = (uint8_t)(x + y + vnext * 3);
+      for (int y = 0; y < height / 2; y++)
+      {
+        memset(vframe->data[1] + y * vframe->linesize[1], 128, width / 2);
+        memset(vframe->data[2] + y * vframe->linesize[2], (uint8_t)(64 + vnext), width / 2);
+      }
+      vframe->pts = vnext++;
+      if (mml_test_clip_write(fmt, venc, vst, vframe) < 0)
+        goto RELEASE;
+    }
+    else
+    {
+      av_frame_make_writable(aframe);
+      float* samples = (float*)aframe->data[0];
+      for (int i = 0; i < aframe->nb_samples; i++)
+        samples[i] = 0.2f * sinf(2.0f * 3.14159265f * 440.0f * (anext + i) / aenc->sample_rate);
+      aframe->pts = anext;
+      anext += aframe->nb_samples;
+      if (mml_test_clip_write(fmt, aenc, ast, aframe) < 0)
+        goto RELEASE;
+    }
+  }
+  mml_test_clip_write(fmt, venc, vst, NULL);
+  if (audio)
+    mml_test_clip_write(fmt, aenc, ast, NULL);
+
+  ret = av_write_trailer(fmt);
+
+RELEASE:
+  if (fmt != NULL && fmt->pb != NULL)
+    avio_closep(&fmt->pb);
+  if (fmt != NULL)
+    avformat_free_context(fmt);
+  if (venc != NULL)
+    avcodec_free_context(&venc);
+  if (aenc != NULL)
+    avcodec_free_context(&aenc);
+  av_frame_free(&vframe);
+  av_frame_free(&aframe);
+  return ret;
+}
+
+/*!
+** Generates a test clip with a video stream of the given codec, see 
+** mml_test_clip_create_ex.
+*/
+static int
+mml_test_clip_create_codec(const char* path, int codec_id, int seconds, int width, int height, int fps)
+{
+  return mml_test_clip_create_ex(path, codec_id, seconds, width, height, fps, 0);
+}
+
+/*!
+** Generates a test clip with an MPEG-4 video stream, see 
+** mml_test_clip_create_ex.
+*/
+static int
+mml_test_clip_create(const char* path, int seconds, int width, int height, int fps)
+{
+  return mml_test_clip_create_codec(path, AV_CODEC_ID_MPEG4, seconds, width, height, fps);
+}
+
+/*!
+** What a clip turned out to be, its first video stream decoded to the end.
+*/
+typedef struct mml_test_clip_info_s
+{
+  int                   codec_id;
+  unsigned int          codec_tag;
+  int                   width;
+  int                   height;
+  int                   nb_audio_streams;
+  int                   video_packets;
+  int                   video_frames;
+  int                   decode_errors;
+  double                video_start;
+  double                video_end;
+  double                audio_end;
+} mml_test_clip_info_t;
+
+/*!
+** Decodes the first video stream of a clip to the end, counting the packets, 
+** the frames and the decoding errors, and the time span of the frames. The 
+** end of the audio is taken from the audio packets.
+**
+** @return zero or a negative error if the clip cannot be opened
+*/
+static int
+mml_test_clip_probe(const char* path, mml_test_clip_info_t* info)
+{
+  AVFormatContext* fmt = NULL;
+  AVCodecContext* dec = NULL;
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* frame = av_frame_alloc();
+  AVStream* st;
+  int index;
+  int ret = -1;
+  
+  memset(info, 0, sizeof(mml_test_clip_info_t));
+  info->video_start = -1;
+  if (avformat_open_input(&fmt, path, NULL, NULL) < 0 || avformat_find_stream_info(fmt, NULL) < 0)
+    goto RELEASE;
+  for (unsigned int i = 0; i < fmt->nb_streams; i++)
+  {
+    if (fmt->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+      info->nb_audio_streams++;
+  }
+  if ((index = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0)) < 0)
+    goto RELEASE;
+  st = fmt->streams[index];
+  info->codec_id = st->codecpar->codec_id;
+  info->codec_tag = st->codecpar->codec_tag;
+  info->width = st->codecpar->width;
+  info->height = st->codecpar->height;
+  
+  dec = avcodec_alloc_context3(avcodec_find_decoder(st->codecpar->codec_id));
+  avcodec_parameters_to_context(dec, st->codecpar);
+  /*!
+  ** 解码错误要报出来，而不是被隐藏掉。
+  */
+  dec->err_recognition |= AV_EF_EXPLODE;
+  if (avcodec_open2(dec, dec->codec, NULL) < 0)
+    goto RELEASE;
+  
+  for (int eof = 0; !eof; )
+  {
+    int rc = av_read_frame(fmt, pkt);
+    if (rc < 0)
+      eof = 1;
+    else if (pkt->stream_index != index)
+    {
+      AVStream* pst = fmt->streams[pkt->stream_index];
+      if (pst->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && pkt->pts != AV_NOPTS_VALUE)
+      {
+        double end = (pkt->pts + pkt->duration) * av_q2d(pst->time_base);
+        if (end > info->audio_end)
+          info->audio_end = end;
+      }
+      av_packet_unref(pkt);
+      continue;
+    }
+    else
+      info->video_packets++;
+    if (avcodec_send_packet(dec, eof ? NULL : pkt) < 0)
+      info->decode_errors++;
+    av_packet_unref(pkt);
+    while ((rc = avcodec_receive_frame(dec, frame)) >= 0)
+    {
+      double t = frame->best_effort_timestamp * av_q2d(st->time_base);
+      if (info->video_start < 0 || t < info->video_start)
+        info->video_start = t;
+      if (t > info->video_end)
+        info->video_end = t;
+      if (frame->decode_error_flags != 0 || (frame->flags & AV_FRAME_FLAG_CORRUPT))
+        info->decode_errors++;
+      info->video_frames++;
+      av_frame_unref(frame);
+    }
+    if (rc != AVERROR(EAGAIN) && rc != AVERROR_EOF)
+      info->decode_errors++;
+  }
+  ret = 0;
+  
+RELEASE:
+  if (dec != NULL)
+    avcodec_free_context(&dec);
+  if (fmt != NULL)
+    avformat_close_input(&fmt);
+  av_packet_free(&pkt);
+  av_frame_free(&frame);
+  return ret;
+}
+
+#endif // __MML_TEST_CLIP_H__
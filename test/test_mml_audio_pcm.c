@@ -0,0 +1,104 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          4
+#define STOP_CHUNKS           3
+#define STOP_VALUE            42
+
+typedef struct pcm_stats_s
+{
+  int                   chunk_samples;
+  int                   sample_rate;
+  int                   chunks;
+  int                   short_chunks;
+  int                   bad_times;
+  int64_t               samples;
+  int                   last_size;
+  double                last_time;
+  int                   peak;
+  int                   stop_after;
+} pcm_stats_t;
+
+static int
+on_pcm(void* opaque, const void* samples, int nb_samples, double time)
+{
+  pcm_stats_t* stats = (pcm_stats_t*)opaque;
+  const int16_t* pcm = (const int16_t*)samples;
+  
+  /*!
+  ** 只有最后一块可以不满，每块的时间就是之前送出的样本数。
+  */
+  if (stats->last_size != 0 && stats->last_size != stats->chunk_samples)
+    stats->short_chunks++;
+  if (time < (double)stats->samples / stats->sample_rate - 1e-9 || 
+      time > (double)stats->samples / stats->sample_rate + 1e-9)
+    stats->bad_times++;
+  for (int i = 0; i < nb_samples; i++)
+  {
+    if (abs(pcm[i]) > stats->peak)
+      stats->peak = abs(pcm[i]);
+  }
+  stats->chunks++;
+  stats->samples += nb_samples;
+  stats->last_size = nb_samples;
+  stats->last_time = time;
+  return stats->chunks == stats->stop_after ? STOP_VALUE : MML_SUCCESS;
+}
+
+/*!
+** Converts the audio of a generated clip, a 440 Hz tone, to the 16 kHz mono 
+** chunks used for speech recognition and checks the chunk sizes, their times, 
+** the number of samples and the level, then that a callback can stop it.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/pcm.mp4";
+  /*!
+  ** 语音识别常用的格式：16kHz单声道，每块100毫秒。
+  */
+  mml_pcm_format_t format = { 16000, 1, MML_SAMPLE_S16, 1600 };
+  pcm_stats_t stats = {0};
+  int64_t expected = (int64_t)CLIP_SECONDS * format.sample_rate;
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 160, 120, 25) >= 0, 
+                 "failed to generate '%s'", video_path);
+  stats.chunk_samples = format.chunk_samples;
+  stats.sample_rate = format.sample_rate;
+  MML_TEST_CHECK(mml_audio_pcm(video_path, &format, on_pcm, &stats) == MML_SUCCESS, "pcm: %s", mml_error());
+  printf("%d chunks, %lld samples, %.3fs, last chunk at %.3fs, peak: %d\n", 
+         stats.chunks, (long long)stats.samples, 
+         (double)stats.samples / format.sample_rate, stats.last_time, stats.peak);
+  
+  /*!
+  ** AAC编码按1024个样本一帧，末尾会多出不到一帧。
+  */
+  MML_TEST_CHECK(stats.samples >= expected - format.sample_rate / 10 && 
+                 stats.samples <= expected + format.sample_rate / 10, 
+                 "%lld samples instead of about %lld", (long long)stats.samples, (long long)expected);
+  MML_TEST_CHECK(stats.chunks == (stats.samples + format.chunk_samples - 1) / format.chunk_samples, 
+                 "%d chunks for %lld samples", stats.chunks, (long long)stats.samples);
+  MML_TEST_CHECK(stats.short_chunks == 0, "%d short chunks before the last", stats.short_chunks);
+  MML_TEST_CHECK(stats.bad_times == 0, "%d chunks with a wrong time", stats.bad_times);
+  MML_TEST_CHECK(stats.peak > 3000 && stats.peak < 10000, "peak %d instead of about 6550", stats.peak);
+  
+  pcm_stats_t stopped = {0};
+  stopped.chunk_samples = format.chunk_samples;
+  stopped.sample_rate = format.sample_rate;
+  stopped.stop_after = STOP_CHUNKS;
+  MML_TEST_CHECK(mml_audio_pcm(video_path, &format, on_pcm, &stopped) == STOP_VALUE, 
+                 "the callback did not stop the conversion");
+  MML_TEST_CHECK(stopped.chunks == STOP_CHUNKS, "%d chunks after the stop", stopped.chunks);
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,90 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include "libmml.h"
+#include "mml_test_clip.h"
+
+#define CLIP_FPS              25
+#define SHORT_SECONDS         4
+#define LONG_SECONDS          12
+/*!
+** the allocations a longer input may add, for buffers still referenced by the 
+** encoder when the pool is asked for the next one
+*/
+#define SLACK                 8
+
+static const char* path_names[] = { "resize", "resize pipeline", "pad", "audio extract", "concat adaptive" };
+
+static int
+run_path(int path, const char* clip, const char* other)
+{
+  const char* output_path = "../../data/buffers.out.mp4";
+  mml_options_t options = { MML_THREADS_AUTO, 0, MML_THREADS_AUTO, 0, 1 };
+  const char* paths[] = { clip, other };
+  
+  switch (path)
+  {
+    case 0: return mml_video_resize(clip, output_path, 320, 180);
+    case 1: return mml_video_resize_ex(clip, output_path, 320, 180, &options);
+    case 2: return mml_video_pad(clip, output_path, 640, 640);
+    case 3: return mml_audio_extract(clip, "../../data/buffers.out.m4a");
+    default: return mml_video_concat_adaptive(paths, 2, output_path);
+  }
+}
+
+/*!
+** Runs every transcode path on a short and on a long clip. With pooled frames 
+** and packets the allocations do not grow with the number of frames.
+*/
+int main(int argc, char* argv[])
+{
+  const char* clips[][2] = {
+    { "../../data/buffers.short.mp4", "../../data/buffers.short.small.mp4" },
+    { "../../data/buffers.long.mp4", "../../data/buffers.long.small.mp4" },
+  };
+  int seconds[] = { SHORT_SECONDS, LONG_SECONDS };
+  int failed = 0;
+  
+  for (int i = 0; i < 2; i++)
+  {
+    if (mml_test_clip_create(clips[i][0], seconds[i], 640, 360, CLIP_FPS) < 0 ||
+        mml_test_clip_create(clips[i][1], seconds[i], 320, 240, CLIP_FPS) < 0)
+    {
+      printf("error: failed to generate '%s'\n", clips[i][0]);
+      return 1;
+    }
+  }
+  
+  printf("%16s %8s %8s %10s\n", "path", "short", "long", "per frame");
+  for (int path = 0; path < 5; path++)
+  {
+    int64_t allocated[2];
+    for (int i = 0; i < 2; i++)
+    {
+      int64_t start = mml_buffers_allocated();
+      if (run_path(path, clips[i][0], clips[i][1]) != MML_SUCCESS)
+      {
+        printf("error: %s: %s\n", path_names[path], mml_error());
+        return 1;
+      }
+      allocated[i] = mml_buffers_allocated() - start;
+    }
+    
+    /*!
+    ** 长短两段输入的分配次数之差除以多出的帧数，就是稳定状态下每帧的分配次数。
+    */
+    int frames = (LONG_SECONDS - SHORT_SECONDS) * CLIP_FPS;
+    double per_frame = (double)(allocated[1] - allocated[0]) / frames;
+    printf("%16s %8lld %8lld %10.3f\n", path_names[path], 
+           (long long)allocated[0], (long long)allocated[1], per_frame);
+    if (allocated[1] - allocated[0] > SLACK)
+      failed = 1;
+  }
+	return failed;
+}
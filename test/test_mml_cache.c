@@ -0,0 +1,121 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define NB_CLIPS              3
+
+/*!
+** Overwrites a file in place with zeros and puts its timestamps back, so its 
+** cache key is unchanged but probing it again fails: a successful probe can 
+** only come from the cache. With a non-zero delta the modification time moves 
+** by that many nanoseconds instead.
+*/
+static int
+scramble(const char* path, long delta)
+{
+  struct stat st;
+  struct timespec times[2];
+  FILE* file;
+  char* zeros;
+  
+  if (stat(path, &st) != 0 || (file = fopen(path, "r+b")) == NULL)
+    return -1;
+  zeros = (char*)calloc(1, st.st_size);
+  fwrite(zeros, 1, st.st_size, file);
+  fclose(file);
+  free(zeros);
+  times[0] = st.st_atim;
+  times[1] = st.st_mtim;
+  times[1].tv_nsec += delta;
+  if (times[1].tv_nsec >= 1000000000)
+  {
+    times[1].tv_sec++;
+    times[1].tv_nsec -= 1000000000;
+  }
+  return utimensat(AT_FDCWD, path, times, 0);
+}
+
+/*!
+** Checks that the probe cache answers for unchanged files, probes a file 
+** again when it changes, even by a nanosecond, keeps fast and full probes 
+** apart, evicts the least recently used file at capacity, and survives being 
+** saved and loaded.
+*/
+int main(int argc, char* argv[])
+{
+  const char* paths[NB_CLIPS] = {
+    "../../data/cache.1.mp4",
+    "../../data/cache.2.mp4",
+    "../../data/cache.3.mp4"
+  };
+  const int widths[NB_CLIPS] = { 320, 480, 640 };
+  const int heights[NB_CLIPS] = { 240, 360, 480 };
+  const char* cache_path = "../../data/mml.cache";
+  mml_media_info_t info;
+  
+  for (int i = 0; i < NB_CLIPS; i++)
+    MML_TEST_CHECK(mml_test_clip_create(paths[i], 2, widths[i], heights[i], 25) >= 0, 
+                   "failed to generate '%s'", paths[i]);
+  remove(cache_path);
+  MML_TEST_CHECK(mml_cache_open(NB_CLIPS - 1, cache_path) == MML_SUCCESS, "cache not open");
+  
+  /*!
+  ** 命中：文件内容被清零但键不变，只能从缓存得到结果。
+  */
+  MML_TEST_CHECK(mml_media_info(paths[0], 0, &info) == MML_SUCCESS, "probe: %s", mml_error());
+  MML_TEST_CHECK(info.nb_streams == 2 && info.streams[0].width == widths[0], "probed %d streams", info.nb_streams);
+  MML_TEST_CHECK(scramble(paths[0], 0) == 0, "'%s' not scrambled", paths[0]);
+  MML_TEST_CHECK(mml_media_info(paths[0], 0, &info) == MML_SUCCESS, "no hit: %s", mml_error());
+  MML_TEST_CHECK(info.streams[0].width == widths[0] && info.streams[0].height == heights[0], 
+                 "hit gave %dx%d", info.streams[0].width, info.streams[0].height);
+  
+  /*!
+  ** 快速探测和完整探测分开缓存。
+  */
+  MML_TEST_CHECK(mml_media_info(paths[0], 1, &info) != MML_SUCCESS, "fast probe hit the full probe");
+  
+  /*!
+  ** 缓存写到文件再加载，仍然命中。
+  */
+  MML_TEST_CHECK(mml_cache_close() == MML_SUCCESS, "cache not saved");
+  MML_TEST_CHECK(mml_cache_open(NB_CLIPS - 1, cache_path) == MML_SUCCESS, "cache not loaded");
+  MML_TEST_CHECK(mml_media_info(paths[0], 0, &info) == MML_SUCCESS, "no hit after reload: %s", mml_error());
+  
+  /*!
+  ** 修改时间只差一纳秒也重新探测。
+  */
+  MML_TEST_CHECK(scramble(paths[0], 1) == 0, "'%s' not scrambled", paths[0]);
+  MML_TEST_CHECK(mml_media_info(paths[0], 0, &info) != MML_SUCCESS, "hit after the file changed");
+  
+  /*!
+  ** 容量满时淘汰最久没用的文件。
+  */
+  for (int i = 1; i < NB_CLIPS; i++)
+    MML_TEST_CHECK(mml_media_info(paths[i], 0, &info) == MML_SUCCESS, "probe: %s", mml_error());
+  MML_TEST_CHECK(mml_test_clip_create(paths[0], 2, widths[0], heights[0], 25) >= 0, 
+                 "failed to generate '%s'", paths[0]);
+  MML_TEST_CHECK(mml_media_info(paths[0], 0, &info) == MML_SUCCESS, "probe: %s", mml_error());
+  for (int i = 0; i < NB_CLIPS; i++)
+    MML_TEST_CHECK(scramble(paths[i], 0) == 0, "'%s' not scrambled", paths[i]);
+  MML_TEST_CHECK(mml_media_info(paths[1], 0, &info) != MML_SUCCESS, "'%s' not evicted", paths[1]);
+  MML_TEST_CHECK(mml_media_info(paths[2], 0, &info) == MML_SUCCESS, "'%s' evicted", paths[2]);
+  MML_TEST_CHECK(mml_media_info(paths[0], 0, &info) == MML_SUCCESS, "'%s' evicted", paths[0]);
+  MML_TEST_CHECK(info.streams[0].width == widths[0], "hit gave width %d", info.streams[0].width);
+  
+  mml_cache_close();
+  printf("ok\n");
+	return 0;
+}
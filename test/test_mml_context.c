@@ -0,0 +1,100 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define ROUNDS                4
+
+typedef struct job_s
+{
+  mml_context_p         ctx;
+  const char*           input_path;
+  char                  output_path[256];
+  int                   failures;
+} job_t;
+
+static void*
+run_job(void* arg)
+{
+  job_t* job = (job_t*)arg;
+  for (int i = 0; i < ROUNDS; i++)
+  {
+    if (mml_video_cut_ctx(job->ctx, job->input_path, 1.0, 3.0, job->output_path) != MML_SUCCESS)
+      job->failures++;
+    if (mml_video_resize_ctx(job->ctx, job->input_path, job->output_path, 160, 120) != MML_SUCCESS)
+      job->failures++;
+  }
+  return NULL;
+}
+
+/*!
+** Runs the same operations on two threads at once, each in its own context, 
+** one on a missing file, and checks that each context only holds its own 
+** error and statistics and that the default context of the main thread is 
+** left alone.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/context.mp4";
+  mml_options_t options = { MML_THREADS_AUTO, 0, MML_THREADS_AUTO, 0, 0, NULL, 0x000000, 0 };
+  pthread_t threads[2];
+  job_t jobs[2];
+  int width, height;
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, 4, 320, 240, 25) >= 0, 
+                 "failed to generate '%s'", video_path);
+  MML_TEST_CHECK(mml_video_resolution("../../data/NOT_EXIST.main.mp4", &width, &height) != MML_SUCCESS, 
+                 "missing file probed");
+  MML_TEST_CHECK(strstr(mml_error(), "NOT_EXIST.main") != NULL, "main error: %s", mml_error());
+  
+  memset(jobs, 0, sizeof(jobs));
+  for (int i = 0; i < 2; i++)
+  {
+    MML_TEST_CHECK(mml_context_new(&jobs[i].ctx, &options) == MML_SUCCESS, "context not created");
+    jobs[i].input_path = i == 0 ? "../../data/NOT_EXIST.job.mp4" : video_path;
+    snprintf(jobs[i].output_path, sizeof(jobs[i].output_path), "../../data/context.%d.mp4", i);
+    MML_TEST_CHECK(pthread_create(&threads[i], NULL, run_job, &jobs[i]) == 0, "thread not created");
+  }
+  for (int i = 0; i < 2; i++)
+    pthread_join(threads[i], NULL);
+  
+  for (int i = 0; i < 2; i++)
+    printf("job %d: %d failures, error '%s', %lld bytes read, %lld buffers\n", i, jobs[i].failures, 
+           mml_context_error(jobs[i].ctx), 
+           (long long)mml_context_bytes_read(jobs[i].ctx), 
+           (long long)mml_context_buffers_allocated(jobs[i].ctx));
+  
+  /*!
+  ** 出错的上下文只有自己的错误，没有统计。
+  */
+  MML_TEST_CHECK(jobs[0].failures == 2 * ROUNDS, "%d of %d failed", jobs[0].failures, 2 * ROUNDS);
+  MML_TEST_CHECK(strstr(mml_context_error(jobs[0].ctx), "NOT_EXIST.job") != NULL, 
+                 "failed job error: %s", mml_context_error(jobs[0].ctx));
+  MML_TEST_CHECK(mml_context_bytes_read(jobs[0].ctx) == 0, "failed job read bytes");
+  MML_TEST_CHECK(mml_context_buffers_allocated(jobs[0].ctx) == 0, "failed job allocated buffers");
+  
+  /*!
+  ** 成功的上下文没有错误，统计只来自自己的操作。
+  */
+  MML_TEST_CHECK(jobs[1].failures == 0, "%d failures: %s", jobs[1].failures, mml_context_error(jobs[1].ctx));
+  MML_TEST_CHECK(mml_context_error(jobs[1].ctx)[0] == '\0', "job error: %s", mml_context_error(jobs[1].ctx));
+  MML_TEST_CHECK(mml_context_bytes_read(jobs[1].ctx) > 0, "job read no bytes");
+  MML_TEST_CHECK(mml_context_buffers_allocated(jobs[1].ctx) > 0, "job allocated no buffers");
+  
+  MML_TEST_CHECK(strstr(mml_error(), "NOT_EXIST.main") != NULL, "main error overwritten: %s", mml_error());
+  
+  for (int i = 0; i < 2; i++)
+    mml_context_free(jobs[i].ctx);
+  printf("ok\n");
+	return 0;
+}
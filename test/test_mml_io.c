@@ -0,0 +1,174 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          6
+#define START_TIME            1.0
+#define END_TIME              4.0
+
+/*!
+** A growing buffer behind user callbacks.
+*/
+typedef struct callback_io_s
+{
+  uint8_t*              data;
+  size_t                size;
+  size_t                capacity;
+  size_t                pos;
+} callback_io_t;
+
+static int
+on_read(void* opaque, uint8_t* buf, int size)
+{
+  callback_io_t* cb = (callback_io_t*)opaque;
+  
+  if (cb->pos >= cb->size)
+    return 0;
+  if ((size_t)size > cb->size - cb->pos)
+    size = (int)(cb->size - cb->pos);
+  memcpy(buf, cb->data + cb->pos, size);
+  cb->pos += size;
+  return size;
+}
+
+static int
+on_write(void* opaque, const uint8_t* buf, int size)
+{
+  callback_io_t* cb = (callback_io_t*)opaque;
+  
+  if (cb->pos + size > cb->capacity)
+  {
+    size_t capacity = cb->capacity > 0 ? cb->capacity : 65536;
+    while (capacity < cb->pos + size)
+      capacity *= 2;
+    if ((cb->data = (uint8_t*)realloc(cb->data, capacity)) == NULL)
+      return -1;
+    cb->capacity = capacity;
+  }
+  memcpy(cb->data + cb->pos, buf, size);
+  cb->pos += size;
+  if (cb->pos > cb->size)
+    cb->size = cb->pos;
+  return size;
+}
+
+static int64_t
+on_seek(void* opaque, int64_t offset, int whence)
+{
+  callback_io_t* cb = (callback_io_t*)opaque;
+  
+  if (whence == MML_IO_SIZE)
+    return (int64_t)cb->size;
+  if (whence == SEEK_CUR)
+    offset += (int64_t)cb->pos;
+  else if (whence == SEEK_END)
+    offset += (int64_t)cb->size;
+  if (offset < 0 || offset > (int64_t)cb->size)
+    return -1;
+  cb->pos = (size_t)offset;
+  return offset;
+}
+
+/*!
+** Cuts the same clip from a file into a file, from a memory io into a memory 
+** io and into a callback io, and checks that all three outputs hold the same 
+** bytes, that the outputs read back, and that a freed io's path no longer 
+** opens anything.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/io.mp4";
+  const char* output_path = "../../data/io.cut.mp4";
+  uint8_t* data = NULL;
+  uint8_t* expected = NULL;
+  size_t size;
+  size_t expected_size;
+  callback_io_t cb = {0};
+  mml_io_t input;
+  mml_io_t output;
+  mml_io_t callback;
+  mml_io_t piped;
+  char input_path[32];
+  int width, height;
+  int fds[2];
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 320, 240, 25) >= 0, 
+                 "failed to generate '%s'", video_path);
+  MML_TEST_CHECK(mml_test_read_file(video_path, &data, &size) == 0, "'%s' not read", video_path);
+  
+  MML_TEST_CHECK(mml_video_cut(video_path, START_TIME, END_TIME, output_path) == MML_SUCCESS, 
+                 "file cut: %s", mml_error());
+  MML_TEST_CHECK(mml_test_read_file(output_path, &expected, &expected_size) == 0, "'%s' not read", output_path);
+  
+  /*!
+  ** 内存输入、内存输出，结果和文件完全一致。
+  */
+  mml_io_memory(&input, data, size);
+  mml_io_buffer(&output, "io.cut.mp4");
+  MML_TEST_CHECK(mml_video_cut(mml_io_path(&input), START_TIME, END_TIME, mml_io_path(&output)) == MML_SUCCESS, 
+                 "memory cut: %s", mml_error());
+  printf("file: %zu bytes, memory: %zu bytes\n", expected_size, output.size);
+  MML_TEST_CHECK(output.size == expected_size && memcmp(output.data, expected, expected_size) == 0, 
+                 "memory output differs from the file output");
+  
+  /*!
+  ** 回调输出，再作为输入读回来。
+  */
+  memset(&callback, 0, sizeof(callback));
+  callback.read = on_read;
+  callback.write = on_write;
+  callback.seek = on_seek;
+  callback.opaque = &cb;
+  callback.name = "io.cut.mp4";
+  MML_TEST_CHECK(mml_video_cut(mml_io_path(&input), START_TIME, END_TIME, mml_io_path(&callback)) == MML_SUCCESS, 
+                 "callback cut: %s", mml_error());
+  printf("callback: %zu bytes\n", cb.size);
+  MML_TEST_CHECK(cb.size == expected_size && memcmp(cb.data, expected, expected_size) == 0, 
+                 "callback output differs from the file output");
+  MML_TEST_CHECK(mml_video_resolution(mml_io_path(&callback), &width, &height) == MML_SUCCESS, 
+                 "callback input: %s", mml_error());
+  MML_TEST_CHECK(width == 320 && height == 240, "callback input %dx%d", width, height);
+  MML_TEST_CHECK(mml_video_resolution(mml_io_path(&output), &width, &height) == MML_SUCCESS, 
+                 "memory input: %s", mml_error());
+  MML_TEST_CHECK(width == 320 && height == 240, "memory input %dx%d", width, height);
+  
+  /*!
+  ** 释放后的路径和伪造的路径都打不开。
+  */
+  snprintf(input_path, sizeof(input_path), "%s", mml_io_path(&input));
+  mml_io_free(&input);
+  MML_TEST_CHECK(mml_video_resolution(input_path, &width, &height) != MML_SUCCESS, 
+                 "'%s' opened after the io was freed", input_path);
+  MML_TEST_CHECK(mml_video_resolution("mmlio://123456789", &width, &height) != MML_SUCCESS, 
+                 "a forged io path opened");
+  
+  /*!
+  ** 管道不可定位。
+  */
+  MML_TEST_CHECK(pipe(fds) == 0, "no pipe");
+  mml_io_fd(&piped, fds[0], NULL);
+  MML_TEST_CHECK(piped.seek == NULL, "a pipe io seeks");
+  mml_io_free(&piped);
+  close(fds[0]);
+  close(fds[1]);
+  
+  mml_io_free(&callback);
+  mml_io_free(&output);
+  free(cb.data);
+  free(expected);
+  free(data);
+  printf("ok\n");
+	return 0;
+}
@@ -0,0 +1,146 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <string.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          4
+#define CLIP_FPS              25
+
+/*!
+** Remuxes a clip with its video stream repeated nb_videos times in front of 
+** its audio stream.
+**
+** @return zero or a negative error
+*/
+static int
+create_many_streams(const char* video_path, const char* output_path, int nb_videos)
+{
+  AVFormatContext* in = NULL;
+  AVFormatContext* out = NULL;
+  AVPacket* pkt = av_packet_alloc();
+  int video = -1, audio = -1;
+  int ret = -1;
+  
+  if (avformat_open_input(&in, video_path, NULL, NULL) < 0 || avformat_find_stream_info(in, NULL) < 0)
+    goto RELEASE;
+  video = av_find_best_stream(in, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+  audio = av_find_best_stream(in, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
+  if (video < 0 || audio < 0 || avformat_alloc_output_context2(&out, NULL, NULL, output_path) < 0)
+    goto RELEASE;
+  for (int i = 0; i <= nb_videos; i++)
+  {
+    AVStream* st = avformat_new_stream(out, NULL);
+    AVStream* ist = in->streams[i < nb_videos ? video : audio];
+    avcodec_parameters_copy(st->codecpar, ist->codecpar);
+    st->codecpar->codec_tag = 0;
+    st->time_base = ist->time_base;
+  }
+  if (avio_open(&out->pb, output_path, AVIO_FLAG_WRITE) < 0 || avformat_write_header(out, NULL) < 0)
+    goto RELEASE;
+  while (av_read_frame(in, pkt) >= 0)
+  {
+    int first = pkt->stream_index == video ? 0 : nb_videos;
+    int last = pkt->stream_index == video ? nb_videos - 1 : nb_videos;
+    for (int i = first; i <= last; i++)
+    {
+      AVPacket* copy = av_packet_clone(pkt);
+      copy->stream_index = i;
+      av_packet_rescale_ts(copy, in->streams[pkt->stream_index]->time_base, out->streams[i]->time_base);
+      av_interleaved_write_frame(out, copy);
+      av_packet_free(&copy);
+    }
+    av_packet_unref(pkt);
+  }
+  av_write_trailer(out);
+  ret = 0;
+  
+RELEASE:
+  if (out != NULL)
+  {
+    avio_closep(&out->pb);
+    avformat_free_context(out);
+  }
+  avformat_close_input(&in);
+  av_packet_free(&pkt);
+  return ret;
+}
+
+/*!
+** Probes a generated clip in the fast and the full mode and checks the 
+** duration and the fields of its video and audio streams, that a file with 
+** more streams than listed reports its real count and its audio, and that a 
+** missing file fails.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/info.mp4";
+  const char* many_path = "../../data/info.many.mkv";
+  mml_media_info_t info;
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 320, 240, CLIP_FPS) >= 0, 
+                 "failed to generate '%s'", video_path);
+  for (int fast = 1; fast >= 0; fast--)
+  {
+    const mml_stream_info_t* video = NULL;
+    const mml_stream_info_t* audio = NULL;
+    
+    MML_TEST_CHECK(mml_media_info(video_path, fast, &info) == MML_SUCCESS, "probe: %s", mml_error());
+    printf("fast: %d, duration: %.3fs, bit rate: %lld, streams: %d\n", 
+           fast, info.duration, (long long)info.bit_rate, info.nb_streams);
+    MML_TEST_CHECK(info.nb_streams == 2 && info.nb_streams_total == 2, 
+                   "%d of %d streams", info.nb_streams, info.nb_streams_total);
+    for (int i = 0; i < info.nb_streams; i++)
+    {
+      if (info.streams[i].type == MML_MEDIA_TYPE_VIDEO)
+        video = &info.streams[i];
+      else if (info.streams[i].type == MML_MEDIA_TYPE_AUDIO)
+        audio = &info.streams[i];
+    }
+    MML_TEST_CHECK(video != NULL && audio != NULL, "no video or no audio stream");
+    MML_TEST_CHECK(info.duration >= CLIP_SECONDS - 0.1 && info.duration <= CLIP_SECONDS + 0.1, 
+                   "lasts %.3fs instead of %ds", info.duration, CLIP_SECONDS);
+    /*!
+    ** 总码率在完整探测时才估算。
+    */
+    MML_TEST_CHECK(fast || info.bit_rate > 0, "no bit rate");
+    
+    MML_TEST_CHECK(strcmp(video->codec, "mpeg4") == 0, "video codec '%s'", video->codec);
+    MML_TEST_CHECK(video->width == 320 && video->height == 240, "%dx%d", video->width, video->height);
+    MML_TEST_CHECK(video->frame_rate > CLIP_FPS - 0.01 && video->frame_rate < CLIP_FPS + 0.01, 
+                   "%.3f fps", video->frame_rate);
+    MML_TEST_CHECK(video->nb_frames == CLIP_SECONDS * CLIP_FPS, "%lld video frames", (long long)video->nb_frames);
+    MML_TEST_CHECK(video->sample_rate == 0 && video->channels == 0, "audio fields set on the video stream");
+    
+    MML_TEST_CHECK(strcmp(audio->codec, "aac") == 0, "audio codec '%s'", audio->codec);
+    MML_TEST_CHECK(audio->sample_rate == 44100 && audio->channels == 1, 
+                   "%d Hz, %d channels", audio->sample_rate, audio->channels);
+    MML_TEST_CHECK(audio->width == 0 && audio->height == 0, "video fields set on the audio stream");
+  }
+  
+  MML_TEST_CHECK(mml_audio_exist(video_path) == 1, "no audio found in '%s'", video_path);
+  
+  /*!
+  ** 音频排在列出的流之后。
+  */
+  MML_TEST_CHECK(create_many_streams(video_path, many_path, MML_MEDIA_MAX_STREAMS) == 0, 
+                 "failed to generate '%s'", many_path);
+  MML_TEST_CHECK(mml_media_info(many_path, 1, &info) == MML_SUCCESS, "probe: %s", mml_error());
+  printf("many streams: %d of %d listed\n", info.nb_streams, info.nb_streams_total);
+  MML_TEST_CHECK(info.nb_streams == MML_MEDIA_MAX_STREAMS && info.nb_streams_total == MML_MEDIA_MAX_STREAMS + 1, 
+                 "%d of %d streams", info.nb_streams, info.nb_streams_total);
+  MML_TEST_CHECK(mml_audio_exist(many_path) == 1, "no audio found after %d streams", MML_MEDIA_MAX_STREAMS);
+  
+  MML_TEST_CHECK(mml_media_info("../../data/NOT_EXIST.mp4", 1, &info) != MML_SUCCESS, 
+                 "a missing file was probed");
+  printf("ok\n");
+  return 0;
+}
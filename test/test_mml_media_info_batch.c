@@ -0,0 +1,79 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <string.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define NB_CLIPS              5
+
+/*!
+** Probes clips of different lengths and a missing file in one batch on two 
+** threads, and checks that every file got its own result: the clips their 
+** duration and streams, the missing file its error, and that the last error 
+** message was left alone.
+*/
+int main(int argc, char* argv[])
+{
+  const char* missing_path = "../../data/NOT_EXIST.mp4";
+  char clip_paths[NB_CLIPS][64];
+  mml_media_probe_t probes[NB_CLIPS + 1];
+  mml_media_info_t info;
+  char last_error[1024];
+  int nb_probes = NB_CLIPS + 1;
+  int succeeded = 0;
+  int failed = 0;
+  
+  memset(probes, 0, sizeof(probes));
+  for (int i = 0; i < NB_CLIPS; i++)
+  {
+    snprintf(clip_paths[i], sizeof(clip_paths[i]), "../../data/batch.%d.mp4", i + 1);
+    MML_TEST_CHECK(mml_test_clip_create(clip_paths[i], i + 1, 160, 120, 25) >= 0, 
+                   "failed to generate '%s'", clip_paths[i]);
+  }
+  /*!
+  ** 缺失的文件放在中间，结果要按下标对应，不能错位。
+  */
+  for (int i = 0, j = 0; i < nb_probes; i++)
+    probes[i].path = i == NB_CLIPS / 2 ? missing_path : clip_paths[j++];
+  
+  /*!
+  ** 先留下另一个文件的错误，批量探测的失败不能覆盖它。
+  */
+  MML_TEST_CHECK(mml_media_info("../../data/NOT_EXIST_EITHER.mp4", 1, &info) != MML_SUCCESS, 
+                 "a missing file was probed");
+  snprintf(last_error, sizeof(last_error), "%s", mml_error());
+  MML_TEST_CHECK(mml_media_info_batch(probes, nb_probes, 1, 2) == MML_SUCCESS, "batch: %s", mml_error());
+  MML_TEST_CHECK(strcmp(mml_error(), last_error) == 0, "last error changed to '%s'", mml_error());
+  
+  for (int i = 0, j = 0; i < nb_probes; i++)
+  {
+    if (probes[i].path == missing_path)
+    {
+      printf("'%s' error: %s\n", probes[i].path, probes[i].error);
+      MML_TEST_CHECK(probes[i].status != MML_SUCCESS, "'%s' was probed", probes[i].path);
+      MML_TEST_CHECK(strstr(probes[i].error, missing_path) != NULL, "error '%s'", probes[i].error);
+      failed++;
+      continue;
+    }
+    
+    double seconds = ++j;
+    printf("'%s' duration: %.3fs, streams: %d\n", probes[i].path, probes[i].info.duration, probes[i].info.nb_streams);
+    MML_TEST_CHECK(probes[i].status == MML_SUCCESS, "'%s': %s", probes[i].path, probes[i].error);
+    MML_TEST_CHECK(probes[i].info.duration >= seconds - 0.1 && probes[i].info.duration <= seconds + 0.1, 
+                   "'%s' lasts %.3fs instead of %.0fs", probes[i].path, probes[i].info.duration, seconds);
+    MML_TEST_CHECK(probes[i].info.nb_streams == 2, "'%s' has %d streams", probes[i].path, probes[i].info.nb_streams);
+    succeeded++;
+  }
+  MML_TEST_CHECK(succeeded == NB_CLIPS && failed == 1, 
+                 "%d probed and %d failed instead of %d and 1", succeeded, failed, NB_CLIPS);
+  printf("ok\n");
+  return 0;
+}
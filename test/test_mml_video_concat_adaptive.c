@@ -0,0 +1,87 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          4
+#define CLIP_FPS              25
+
+/*!
+** Concatenates two clips with the same parameters and one with a different 
+** size in between, so the majority is copied and the middle one re-encoded, 
+** and checks that the output has the majority's parameters and decodes to 
+** the end without errors. Then concatenates three clips where the middle one 
+** has no audio and checks that the audio of the last one still lines up with 
+** its video.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_paths[] = {
+    "../../data/adaptive.1.mp4",
+    "../../data/adaptive.2.mp4",
+    "../../data/adaptive.3.mp4"
+  };
+  const char* output_path = "../../data/adaptive.concat.mp4";
+  const int widths[] = { 320, 480, 320 };
+  const int heights[] = { 240, 360, 240 };
+  int nb_paths = sizeof(video_paths) / sizeof(video_paths[0]);
+  mml_test_clip_info_t info;
+  int codec_id = AV_CODEC_ID_H264;
+  
+  for (int i = 0; i < nb_paths; i++)
+  {
+    if (mml_test_clip_create_codec(video_paths[i], codec_id, CLIP_SECONDS, widths[i], heights[i], CLIP_FPS) >= 0)
+      continue;
+    MML_TEST_CHECK(i == 0 && codec_id == AV_CODEC_ID_H264, "failed to generate '%s'", video_paths[i]);
+    printf("no H.264 encoder, testing with MPEG-4\n");
+    codec_id = AV_CODEC_ID_MPEG4;
+    i--;
+  }
+  
+  MML_TEST_CHECK(mml_video_concat_adaptive(video_paths, nb_paths, output_path) == MML_SUCCESS, 
+                 "concat: %s", mml_error());
+  MML_TEST_CHECK(mml_test_clip_probe(output_path, &info) == 0, "'%s' not readable", output_path);
+  
+  int expected = nb_paths * CLIP_SECONDS * CLIP_FPS;
+  printf("%dx%d, frames: %d of %d expected, packets: %d, span: %.3fs - %.3fs, errors: %d\n", 
+         info.width, info.height, info.video_frames, expected, info.video_packets, 
+         info.video_start, info.video_end, info.decode_errors);
+  MML_TEST_CHECK(info.codec_id == codec_id, "codec %d instead of %d", info.codec_id, codec_id);
+  MML_TEST_CHECK(codec_id != AV_CODEC_ID_H264 || info.codec_tag == MKTAG('a', 'v', 'c', '3'), 
+                 "sample entry 0x%08x instead of avc3", info.codec_tag);
+  MML_TEST_CHECK(info.width == widths[0] && info.height == heights[0], 
+                 "%dx%d instead of %dx%d", info.width, info.height, widths[0], heights[0]);
+  MML_TEST_CHECK(info.decode_errors == 0, "%d decoding errors", info.decode_errors);
+  MML_TEST_CHECK(info.video_frames == info.video_packets, "%d of %d packets decoded", info.video_frames, info.video_packets);
+  MML_TEST_CHECK(info.video_frames >= expected - nb_paths && info.video_frames <= expected, 
+                 "%d frames instead of %d", info.video_frames, expected);
+  MML_TEST_CHECK(info.video_end >= nb_paths * CLIP_SECONDS - 2.0 / CLIP_FPS, "ends at %.3fs", info.video_end);
+  MML_TEST_CHECK(info.nb_audio_streams == 1, "%d audio streams", info.nb_audio_streams);
+  
+  for (int i = 0; i < nb_paths; i++)
+  {
+    int flags = i == 1 ? MML_TEST_CLIP_NO_AUDIO : 0;
+    MML_TEST_CHECK(mml_test_clip_create_ex(video_paths[i], codec_id, CLIP_SECONDS, widths[0], heights[0], 
+                                           CLIP_FPS, flags) >= 0, 
+                   "failed to generate '%s'", video_paths[i]);
+  }
+  MML_TEST_CHECK(mml_video_concat_adaptive(video_paths, nb_paths, output_path) == MML_SUCCESS, 
+                 "concat without audio in the middle: %s", mml_error());
+  MML_TEST_CHECK(mml_test_clip_probe(output_path, &info) == 0, "'%s' not readable", output_path);
+  printf("without audio in the middle: frames: %d, video ends at %.3fs, audio ends at %.3fs\n", 
+         info.video_frames, info.video_end, info.audio_end);
+  MML_TEST_CHECK(info.video_frames >= expected - nb_paths && info.video_frames <= expected, 
+                 "%d frames instead of %d", info.video_frames, expected);
+  MML_TEST_CHECK(info.audio_end >= nb_paths * CLIP_SECONDS - 0.15 && info.audio_end <= nb_paths * CLIP_SECONDS + 0.15, 
+                 "audio ends at %.3fs instead of %ds", info.audio_end, nb_paths * CLIP_SECONDS);
+  printf("ok\n");
+	return 0;
+}
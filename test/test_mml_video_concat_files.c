@@ -0,0 +1,58 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_FPS              25
+
+/*!
+** Concatenates three clips of different lengths and checks that the output 
+** decodes without errors and lasts as long as the three together.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_paths[] = {
+    "../../data/concat.1.mp4",
+    "../../data/concat.2.mp4",
+    "../../data/concat.3.mp4"
+  };
+  const char* output_path = "../../data/concat.123.mp4";
+  const int seconds[] = { 2, 3, 4 };
+  int nb_paths = sizeof(video_paths) / sizeof(video_paths[0]);
+  int total = 0;
+  mml_test_clip_info_t info;
+  mml_media_info_t media;
+  
+  for (int i = 0; i < nb_paths; i++)
+  {
+    MML_TEST_CHECK(mml_test_clip_create(video_paths[i], seconds[i], 320, 240, CLIP_FPS) >= 0, 
+                   "failed to generate '%s'", video_paths[i]);
+    total += seconds[i];
+  }
+  MML_TEST_CHECK(mml_video_concat_files(video_paths, nb_paths, output_path) == MML_SUCCESS, 
+                 "concat: %s", mml_error());
+  
+  MML_TEST_CHECK(mml_test_clip_probe(output_path, &info) == 0, "'%s' not readable", output_path);
+  MML_TEST_CHECK(mml_media_info(output_path, 0, &media) == MML_SUCCESS, "probe: %s", mml_error());
+  int expected = total * CLIP_FPS;
+  printf("frames: %d of %d expected, span: %.3fs - %.3fs, duration: %.3fs\n", 
+         info.video_frames, expected, info.video_start, info.video_end, media.duration);
+  MML_TEST_CHECK(info.decode_errors == 0, "%d decoding errors", info.decode_errors);
+  MML_TEST_CHECK(info.video_frames >= expected - nb_paths && info.video_frames <= expected, 
+                 "%d frames instead of %d", info.video_frames, expected);
+  MML_TEST_CHECK(info.video_end >= total - 2.0 / CLIP_FPS && info.video_end < total, 
+                 "ends at %.3fs", info.video_end);
+  MML_TEST_CHECK(media.duration >= total - 0.2 && media.duration <= total + 0.2, 
+                 "lasts %.3fs instead of %ds", media.duration, total);
+  MML_TEST_CHECK(info.nb_audio_streams == 1, "%d audio streams", info.nb_audio_streams);
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,86 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          30
+#define CLIP_FPS              25
+#define START_TIME            10.3
+#define END_TIME              20.7
+
+/*!
+** Cuts a clip and checks that the output holds exactly the frames of the 
+** range, decodes to the end without errors, and that H.264 output is tagged 
+** avc3 for the parameter sets of the re-encoded GOPs.
+*/
+static int
+check_cut(const char* video_path, const char* output_path, int codec_id)
+{
+  mml_test_clip_info_t info;
+  
+  MML_TEST_CHECK(mml_video_cut_exact(video_path, START_TIME, END_TIME, output_path) == MML_SUCCESS, 
+                 "cut '%s': %s", video_path, mml_error());
+  MML_TEST_CHECK(mml_test_clip_probe(output_path, &info) == 0, "'%s' not readable", output_path);
+  
+  /*!
+  ** 区间内的帧：pts 在 [10.3, 20.7) 之间，第 258 帧到第 517 帧。
+  */
+  int expected = (int)(END_TIME * CLIP_FPS + 0.999) - (int)(START_TIME * CLIP_FPS + 0.999);
+  printf("%s: frames: %d of %d expected, packets: %d, span: %.3fs - %.3fs, errors: %d\n", 
+         output_path, info.video_frames, expected, info.video_packets, info.video_start, info.video_end, 
+         info.decode_errors);
+  MML_TEST_CHECK(info.codec_id == codec_id, "codec %d instead of %d", info.codec_id, codec_id);
+  MML_TEST_CHECK(codec_id != AV_CODEC_ID_H264 || info.codec_tag == MKTAG('a', 'v', 'c', '3'), 
+                 "H.264 sample entry tagged 0x%08x instead of avc3", info.codec_tag);
+  MML_TEST_CHECK(info.decode_errors == 0, "%d decoding errors", info.decode_errors);
+  MML_TEST_CHECK(info.video_frames == info.video_packets, "%d of %d packets decoded", info.video_frames, info.video_packets);
+  MML_TEST_CHECK(info.video_frames >= expected - 1 && info.video_frames <= expected + 1, 
+                 "%d frames instead of %d", info.video_frames, expected);
+  MML_TEST_CHECK(info.video_start < 1.0 / CLIP_FPS, "starts at %.3fs", info.video_start);
+  MML_TEST_CHECK(info.video_end <= END_TIME - START_TIME + 1.0 / CLIP_FPS, "ends at %.3fs", info.video_end);
+  MML_TEST_CHECK(info.nb_audio_streams == 1, "%d audio streams", info.nb_audio_streams);
+  return 0;
+}
+
+/*!
+** Cuts an H.264 clip with avcC extradata between keyframes, so both the head 
+** and the tail GOPs are re-encoded, then an H.264 clip with open GOPs, which 
+** must be re-encoded whole instead of stitched.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/exact.h264.mp4";
+  const char* output_path = "../../data/exact.h264.cut.mp4";
+  const char* open_gop_path = "../../data/exact.opengop.mp4";
+  const char* open_gop_output_path = "../../data/exact.opengop.cut.mp4";
+  int codec_id = AV_CODEC_ID_H264;
+  
+  if (mml_test_clip_create_codec(video_path, codec_id, CLIP_SECONDS, 320, 240, CLIP_FPS) < 0)
+  {
+    printf("no H.264 encoder, testing with MPEG-4\n");
+    codec_id = AV_CODEC_ID_MPEG4;
+    MML_TEST_CHECK(mml_test_clip_create_codec(video_path, codec_id, CLIP_SECONDS, 320, 240, CLIP_FPS) >= 0, 
+                   "failed to generate '%s'", video_path);
+  }
+  if (check_cut(video_path, output_path, codec_id) != 0)
+    return 1;
+  
+  if (codec_id == AV_CODEC_ID_H264)
+  {
+    MML_TEST_CHECK(mml_test_clip_create_ex(open_gop_path, codec_id, CLIP_SECONDS, 320, 240, CLIP_FPS, 
+                                           MML_TEST_CLIP_OPEN_GOP) >= 0, 
+                   "failed to generate '%s'", open_gop_path);
+    if (check_cut(open_gop_path, open_gop_output_path, codec_id) != 0)
+      return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
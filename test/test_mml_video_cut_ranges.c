@@ -0,0 +1,75 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <sys/stat.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          30
+#define CLIP_FPS              25
+
+/*!
+** Cuts three ranges, two of them overlapping, from a clip with a keyframe 
+** every second in one pass, and checks that every output starts at zero and 
+** holds its range up to the keyframe ending it. Then cuts again with the 
+** output of the last range in a missing directory, and checks that the cut 
+** fails without leaving the outputs of the other ranges behind.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/ranges.mp4";
+  mml_cut_range_t ranges[] = {
+    { 0.0,  5.0,  "../../data/ranges.0.mp4" },
+    { 10.0, 20.0, "../../data/ranges.10.mp4" },
+    { 15.0, 25.0, "../../data/ranges.15.mp4" }
+  };
+  int nb_ranges = sizeof(ranges) / sizeof(ranges[0]);
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 320, 240, CLIP_FPS) >= 0, 
+                 "failed to generate '%s'", video_path);
+  MML_TEST_CHECK(mml_video_cut_ranges(video_path, ranges, nb_ranges) == MML_SUCCESS, 
+                 "cut ranges: %s", mml_error());
+  
+  for (int i = 0; i < nb_ranges; i++)
+  {
+    mml_test_clip_info_t info;
+    double length = ranges[i].end_time - ranges[i].start_time;
+    
+    MML_TEST_CHECK(mml_test_clip_probe(ranges[i].output_path, &info) == 0, 
+                   "'%s' not readable", ranges[i].output_path);
+    printf("%s: frames: %d, span: %.3fs - %.3fs\n", 
+           ranges[i].output_path, info.video_frames, info.video_start, info.video_end);
+    /*!
+    ** 结束时间之后的第一个关键帧结束输出，它也被写入，所以多出一秒和一帧。
+    */
+    double end = length + 1.0;
+    int frames = (int)(end * CLIP_FPS) + 1;
+    MML_TEST_CHECK(info.decode_errors == 0, "%d decoding errors", info.decode_errors);
+    MML_TEST_CHECK(info.video_start >= 0 && info.video_start < 1.0 / CLIP_FPS, 
+                   "starts at %.3fs", info.video_start);
+    MML_TEST_CHECK(info.video_end > end - 0.5 / CLIP_FPS && info.video_end < end + 0.5 / CLIP_FPS, 
+                   "ends at %.3fs instead of %.3fs", info.video_end, end);
+    MML_TEST_CHECK(info.video_frames == frames, "%d frames instead of %d", info.video_frames, frames);
+    MML_TEST_CHECK(info.nb_audio_streams == 1, "%d audio streams", info.nb_audio_streams);
+  }
+  
+  ranges[nb_ranges - 1].output_path = "../../data/NOT_EXIST/ranges.15.mp4";
+  for (int i = 0; i < nb_ranges - 1; i++)
+    remove(ranges[i].output_path);
+  MML_TEST_CHECK(mml_video_cut_ranges(video_path, ranges, nb_ranges) != MML_SUCCESS, 
+                 "cut into a missing directory");
+  for (int i = 0; i < nb_ranges - 1; i++)
+  {
+    struct stat st;
+    MML_TEST_CHECK(stat(ranges[i].output_path, &st) != 0, "'%s' left behind", ranges[i].output_path);
+  }
+  printf("ok\n");
+  return 0;
+}
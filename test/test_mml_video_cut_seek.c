@@ -0,0 +1,53 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <sys/stat.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          600
+#define CUT_SECONDS           5
+#define MAX_READ_PERCENT      5
+
+/*!
+** Cuts the last seconds of a long clip and checks that the cut seeks instead 
+** of reading the input from the start.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/long.mp4";
+  const char* output_path = "../../data/long.last5.mp4";
+  struct stat input_stat;
+  struct stat output_stat;
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 320, 240, 25) >= 0, 
+                 "failed to generate '%s'", video_path);
+  MML_TEST_CHECK(mml_video_cut(video_path, CLIP_SECONDS - CUT_SECONDS, CLIP_SECONDS, output_path) == MML_SUCCESS, 
+                 "cut: %s", mml_error());
+  
+  MML_TEST_CHECK(stat(video_path, &input_stat) == 0 && stat(output_path, &output_stat) == 0, 
+                 "'%s' or '%s' missing", video_path, output_path);
+  int64_t read = mml_bytes_read();
+  printf("input: %lld bytes, output: %lld bytes, read: %lld bytes (%.2f%% of the input)\n", 
+         (long long)input_stat.st_size, 
+         (long long)output_stat.st_size, 
+         (long long)read,
+         read * 100.0 / input_stat.st_size);
+  
+  /*!
+  ** 截取的是最后5秒，只占输入的不到1%，加上moov索引和起始关键帧之前的一个GOP，
+  ** 读到的数据不能超过输入的MAX_READ_PERCENT，顺序读整个文件时会远超这个比例。
+  */
+  MML_TEST_CHECK(output_stat.st_size > 0, "empty output");
+  MML_TEST_CHECK(read > 0 && read * 100 <= (int64_t)input_stat.st_size * MAX_READ_PERCENT, 
+                 "read %lld of %lld bytes, over %d%%", 
+                 (long long)read, (long long)input_stat.st_size, MAX_READ_PERCENT);
+  return 0;
+}
@@ -0,0 +1,208 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          12
+#define START_TIME            2.0
+#define END_TIME              10.0
+
+typedef struct stream_stats_s
+{
+  int                   writes;
+  uint8_t*              data;
+  size_t                size;
+} stream_stats_t;
+
+/*!
+** 只能顺序写入的输出，相当于边生成边上传或边播放。
+*/
+static int
+on_write(void* opaque, const uint8_t* buf, int size)
+{
+  stream_stats_t* stats = (stream_stats_t*)opaque;
+  uint8_t* data = (uint8_t*)realloc(stats->data, stats->size + size);
+  if (data == NULL)
+    return -1;
+  memcpy(data + stats->size, buf, size);
+  stats->data = data;
+  stats->size += size;
+  stats->writes++;
+  return size;
+}
+
+static uint32_t
+be32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*!
+** Finds the first box of a type among the boxes in [data, data + size).
+**
+** @return the box, or NULL
+*/
+static const uint8_t*
+find_box(const uint8_t* data, size_t size, const char* type)
+{
+  size_t pos = 0;
+  while (pos + 8 <= size && be32(data + pos) >= 8 && be32(data + pos) <= size - pos)
+  {
+    if (memcmp(data + pos + 4, type, 4) == 0)
+      return data + pos;
+    pos += be32(data + pos);
+  }
+  return NULL;
+}
+
+/*!
+** Checks the top-level layout of a fragmented MP4: ftyp, a moov holding no 
+** samples but an mvex, then moof and mdat pairs, optionally closed by an mfra.
+**
+** @return the number of fragments, or -1 if the layout is wrong
+*/
+static int
+count_fragments(const uint8_t* data, size_t size)
+{
+  const uint8_t* moov;
+  const uint8_t* trak;
+  const uint8_t* box;
+  size_t pos = 0;
+  int fragments = 0;
+  int index = 0;
+  
+  while (pos + 8 <= size)
+  {
+    uint32_t box_size = be32(data + pos);
+    const uint8_t* type = data + pos + 4;
+    if (box_size < 8 || box_size > size - pos)
+      return -1;
+    if (memcmp(type, "free", 4) == 0 || memcmp(type, "skip", 4) == 0)
+    {
+      pos += box_size;
+      continue;
+    }
+    if (index == 0 && memcmp(type, "ftyp", 4) != 0)
+      return -1;
+    if (index == 1)
+    {
+      if (memcmp(type, "moov", 4) != 0)
+        return -1;
+      /*!
+      ** 空的 moov：有 mvex，每个轨道的 stts 没有条目。
+      */
+      moov = data + pos;
+      if (find_box(moov + 8, box_size - 8, "mvex") == NULL)
+        return -1;
+      for (box = moov + 8; box < moov + box_size; box += be32(box))
+      {
+        if (be32(box) < 8 || memcmp(box + 4, "trak", 4) != 0)
+          continue;
+        trak = box;
+        const uint8_t* mdia = find_box(trak + 8, be32(trak) - 8, "mdia");
+        const uint8_t* minf = mdia ? find_box(mdia + 8, be32(mdia) - 8, "minf") : NULL;
+        const uint8_t* stbl = minf ? find_box(minf + 8, be32(minf) - 8, "stbl") : NULL;
+        const uint8_t* stts = stbl ? find_box(stbl + 8, be32(stbl) - 8, "stts") : NULL;
+        if (stts == NULL || be32(stts) < 16 || be32(stts + 12) != 0)
+          return -1;
+      }
+    }
+    if (index >= 2)
+    {
+      /*!
+      ** 之后是成对的 moof 和 mdat。
+      */
+      int moof = index % 2 == 0;
+      if (memcmp(type, "mfra", 4) == 0 && moof)
+        break;
+      if (memcmp(type, moof ? "moof" : "mdat", 4) != 0)
+        return -1;
+      fragments += moof;
+    }
+    pos += box_size;
+    index++;
+  }
+  return index % 2 == 0 ? fragments : -1;
+}
+
+static int
+read_file(const char* path, uint8_t** data, size_t* size)
+{
+  FILE* file = fopen(path, "rb");
+  long length;
+  
+  if (file == NULL)
+    return -1;
+  fseek(file, 0, SEEK_END);
+  length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  *data = (uint8_t*)malloc(length > 0 ? length : 1);
+  *size = fread(*data, 1, length, file);
+  fclose(file);
+  return *size == (size_t)length ? 0 : -1;
+}
+
+/*!
+** Cuts into a write-only callback, concatenates and cuts ranges with the 
+** fragmented option, and checks that each output starts with an empty moov 
+** followed by one moof/mdat fragment per keyframe.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/fragmented.mp4";
+  const char* paths[2] = { "../../data/fragmented.mp4", "../../data/fragmented.mp4" };
+  const char* concat_path = "../../data/fragmented.concat.mp4";
+  mml_cut_range_t ranges[1] = { { START_TIME, END_TIME, "../../data/fragmented.range.mp4" } };
+  mml_options_t options = { MML_THREADS_AUTO, 0, MML_THREADS_AUTO, 0, 0, NULL, 0x000000, 1 };
+  stream_stats_t stats = {0};
+  mml_io_t output;
+  uint8_t* data;
+  size_t size;
+  int fragments;
+  
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 320, 240, 25) >= 0, 
+                 "failed to generate '%s'", video_path);
+  
+  /*!
+  ** 没有 seek 的输出只能写分片格式。
+  */
+  memset(&output, 0, sizeof(output));
+  output.write = on_write;
+  output.opaque = &stats;
+  output.name = "fragmented.cut.mp4";
+  MML_TEST_CHECK(mml_video_cut_ex(video_path, START_TIME, END_TIME, mml_io_path(&output), &options) == MML_SUCCESS, 
+                 "cut: %s", mml_error());
+  mml_io_free(&output);
+  fragments = count_fragments(stats.data, stats.size);
+  printf("cut: %d writes, %zu bytes, %d fragments\n", stats.writes, stats.size, fragments);
+  MML_TEST_CHECK(fragments >= (int)(END_TIME - START_TIME) - 1, "cut: %d fragments", fragments);
+  free(stats.data);
+  
+  MML_TEST_CHECK(mml_video_concat_files_ex(paths, 2, concat_path, &options) == MML_SUCCESS, 
+                 "concat: %s", mml_error());
+  MML_TEST_CHECK(read_file(concat_path, &data, &size) == 0, "'%s' not read", concat_path);
+  fragments = count_fragments(data, size);
+  printf("concat: %zu bytes, %d fragments\n", size, fragments);
+  MML_TEST_CHECK(fragments >= 2 * CLIP_SECONDS - 1, "concat: %d fragments", fragments);
+  free(data);
+  
+  MML_TEST_CHECK(mml_video_cut_ranges_ex(video_path, ranges, 1, &options) == MML_SUCCESS, 
+                 "ranges: %s", mml_error());
+  MML_TEST_CHECK(read_file(ranges[0].output_path, &data, &size) == 0, "'%s' not read", ranges[0].output_path);
+  fragments = count_fragments(data, size);
+  printf("ranges: %zu bytes, %d fragments\n", size, fragments);
+  MML_TEST_CHECK(fragments >= (int)(END_TIME - START_TIME) - 1, "ranges: %d fragments", fragments);
+  free(data);
+  printf("ok\n");
+	return 0;
+}
@@ -8,13 +8,28 @@
 #define IN_FILE "/Users/christian/Downloads/test.mp4"
 #define OUT_FILE "/Users/christian/Downloads/test_out.mp4"
 
+/*!
+** Times mml_video_save_images on the 5s to 20s segment of a clip. To compare
+** with the timings listed in README.md, run it on the same clip:
+**
+**   ./test_mml_video_images <video file> <image directory>
+*/
 int main(int argc, char **argv) {
   clock_t start, end;
-  double cpu_time_used;
+  struct timespec wall_start, wall_end;
+  double cpu_time_used, wall_time_used;
+  const char* input_path = argc > 1 ? argv[1] : IN_FILE;
+  const char* output_path = argc > 2 ? argv[2] : "/Users/christian/Downloads/frames";
   start = clock();
-  mml_video_save_images(IN_FILE, 5, 20, "/Users/christian/Downloads/frames", 1);
+  clock_gettime(CLOCK_MONOTONIC, &wall_start);
+  int rc = mml_video_save_images(input_path, 5, 20, output_path, 1);
+  clock_gettime(CLOCK_MONOTONIC, &wall_end);
   end = clock();
+  if (rc != MML_SUCCESS)
+    printf("error: %s\n", mml_error());
   cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
+  wall_time_used = (wall_end.tv_sec - wall_start.tv_sec) + 
+                   (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
   printf("test_mml_video_images elapsed CPU time: %f seconds\n", cpu_time_used);
+  printf("test_mml_video_images elapsed wall time: %f seconds\n", wall_time_used);
 }
-
@@ -0,0 +1,99 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          8
+#define CLIP_FPS              25
+#define FIRST_IMAGE           1
+
+/*!
+** Counts the images numbered from FIRST_IMAGE on without a gap, removing them
+** when asked.
+*/
+static int
+count_images(const char* dir, int remove_them)
+{
+  char path[4096];
+  struct stat st;
+  int count = 0;
+
+  for (;; count++)
+  {
+    snprintf(path, sizeof(path), "%s/%08d.png", dir, FIRST_IMAGE + count);
+    if (stat(path, &st) != 0)
+      break;
+    if (remove_them)
+      remove(path);
+  }
+  return count;
+}
+
+/*!
+** Exports the same segment of a generated clip on the calling thread and
+** through the image workers, and checks that both give the same images under
+** the same %08d.png names.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/images.mp4";
+  const char* dirs[] = { "../../data/images.sequential", "../../data/images.parallel" };
+  const int threads[] = { 1, 4 };
+  int counts[2];
+  double elapsed;
+
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 320, 240, CLIP_FPS) >= 0,
+                 "failed to generate '%s'", video_path);
+  for (int i = 0; i < 2; i++)
+  {
+    mkdir(dirs[i], 0755);
+    count_images(dirs[i], 1);
+
+    elapsed = mml_test_now();
+    if (threads[i] == 1)
+      MML_TEST_CHECK(mml_video_save_images(video_path, 2, 5, dirs[i], FIRST_IMAGE) == MML_SUCCESS,
+                     "sequential: %s", mml_error());
+    else
+      MML_TEST_CHECK(mml_video_save_images_parallel(video_path, 2, 5, dirs[i], FIRST_IMAGE, threads[i]) == MML_SUCCESS,
+                     "%d threads: %s", threads[i], mml_error());
+    elapsed = mml_test_now() - elapsed;
+    counts[i] = count_images(dirs[i], 0);
+    printf("%d threads: %d images in %.3fs\n", threads[i], counts[i], elapsed);
+  }
+
+  /*!
+  ** 2s 到 5s 之间，从 2s 的关键帧一直导出到 5s 之后的关键帧。
+  */
+  MML_TEST_CHECK(counts[0] >= 3 * CLIP_FPS && counts[0] <= 4 * CLIP_FPS + 1, "%d images", counts[0]);
+  MML_TEST_CHECK(counts[1] == counts[0], "%d images through the workers, %d sequentially", counts[1], counts[0]);
+
+  for (int i = 0; i < counts[0]; i++)
+  {
+    char paths[2][4096];
+    uint8_t* data[2] = { NULL, NULL };
+    size_t sizes[2];
+    int same;
+
+    for (int j = 0; j < 2; j++)
+    {
+      snprintf(paths[j], sizeof(paths[j]), "%s/%08d.png", dirs[j], FIRST_IMAGE + i);
+      MML_TEST_CHECK(mml_test_read_file(paths[j], &data[j], &sizes[j]) == 0, "'%s' not read", paths[j]);
+    }
+    same = sizes[0] == sizes[1] && memcmp(data[0], data[1], sizes[0]) == 0;
+    free(data[0]);
+    free(data[1]);
+    MML_TEST_CHECK(same, "'%s' differs from '%s'", paths[1], paths[0]);
+  }
+  printf("ok\n");
+  return 0;
+}
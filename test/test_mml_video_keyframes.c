@@ -0,0 +1,84 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include <sys/stat.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          16
+#define CLIP_FPS              25
+#define FIRST_IMAGE           1
+
+/*!
+** Counts the images numbered from FIRST_IMAGE on without a gap, removing them
+** when asked.
+*/
+static int
+count_images(const char* dir, int remove_them)
+{
+  char path[4096];
+  struct stat st;
+  int count = 0;
+
+  for (;; count++)
+  {
+    snprintf(path, sizeof(path), "%s/%08d.png", dir, FIRST_IMAGE + count);
+    if (stat(path, &st) != 0)
+      break;
+    if (remove_them)
+      remove(path);
+  }
+  return count;
+}
+
+/*!
+** Exports the keyframes of windows of a generated clip with one keyframe per
+** second, and checks that exactly the keyframes inside each window are saved
+** and that a window near the end does not read the file from the start.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/keyframes.mp4";
+  const char* dir = "../../data/keyframes";
+  const double windows[][2] = { { 2, 5 }, { 2.5, 4.5 }, { CLIP_SECONDS - 3, CLIP_SECONDS - 2 } };
+  struct stat video_stat;
+
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 640, 480, CLIP_FPS) >= 0,
+                 "failed to generate '%s'", video_path);
+  MML_TEST_CHECK(stat(video_path, &video_stat) == 0, "'%s' not found", video_path);
+  mkdir(dir, 0755);
+  for (int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+  {
+    double start = windows[i][0];
+    double end = windows[i][1];
+    /*!
+    ** 关键帧在整秒上，窗口内（含两端）的关键帧个数。
+    */
+    int expected = (int)end - (int)(start + 0.999) + 1;
+    int count;
+
+    count_images(dir, 1);
+    MML_TEST_CHECK(mml_video_save_keyframes(video_path, start, end, dir, FIRST_IMAGE, 1) == MML_SUCCESS,
+                   "%.1fs - %.1fs: %s", start, end, mml_error());
+    count = count_images(dir, 0);
+    printf("%.1fs - %.1fs: %d keyframes, %lld of %lld bytes read\n", start, end, count,
+           (long long)mml_bytes_read(), (long long)video_stat.st_size);
+    MML_TEST_CHECK(count == expected, "%d keyframes instead of %d in %.1fs - %.1fs", count, expected, start, end);
+  }
+
+  /*!
+  ** 最后一个窗口从定位处开始读，不会读到文件的前半部分。
+  */
+  MML_TEST_CHECK(mml_bytes_read() > 0 && mml_bytes_read() < video_stat.st_size / 2,
+                 "%lld of %lld bytes read for the last window",
+                 (long long)mml_bytes_read(), (long long)video_stat.st_size);
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,77 @@
+/*
+** ██╗░░░░░██╗██████╗░███╗░░░███╗███╗░░░███╗██╗░░░░░
+** ██║░░░░░██║██╔══██╗████╗░████║████╗░████║██║░░░░░
+** ██║░░░░░██║██████╦╝██╔████╔██║██╔████╔██║██║░░░░░
+** ██║░░░░░██║██╔══██╗██║╚██╔╝██║██║╚██╔╝██║██║░░░░░
+** ███████╗██║██████╦╝██║░╚═╝░██║██║░╚═╝░██║███████╗
+** ╚══════╝╚═╝╚═════╝░╚═╝░░░░░╚═╝╚═╝░░░░░╚═╝╚══════╝
+*/
+#include <stdio.h>
+#include "libmml.h"
+#include "mml_test.h"
+#include "mml_test_clip.h"
+
+#define CLIP_SECONDS          8
+#define CLIP_FPS              25
+
+/*!
+** The VBV buffer holds two seconds at the maximum rate, so over the clip the 
+** average may go above the cap by at most that buffer.
+*/
+#define BIT_RATE_TOLERANCE    (1.0 + 2.0 / CLIP_SECONDS)
+
+/*!
+** Encodes a generated clip to three renditions, one with the default 
+** (average bit rate) profile and one with the constant quality proxy profile 
+** under a cap, and checks the size, the codec and the bit rate of each.
+*/
+int main(int argc, char* argv[])
+{
+  const char* video_path = "../../data/ladder.mp4";
+  mml_rendition_t renditions[] = {
+    { "../../data/ladder.360.mp4", 640, 360, 800000, NULL },
+    { "../../data/ladder.270.mp4", 480, 270, 500000, &mml_profile_proxy },
+    { "../../data/ladder.180.mp4", 320, 180, 300000, NULL },
+  };
+  int nb_renditions = sizeof(renditions) / sizeof(renditions[0]);
+  
+  if (avcodec_find_encoder(AV_CODEC_ID_H264) == NULL)
+  {
+    printf("no H.264 encoder, skipped\n");
+    return 0;
+  }
+  MML_TEST_CHECK(mml_test_clip_create(video_path, CLIP_SECONDS, 640, 360, CLIP_FPS) >= 0, 
+                 "failed to generate '%s'", video_path);
+  MML_TEST_CHECK(mml_video_ladder(video_path, renditions, nb_renditions) == MML_SUCCESS, 
+                 "ladder: %s", mml_error());
+  
+  for (int i = 0; i < nb_renditions; i++)
+  {
+    const mml_rendition_t* rendition = &renditions[i];
+    const mml_stream_info_t* video = NULL;
+    mml_test_clip_info_t clip;
+    mml_media_info_t info;
+    
+    MML_TEST_CHECK(mml_media_info(rendition->output_path, 0, &info) == MML_SUCCESS, 
+                   "probe '%s': %s", rendition->output_path, mml_error());
+    for (int j = 0; j < info.nb_streams && video == NULL; j++)
+    {
+      if (info.streams[j].type == MML_MEDIA_TYPE_VIDEO)
+        video = &info.streams[j];
+    }
+    MML_TEST_CHECK(video != NULL, "no video stream in '%s'", rendition->output_path);
+    printf("%s: %dx%d, %lld bps of %lld, %.3fs\n", rendition->output_path, video->width, video->height, 
+           (long long)video->bit_rate, (long long)rendition->bit_rate, info.duration);
+    MML_TEST_CHECK(video->width == rendition->width && video->height == rendition->height, 
+                   "%dx%d instead of %dx%d", video->width, video->height, rendition->width, rendition->height);
+    MML_TEST_CHECK(video->bit_rate > 0 && video->bit_rate <= rendition->bit_rate * BIT_RATE_TOLERANCE, 
+                   "%lld bps over the %lld bps cap", (long long)video->bit_rate, (long long)rendition->bit_rate);
+    MML_TEST_CHECK(info.duration >= CLIP_SECONDS - 1, "%.3fs instead of %ds", info.duration, CLIP_SECONDS);
+    
+    MML_TEST_CHECK(mml_test_clip_probe(rendition->output_path, &clip) == 0, 
+                   "'%s' not readable", rendition->output_path);
+    MML_TEST_CHECK(clip.codec_id == AV_CODEC_ID_H264, "codec %d instead of H.264", clip.codec_id);
+    MML_TEST_CHECK(clip.decode_errors == 0, "%d decoding errors", clip.decode_errors);
+  }
+  return 0;
+}